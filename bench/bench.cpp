@@ -0,0 +1,404 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define BENCH_OUT_DIR "bench/out"
+#define BENCH_BASELINES "bench/baselines.txt"
+#define BENCH_PATH_LEN 512
+#define BENCH_MACHINE_LEN 256
+#define CALIBRATION_BYTES (16 << 20)
+
+struct Workload {
+    const char* name;
+    int functions;
+    int locals;
+    int elifs;
+    int terms;
+    int comments;
+};
+
+// Every workload stresses one dimension of the front end and keeps the others small.
+static Workload workloads[] = {
+    { "functions",   2000,   2,   1,   4, 0 },
+    { "elif-chains",   50,   2, 200,   4, 0 },
+    { "expressions",   50,   4,   1, 400, 0 },
+    { "locals",        10, 800,   1,   4, 0 },
+    { "comments",    1000,   4,   2,   8, 6 },
+    { "mixed",        500,  16,  16,  32, 1 },
+};
+
+#define WORKLOAD_COUNT (sizeof(workloads) / sizeof(workloads[0]))
+
+struct Result {
+    double tokens_per_s;
+    double nodes_per_s;
+    double bytes_per_s;
+    double peak_rss_kb;
+    double total_ms;
+    double calibration;
+};
+
+struct Options {
+    const char* neo = "./Neo";
+    int runs = 5;
+    double threshold = 0.15;
+    bool update = false;
+    bool no_baseline = false;
+    const char* only = nullptr;
+};
+
+static Options options;
+
+static void comment(FILE* file, const Workload* w, const char* indent) {
+    for (int i = 0; i < w->comments; i++)
+        fprintf(file, "%s// %s padding comment %d, the lexer has to skip every byte of it\n", indent, w->name, i);
+}
+
+static void generate_function(FILE* file, const Workload* w, int index) {
+    comment(file, w, "");
+    fprintf(file, "f%d : (a: int, b: int) -> int {\n", index);
+
+    for (int i = 0; i < w->locals; i++) {
+        comment(file, w, "    ");
+        if (i == 0)
+            fprintf(file, "    v0 : int = a + %d;\n", index % 97);
+        else
+            fprintf(file, "    v%d : int = v%d * %d + b;\n", i, i - 1, i % 7 + 1);
+    }
+
+    comment(file, w, "    ");
+    fprintf(file, "    if a == 0 {\n        v0 = b + 1;\n    }\n");
+    for (int i = 1; i < w->elifs; i++)
+        fprintf(file, "    elif a == %d {\n        v0 = b + %d;\n    }\n", i, i + 1);
+    fprintf(file, "    else {\n        v0 = b;\n    }\n");
+
+    comment(file, w, "    ");
+    fprintf(file, "    return v0");
+    for (int i = 1; i < w->terms; i++) {
+        const char* op = (i % 3 == 0) ? "-" : "+";
+        if (i % 4 == 1)
+            fprintf(file, " %s v%d * %d", op, i % w->locals, i % 5 + 1);
+        else
+            fprintf(file, " %s (a %s v%d)", op, (i % 2) ? "+" : "-", i % w->locals);
+    }
+    fprintf(file, ";\n}\n\n");
+}
+
+static void generate(const Workload* w, const char* path) {
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        fprintf(stderr, "bench: could not write %s.\n", path);
+        exit(EXIT_FAILURE);
+    }
+
+    for (int i = 0; i < w->functions; i++)
+        generate_function(file, w, i);
+
+    // One scope with a statement per function, far beyond what a fixed statement array would hold.
+    fprintf(file, "driver : () -> int {\n    total : int = 0;\n");
+    for (int i = 0; i < w->functions; i++)
+        fprintf(file, "    total = total + f%d(%d, 2);\n", i, i % 3);
+    fprintf(file, "    return total;\n}\n\ndriver();\n`\n");
+
+    fclose(file);
+}
+
+static char* read_file(const char* path) {
+    FILE* file = fopen(path, "r");
+    if (!file)
+        return nullptr;
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    char* buf = (char*) malloc(size + 1);
+    buf[fread(buf, 1, size, file)] = '\0';
+    fclose(file);
+    return buf;
+}
+
+static double json_number(const char* json, const char* key) {
+    char pattern[64];
+    snprintf(pattern, sizeof(pattern), "\"%s\": ", key);
+
+    const char* at = strstr(json, pattern);
+    return (at) ? strtod(at + strlen(pattern), nullptr) : 0.0;
+}
+
+// Throughput is taken from the median run, so one lucky or unlucky run does not move it.
+static double phase_median(const char* json, const char* path) {
+    char pattern[128];
+    snprintf(pattern, sizeof(pattern), "\"path\": \"%s\"", path);
+
+    const char* at = strstr(json, pattern);
+    return (at) ? json_number(at, "median") : 0.0;
+}
+
+static bool run_workload(const Workload* w, Result* result) {
+    char source[BENCH_PATH_LEN], obj[BENCH_PATH_LEN], report[BENCH_PATH_LEN], cmd[BENCH_PATH_LEN * 4];
+    snprintf(source, sizeof(source), "%s/%s.neo", BENCH_OUT_DIR, w->name);
+    snprintf(obj, sizeof(obj), "%s/%s", BENCH_OUT_DIR, w->name);
+    snprintf(report, sizeof(report), "%s/%s.json", BENCH_OUT_DIR, w->name);
+
+    generate(w, source);
+
+    snprintf(cmd, sizeof(cmd), "%s %s %s --emit-c --no-ast-cache --time-runs=%d --time-report=%s > %s/%s.log 2>&1",
+        options.neo, source, obj, options.runs, report, BENCH_OUT_DIR, w->name);
+    if (system(cmd) != 0) {
+        fprintf(stderr, "bench: %s failed to compile, see %s/%s.log.\n", w->name, BENCH_OUT_DIR, w->name);
+        return false;
+    }
+
+    char* json = read_file(report);
+    if (!json) {
+        fprintf(stderr, "bench: %s wrote no time report.\n", w->name);
+        return false;
+    }
+
+    double lexer = phase_median(json, "lexer");
+    double parser = phase_median(json, "parser");
+    double codegen = phase_median(json, "backend/codegen");
+
+    result->tokens_per_s = (lexer > 0) ? json_number(json, "tokens") / (lexer / 1000.0) : 0.0;
+    result->nodes_per_s = (parser > 0) ? json_number(json, "nodes") / (parser / 1000.0) : 0.0;
+    result->bytes_per_s = (codegen > 0) ? json_number(json, "emitted_bytes") / (codegen / 1000.0) : 0.0;
+    result->peak_rss_kb = json_number(json, "peak_rss_kb");
+    result->total_ms = lexer + parser + phase_median(json, "sema") + phase_median(json, "passes") + phase_median(json, "backend");
+
+    free(json);
+    return true;
+}
+
+static void machine_name(char* name, size_t size) {
+    char host[64] = "unknown", model[160] = "unknown";
+    gethostname(host, sizeof(host));
+    host[sizeof(host) - 1] = '\0';
+
+    FILE* cpuinfo = fopen("/proc/cpuinfo", "r");
+    if (cpuinfo) {
+        char line[256];
+        while (fgets(line, sizeof(line), cpuinfo)) {
+            char* colon = strchr(line, ':');
+            if (strncmp(line, "model name", 10) == 0 && colon) {
+                snprintf(model, sizeof(model), "%s", colon + 2);
+                model[strcspn(model, "\n")] = '\0';
+                break;
+            }
+        }
+        fclose(cpuinfo);
+    }
+
+    // Spaces would split the field when the baselines are read back.
+    snprintf(name, size, "%s/%s/%ld", host, model, sysconf(_SC_NPROCESSORS_ONLN));
+    for (char* c = name; *c; c++) {
+        if (*c == ' ')
+            *c = '_';
+    }
+}
+
+static double now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec * 1000.0 + (double) ts.tv_nsec / 1000000.0;
+}
+
+static int compare_doubles(const void* a, const void* b) {
+    double left = *(const double*) a;
+    double right = *(const double*) b;
+    return (left > right) - (left < right);
+}
+
+// A fixed hashing loop whose speed tracks the clock the machine is running at right now.
+// It runs right before each workload, since a shared machine can slow down for one workload and not the next,
+// and the workload's baseline throughputs are scaled by how it compares with the run that recorded them.
+static double calibrate() {
+    uint8_t* buf = (uint8_t*) malloc(CALIBRATION_BYTES);
+    for (int i = 0; i < CALIBRATION_BYTES; i++)
+        buf[i] = (uint8_t) (i * 131);
+
+    double* rates = (double*) malloc(sizeof(double) * options.runs);
+    volatile uint64_t sink = 0;
+    for (int run = 0; run < options.runs; run++) {
+        double begin = now_ms();
+        uint64_t h = 0xcbf29ce484222325ULL;
+        for (int i = 0; i < CALIBRATION_BYTES; i++)
+            h = (h ^ buf[i]) * 0x100000001b3ULL;
+        sink = sink + h;
+
+        double elapsed = now_ms() - begin;
+        rates[run] = (elapsed > 0) ? CALIBRATION_BYTES / (elapsed / 1000.0) : 0.0;
+    }
+
+    // The median, like the workloads themselves.
+    qsort(rates, options.runs, sizeof(double), compare_doubles);
+    double median = (options.runs % 2) ? rates[options.runs / 2] : (rates[options.runs / 2 - 1] + rates[options.runs / 2]) / 2.0;
+
+    free(rates);
+    free(buf);
+    return median;
+}
+
+// Baselines hold absolute throughput, which only means something on the machine that recorded it.
+static bool load_machine(char* name) {
+    FILE* file = fopen(BENCH_BASELINES, "r");
+    if (!file)
+        return false;
+
+    char line[BENCH_MACHINE_LEN + 32];
+    bool found = false;
+    while (!found && fgets(line, sizeof(line), file))
+        found = sscanf(line, "machine %255s", name) == 1;
+
+    fclose(file);
+    return found;
+}
+
+static bool load_baseline(const char* name, Result* baseline) {
+    FILE* file = fopen(BENCH_BASELINES, "r");
+    if (!file)
+        return false;
+
+    char line[256], label[64];
+    bool found = false;
+    while (!found && fgets(line, sizeof(line), file)) {
+        if (line[0] == '#' || strncmp(line, "machine ", 8) == 0)
+            continue;
+        if (sscanf(line, "%63s %lf %lf %lf %lf %lf", label, &baseline->tokens_per_s, &baseline->nodes_per_s,
+            &baseline->bytes_per_s, &baseline->peak_rss_kb, &baseline->calibration) == 6 && strcmp(label, name) == 0)
+            found = true;
+    }
+
+    fclose(file);
+    return found;
+}
+
+static void save_baselines(const char* machine, Result* results) {
+    FILE* file = fopen(BENCH_BASELINES, "w");
+    if (!file) {
+        fprintf(stderr, "bench: could not write %s.\n", BENCH_BASELINES);
+        exit(EXIT_FAILURE);
+    }
+
+    fprintf(file, "machine %s\n", machine);
+    fprintf(file, "# workload tokens/s nodes/s bytes/s peak-rss-kb calibration\n");
+    for (int i = 0; i < WORKLOAD_COUNT; i++)
+        fprintf(file, "%s %.0f %.0f %.0f %.0f %.0f\n", workloads[i].name, results[i].tokens_per_s, results[i].nodes_per_s,
+            results[i].bytes_per_s, results[i].peak_rss_kb, results[i].calibration);
+    fclose(file);
+}
+
+// Throughputs regress when they fall, memory when it grows.
+static bool regressed(const char* name, const char* metric, double value, double baseline, bool higher_is_better) {
+    if (baseline <= 0)
+        return false;
+
+    double change = (value - baseline) / baseline;
+    if ((higher_is_better && change < -options.threshold) || (!higher_is_better && change > options.threshold)) {
+        printf("bench: regression in %s: %s went from %.0f to %.0f (%+.1f%%).\n", name, metric, baseline, value, change * 100.0);
+        return true;
+    }
+    return false;
+}
+
+static void parse_options(int argc, char* argv[]) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+
+        if (strncmp(arg, "--neo=", 6) == 0)
+            options.neo = arg + 6;
+        else if (strncmp(arg, "--runs=", 7) == 0)
+            options.runs = atoi(arg + 7);
+        else if (strncmp(arg, "--threshold=", 12) == 0)
+            options.threshold = atof(arg + 12) / 100.0;
+        else if (strncmp(arg, "--only=", 7) == 0)
+            options.only = arg + 7;
+        else if (strcmp(arg, "--update-baselines") == 0)
+            options.update = true;
+        else if (strcmp(arg, "--no-baseline") == 0)
+            options.no_baseline = true;
+        else {
+            fprintf(stderr, "usage: neo_bench [--neo=PATH] [--runs=N] [--threshold=PERCENT] [--only=WORKLOAD] [--update-baselines] [--no-baseline]\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (options.runs <= 0) {
+        fprintf(stderr, "bench: invalid number of runs.\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    parse_options(argc, argv);
+    mkdir(BENCH_OUT_DIR, 0755);
+
+    Result results[WORKLOAD_COUNT] = { };
+    int failures = 0, regressions = 0;
+
+    char machine[BENCH_MACHINE_LEN];
+    machine_name(machine, sizeof(machine));
+
+    printf("%-12s %14s %14s %14s %12s %10s\n", "workload", "tokens/s", "nodes/s", "bytes/s", "peak rss kb", "total ms");
+    for (int i = 0; i < WORKLOAD_COUNT; i++) {
+        Workload* w = &workloads[i];
+        if (options.only && strcmp(options.only, w->name) != 0)
+            continue;
+
+        results[i].calibration = calibrate();
+        if (!run_workload(w, &results[i])) {
+            failures++;
+            continue;
+        }
+
+        Result* r = &results[i];
+        printf("%-12s %14.0f %14.0f %14.0f %12.0f %10.3f\n", w->name, r->tokens_per_s, r->nodes_per_s, r->bytes_per_s, r->peak_rss_kb, r->total_ms);
+    }
+
+    if (options.update) {
+        if (failures || options.only) {
+            fprintf(stderr, "bench: baselines are only updated from a complete, successful run.\n");
+            return EXIT_FAILURE;
+        }
+        save_baselines(machine, results);
+        printf("bench: baselines written to %s.\n", BENCH_BASELINES);
+        return 0;
+    }
+
+    // Without a baseline nothing was checked, which only passes when it was asked for.
+    if (options.no_baseline)
+        return (failures) ? EXIT_FAILURE : 0;
+
+    char recorded[BENCH_MACHINE_LEN];
+    if (!load_machine(recorded) || strcmp(recorded, machine) != 0) {
+        fprintf(stderr, "bench: no baselines recorded on this machine, run with --update-baselines to record them or pass --no-baseline.\n");
+        return EXIT_FAILURE;
+    }
+
+    for (int i = 0; i < WORKLOAD_COUNT; i++) {
+        Result baseline;
+        if (results[i].total_ms <= 0)
+            continue;
+        if (!load_baseline(workloads[i].name, &baseline)) {
+            fprintf(stderr, "bench: no baseline for %s, run with --update-baselines to record it.\n", workloads[i].name);
+            failures++;
+            continue;
+        }
+
+        double scale = (baseline.calibration > 0) ? results[i].calibration / baseline.calibration : 1.0;
+        regressions += regressed(workloads[i].name, "tokens/s", results[i].tokens_per_s, baseline.tokens_per_s * scale, true);
+        regressions += regressed(workloads[i].name, "nodes/s", results[i].nodes_per_s, baseline.nodes_per_s * scale, true);
+        regressions += regressed(workloads[i].name, "bytes/s", results[i].bytes_per_s, baseline.bytes_per_s * scale, true);
+        regressions += regressed(workloads[i].name, "peak rss kb", results[i].peak_rss_kb, baseline.peak_rss_kb, false);
+    }
+
+    if (failures || regressions) {
+        printf("bench: %d workload%s failed, %d regression%s.\n", failures, (failures == 1) ? "" : "s", regressions, (regressions == 1) ? "" : "s");
+        return EXIT_FAILURE;
+    }
+    return 0;
+}
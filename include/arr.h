@@ -15,12 +15,9 @@ public:
             return;
         }
         if (element_count > count) {
-            T *temp_array = arr;
+            arr = (T*) realloc(arr, sizeof(T) * element_count);
             count = element_count;
-            memcpy(arr, temp_array, sizeof(T) * element_count);
-            free(temp_array);
         }
-        count = element_count;
     }
 
     inline const size_t size() {
@@ -33,11 +30,16 @@ public:
 
     inline void push(const T& element) {
         if (reserved + 1 >= count) 
-        reserve(count + 1);
+            reserve((count) ? count * 2 : 8);
         
         arr[reserved++] = element;
     }
 
+    inline void pop() {
+        if (reserved > 0)
+            reserved--;
+    }
+
     inline const bool is_empty() {
         return (count == 0);
     }
@@ -52,7 +54,8 @@ public:
 
     inline void clear() {
         reserved = 0;
-        memset(arr, 0, count);
+        if (arr)
+            memset(arr, 0, sizeof(T) * count);
     }
 private:
     T* arr = nullptr;
@@ -0,0 +1,70 @@
+#ifndef AST_CACHE_H
+#define AST_CACHE_H
+
+#include "parser.h"
+
+#include <stdint.h>
+
+#define NEOAST_MAGIC "NEOAST\r\n"
+#define NEOAST_VERSION 3
+
+// A '.neoast' file is the parsed translation unit laid out flat: header, nodes, then the string table.
+// Every reference inside a node or list is a positive offset from the start of the record holding it,
+// so a mapped file is read in place with no fix-ups and can never loop back on itself.
+// Loading still rebuilds the heap tree from those records, it saves lexing and parsing, not the allocations.
+struct Neoast_Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t node_size;
+    uint64_t compiler;
+    uint64_t source_hash;
+    uint64_t source_size;
+
+    uint32_t node_count;
+    uint32_t root;
+    uint32_t headers;
+    uint32_t strings;
+    uint32_t strings_size;
+    uint32_t size;
+
+    // How deeply the parser found the code nested, checked against --max-depth on every load.
+    uint32_t depth;
+};
+
+// 'op', 'flags', 'value' and the child slots mean different things per node type, see ast_cache.cpp.
+// Expressions keep the next expression of a chain in child[4]. 'offset' is the location within the source file.
+struct Neoast_Node {
+    uint8_t type;
+    uint8_t op;
+    uint16_t flags;
+    uint32_t offset;
+    int32_t child[5];
+    int64_t value;
+};
+
+struct Neoast_List {
+    uint32_t count;
+    int32_t items[];
+};
+
+struct Ast_Cache {
+    char* path = nullptr;
+    Source_File* source = nullptr;
+    uint64_t source_hash = 0;
+    uint64_t source_size = 0;
+
+    uint8_t* data = nullptr;
+    size_t size = 0;
+};
+
+// The cache lives next to the source, 'main.neo' is cached in 'main.neoast'.
+void open_ast_cache(Ast_Cache* cache, Source_File* source);
+
+// Fills in the parser's tree and foreign headers; names point into the mapping, so it has to outlive the tree.
+bool load_ast_cache(Ast_Cache* cache, Parser* parser);
+
+void write_ast_cache(Ast_Cache* cache, Parser* parser);
+
+void close_ast_cache(Ast_Cache* cache);
+
+#endif //!AST_CACHE_H
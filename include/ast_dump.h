@@ -0,0 +1,25 @@
+#ifndef AST_DUMP_H
+#define AST_DUMP_H
+
+#include "parser.h"
+
+#include <stdio.h>
+
+struct Ast_Dumper {
+    FILE* file;
+    int depth = 0;
+    Array<Ast_Binary_Expression*> chain;
+
+    void node(Ast* at, Ast_Type* type, const char* fmt, ...);
+
+    void dump_expression(Ast_Expression* expr);
+    void dump_function_call(Ast_Function_Call* call);
+    void dump_decleration(Ast_Decleration* dec);
+    void dump_function_definition(Ast_Function_Definition* func);
+    void dump_statement(Ast* ast);
+    void dump_scope(Ast_Scope* scope);
+};
+
+void dump_translation_unit(FILE* file, Ast_Translation_Unit* root);
+
+#endif //!AST_DUMP_H
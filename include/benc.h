@@ -1,8 +0,0 @@
-#ifndef BENCH_H
-#define BENCH_H
-
-void begin_debug_benchmark();
-
-float end_debug_benchmark(const char* label);
-
-#endif //!BENCH_H
\ No newline at end of file
@@ -0,0 +1,23 @@
+#ifndef BOUNDS_H
+#define BOUNDS_H
+
+#include "parser.h"
+
+struct Bounds_Elider {
+    Array<Ast_Decleration*> globals;
+    Array<Ast_For*> loops;
+    int elided = 0;
+
+    bool is_global(Ast_Decleration* dec);
+    bool assigns(Ast_Scope* scope, Ast_Decleration* dec);
+    bool in_range(Ast_Index_Expression* index);
+
+    void visit_expression(Ast_Expression* expr);
+    void visit_function_call(Ast_Function_Call* call);
+    void visit_statement(Ast* ast);
+    void visit_scope(Ast_Scope* scope);
+};
+
+void elide_bounds_checks(Ast_Translation_Unit* root);
+
+#endif //!BOUNDS_H
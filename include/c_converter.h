@@ -11,17 +11,57 @@ void convert_transition_unit(const char* obj_name, Ast_Translation_Unit* root, S
 
 void compile_and_link(const char* file_name, const char* obj_name);
 
+enum {
+    TASK_EXPRESSION,
+    TASK_UNARY,
+    TASK_OPERAND,
+    TASK_TEXT
+};
+
+// One step of an expression still to be written; operands and the text between them are queued in reverse.
+struct Convert_Task {
+    int kind;
+    Ast_Expression* expr;
+    Ast_Expression* other;
+    const char* text;
+};
+
 struct C_Converter {
     FILE* file;
+    bool memo_helpers = false;
+    Ast_Function_Definition* current = nullptr;
+
+    Array<Convert_Task> tasks;
+
+    // Top level calls, they run in order from main once every definition is written.
+    Array<Ast_Function_Call*> run_directives;
+
+    bool parallel_runtime = false;
+    Array<Ast_For*> parallel_loops;
+    Ast_For* parallel = nullptr;
+
     void convert_decleration(Ast_Decleration* decleration);
     void convert_type(Ast_Type* type);
+    void convert_declarator(Ast_Type* type, Ast_Ident* id);
+    void convert_value(Ast_Expression* expr, Ast_Type* to);
     void convert_identifier(Ast_Ident* id);
     void convert_expression(Ast_Expression* expr);
+    void push_task(int kind, Ast_Expression* expr, Ast_Expression* other = nullptr, const char* text = nullptr);
     void convert_binary_expression(Ast_Expression* expr);
+    void convert_operand(Ast_Expression* expr, Ast_Expression* other);
     void convert_unary_expression(Ast_Expression* expr);
     void convert_postfix_expression(Ast_Expression* expr);
+    void convert_subscript(Ast_Index_Expression* index);
+    void convert_struct_definition(Ast_Struct* record);
     void convert_function_definition(Ast_Function_Definition* func);
+    void convert_function_signature(Ast_Function_Definition* func, const char* suffix, bool internal);
+    void convert_function_body(Ast_Function_Definition* func);
+    void convert_memoized_function(Ast_Function_Definition* func);
     void convert_function_call(Ast_Function_Call* call);
+    bool is_captured_array(Ast_Decleration* dec);
+    void convert_parallel_body(Ast_For* loop);
+    void convert_parallel_bodies(Ast_Scope* scope);
+    void convert_parallel_for(Ast_For* loop);
     void convert_statement(Ast* ast);
 
     void end();
@@ -0,0 +1,21 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdint.h>
+
+// --cache-dir, then $NEO_CACHE_DIR, then $XDG_CACHE_HOME/neo, then ~/.cache/neo.
+const char* cache_directory();
+
+// Creates the directory and any missing parents, like 'mkdir -p'.
+bool make_directories(const char* path);
+
+// Hash of 'gcc -v', so anything built by one compiler is never reused with another.
+uint64_t compiler_version();
+
+// Copies the artifact stored under the key to 'path' and marks it as recently used.
+bool restore_artifact(uint64_t key, const char* path, int mode);
+
+// Stores a copy of 'path' under the key, then evicts the least recently used artifacts over the size limit.
+void store_artifact(uint64_t key, const char* path);
+
+#endif //!CACHE_H
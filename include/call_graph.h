@@ -0,0 +1,19 @@
+#ifndef CALL_GRAPH_H
+#define CALL_GRAPH_H
+
+#include "parser.h"
+
+struct Call_Graph {
+    Array<Ast_Function_Definition*> worklist;
+
+    void mark(Ast_Decleration* dec);
+
+    void visit_expression(Ast_Expression* expr);
+    void visit_function_call(Ast_Function_Call* call);
+    void visit_statement(Ast* ast);
+    void visit_scope(Ast_Scope* scope);
+};
+
+void eliminate_dead_functions(Ast_Translation_Unit* root);
+
+#endif //!CALL_GRAPH_H
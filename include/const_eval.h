@@ -0,0 +1,46 @@
+#ifndef CONST_EVAL_H
+#define CONST_EVAL_H
+
+#include "parser.h"
+
+struct Const_Local {
+    Ast_Decleration* dec;
+    int64_t value;
+};
+
+struct Const_Evaluator {
+    Array<Const_Local> locals;
+    Array<Ast_Binary_Expression*> chain;
+    size_t frame = 0;
+    int depth = 0;
+    long budget;
+    bool failed = false;
+
+    bool returned = false;
+    bool breaking = false;
+    bool continuing = false;
+    int64_t return_value = 0;
+
+    Ast_Function_Definition* cached_function = nullptr;
+    Array<int64_t> cache;
+    Array<bool> cached;
+
+    Const_Local* look_up(Ast_Decleration* dec);
+    int64_t truncate(int64_t value, Ast_Type* type);
+    void assign(Ast_Expression* target, int64_t value);
+
+    int64_t evaluate_expression(Ast_Expression* expr);
+    int64_t evaluate_binary_expression(Ast_Binary_Expression* bin);
+    int64_t evaluate_binary_operator(Ast_Binary_Expression* bin, int64_t left, int64_t right);
+    int64_t evaluate_unary_expression(Ast_Unary_Expression* unary);
+    int64_t evaluate_primary_expression(Ast_Primary_Expression* prime);
+    int64_t evaluate_assignment_chain(Ast_Expression* expr);
+    int64_t evaluate_call(Ast_Function_Definition* func, int64_t* args);
+
+    void execute_statement(Ast* ast);
+    void execute_scope(Ast_Scope* scope);
+};
+
+bool evaluate_function(Const_Evaluator* evaluator, Ast_Function_Definition* func, int64_t* args, int64_t* result);
+
+#endif //!CONST_EVAL_H
@@ -1,10 +1,37 @@
 #ifndef ERR_H
 #define ERR_H
 
+#include <stdint.h>
+
+#include "source.h"
+
+#define DEFAULT_ERROR_LIMIT 20
+
+enum {
+    DIAGNOSTIC_WARNING,
+    DIAGNOSTIC_ERROR
+};
+
+struct Diagnostic {
+    int severity;
+    Source_Location loc;
+    uint64_t order;
+    char* message;
+};
+
+// Writes every buffered diagnostic first, then the fatal message, and exits.
 void fatal_error(const char* fmt, ...);
 
-void report_warning(const char* fmt, ...);
+// Messages are given without a trailing period, one is added when they are written.
+// A location of 0 means the diagnostic has no location, so no line is printed.
+void report_warning(Source_Location loc, const char* fmt, ...);
+
+void report_error(Source_Location loc, const char* fmt, ...);
+
+// Once more errors than the limit are reported compilation stops; 0 means no limit.
+void set_error_limit(int limit);
 
-void report_error(const char* fmt, ...);
+// Writes the buffered diagnostics sorted by location, in one write. Lines are only looked up here.
+void flush_diagnostics();
 
-#endif //!ERRO_H
\ No newline at end of file
+#endif //!ERRO_H
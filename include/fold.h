@@ -0,0 +1,35 @@
+#ifndef FOLD_H
+#define FOLD_H
+
+#include "parser.h"
+
+struct Constant_Binding {
+    const char* name;
+    bool known;
+    Ast_Primary_Expression* value;
+};
+
+struct Folder {
+    Array<Constant_Binding> bindings;
+    Array<Ast_Binary_Expression*> chain;
+
+    Ast_Primary_Expression* look_up(const char* name);
+    void bind(Ast_Decleration* dec);
+
+    Ast_Expression* fold_expression(Ast_Expression* expr);
+    Ast_Expression* fold_binary_expression(Ast_Binary_Expression* bin);
+    Ast_Expression* fold_binary_operator(Ast_Binary_Expression* bin);
+    Ast_Expression* fold_unary_expression(Ast_Unary_Expression* unary);
+    Ast_Expression* fold_primary_expression(Ast_Primary_Expression* prime);
+    void fold_function_call(Ast_Function_Call* call);
+    void fold_assignment_chain(Ast_Expression** expr);
+    void fold_function_definition(Ast_Function_Definition* func);
+    Ast* fold_control_flow(Ast_ControlFlow* condition);
+    Ast* fold_for_statement(Ast_For* loop);
+    Ast* fold_statement(Ast* ast);
+    void fold_scope(Ast_Scope* scope);
+};
+
+void fold_translation_unit(Ast_Translation_Unit* root);
+
+#endif //!FOLD_H
@@ -0,0 +1,14 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define HASH_SEED 0xcbf29ce484222325ULL
+
+// 64-bit FNV-1a; pass a previous result as the seed to hash several buffers as one.
+uint64_t hash_bytes(const void* data, size_t size, uint64_t seed = HASH_SEED);
+
+uint64_t hash_string(const char* str, uint64_t seed = HASH_SEED);
+
+#endif //!HASH_H
@@ -0,0 +1,45 @@
+#ifndef INLINE_H
+#define INLINE_H
+
+#include "parser.h"
+
+struct Inline_Function {
+    Ast_Function_Definition* func;
+    Array<Ast_Function_Definition*> callees;
+    bool recursive = false;
+};
+
+struct Inliner {
+    Array<Inline_Function> functions;
+    int inlined = 0;
+
+    Inline_Function* find_function(Ast_Function_Definition* func);
+    bool reaches(Ast_Function_Definition* from, Ast_Function_Definition* target, Array<Ast_Function_Definition*>* visited);
+
+    void collect_expression(Ast_Expression* expr, Array<Ast_Function_Definition*>* callees);
+    void collect_scope(Ast_Scope* scope, Array<Ast_Function_Definition*>* callees);
+
+    Ast_Expression* inline_body(Ast_Function_Definition* func);
+    Ast_Expression* substitute(Ast_Expression* expr, Ast_Function_Definition* func, Ast_Expression** args);
+    Ast_Expression* inline_call(Ast_Primary_Expression* prime, int depth);
+
+    Ast_Expression* inline_expression(Ast_Expression* expr, int depth);
+    void inline_function_call(Ast_Function_Call* call);
+    void inline_statement(Ast* ast);
+    void inline_scope(Ast_Scope* scope);
+};
+
+struct Tail_Call_Rewriter {
+    Ast_Function_Definition* func;
+    int rewritten = 0;
+
+    bool is_self_call(Ast_Expression* expr);
+    Ast* rewrite_call(Ast_Function_Call* call);
+    void rewrite_scope(Ast_Scope* scope, bool at_end);
+};
+
+void inline_functions(Ast_Translation_Unit* root);
+
+void eliminate_tail_calls(Ast_Translation_Unit* root);
+
+#endif //!INLINE_H
@@ -0,0 +1,139 @@
+#ifndef IR_H
+#define IR_H
+
+#include "parser.h"
+
+#include <stdio.h>
+
+enum {
+    IR_CONST,
+    IR_PARAM,
+    IR_UNDEF,
+    IR_PHI,
+    IR_COPY,
+    IR_CAST,
+
+    IR_ADD,
+    IR_SUB,
+    IR_MUL,
+    IR_DIV,
+    IR_MOD,
+    IR_SHL,
+
+    IR_EQ,
+    IR_NE,
+    IR_LT,
+    IR_LE,
+    IR_GT,
+    IR_GE,
+
+    IR_LOAD,
+    IR_STORE,
+    IR_CALL
+};
+
+enum {
+    IR_TERM_NONE,
+    IR_TERM_JUMP,
+    IR_TERM_BRANCH,
+    IR_TERM_RETURN
+};
+
+enum {
+    IR_FLAG_NONE = 0x00,
+    IR_FLAG_WRAP = 0x01
+};
+
+struct Ir_Block;
+
+struct Ir_Value {
+    int op;
+    int id;
+    int flags = IR_FLAG_NONE;
+    Ast_Type* type = nullptr;
+    Ir_Block* block = nullptr;
+
+    union {
+        int64_t imm;
+        double fimm;
+    };
+
+    const char* name = nullptr;
+    Array<Ir_Value*> args;
+
+    int slot = -1;
+    Ir_Value* forward = nullptr;
+    bool live = false;
+};
+
+struct Ir_Block {
+    int id;
+
+    Array<Ir_Value*> phis;
+    Array<Ir_Value*> insts;
+    Array<Ir_Block*> preds;
+
+    int term = IR_TERM_NONE;
+    Ir_Value* term_value = nullptr;
+    Ir_Block* targets[2] = { nullptr, nullptr };
+
+    Array<Ir_Value*> defs;
+    Array<Ir_Value*> incomplete_phis;
+    bool sealed = false;
+
+    int rpo_index = -1;
+    Ir_Block* idom = nullptr;
+    Array<Ir_Block*> dom_children;
+};
+
+struct Ir_Function {
+    Ast_Function_Definition* def;
+    Ast_Type* return_type = nullptr;
+
+    Array<Ir_Block*> blocks;
+    Array<Ir_Block*> all_blocks;
+    Array<Ir_Value*> values;
+    Ir_Block* entry = nullptr;
+
+    int value_count = 0;
+    int block_count = 0;
+
+    Ir_Value* new_value(int op, Ast_Type* type);
+    Ir_Block* new_block();
+    int instruction_count();
+};
+
+Ir_Value* resolve(Ir_Value* value);
+
+bool ir_is_pure(Ir_Value* value);
+
+void ir_add_edge(Ir_Block* from, Ir_Block* to);
+
+void ir_resolve_operands(Ir_Function* func);
+
+void ir_remove_unreachable_blocks(Ir_Function* func);
+
+void ir_compute_dominators(Ir_Function* func);
+
+bool ir_dominates(Ir_Block* a, Ir_Block* b);
+
+int ir_successor_count(Ir_Block* block);
+
+void ir_remove_pred(Ir_Block* block, int index);
+
+Ir_Function* lower_function(Ast_Function_Definition* def);
+
+void optimize_function(Ir_Function* func);
+
+void dump_function(FILE* file, Ir_Function* func);
+
+void emit_function_body(FILE* file, Ir_Function* func);
+
+// Always written with a '.' or exponent, so C never reads it back as an integer.
+void emit_floating_literal(FILE* file, double value, bool single);
+
+void report_pass_timings();
+
+void free_function(Ir_Function* func);
+
+#endif //!IR_H
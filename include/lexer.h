@@ -2,10 +2,11 @@
 #define LEXER_H
 
 #include <stdint.h>
+#include <stdio.h>
 
 #include "arr.h"
+#include "source.h"
 
-#define LEXER_FILE_MODE "r"
 #define MAX_TOKEN_SIZE 512
 
 namespace Tok {
@@ -32,6 +33,7 @@ namespace Tok {
             T_LARROW = '<',
             T_RARROW = '>',
             T_COMMA = ',', 
+            T_DOT = '.',
 
             T_EOF = 255,
 
@@ -51,6 +53,15 @@ namespace Tok {
             T_GTE,
             T_FOREIGN,
             T_FROM,
+            T_MEMOIZE,
+            T_FOR,
+            T_IN,
+            T_SIMD,
+            T_PARALLEL,
+            T_ARENA,
+            T_NEW,
+            T_STRUCT,
+            T_SOA,
             T_NOT_EQUAL,
             
             T_CONST,
@@ -59,6 +70,7 @@ namespace Tok {
             T_DOUBLE,
             T_BYTE,
             T_BOOLEAN,
+            T_LONG,
 
             T_IDENTIFIER,
             T_INT_CONST,
@@ -67,18 +79,18 @@ namespace Tok {
 
             T_INC,
             T_DEC,
-            T_DASH_ARROW
+            T_DASH_ARROW,
+            T_DOT_DOT
         };
     }
 
 struct Token {
     int type;
-    uint32_t line;
-    uint32_t pos;
+    Source_Location loc;
 
     union {
-        int int_const;
-        float float_const;
+        int64_t int_const;
+        double float_const;
         char char_const;
         char identifier[MAX_TOKEN_SIZE];
     };
@@ -88,7 +100,7 @@ const char* token_to_str(Token* token);
 
 const char* type_to_str(int type);
 
-void log_token(Token* token);
+void log_token(FILE* out, Token* token);
 
 struct Lexer {
     uint32_t size;
@@ -101,17 +113,14 @@ struct Lexer {
     size_t current_len = 0;
 
     uint8_t* stream;
-    char* file;
+    Source_File* source;
 
-    uint32_t current_line = 0;
-    uint32_t current_pos = 0;
+    int error_count = 0;
 
     void run();
-    void log();
+    void log(FILE* out);
 
-    static Lexer* init(uint8_t* stream);
+    static Lexer* init(Source_File* source);
 };
 
-uint8_t* load_file(const char* filepath, size_t* filesize);
-
 #endif //!LEXER_H
\ No newline at end of file
@@ -0,0 +1,23 @@
+#ifndef LITERAL_H
+#define LITERAL_H
+
+#include <stdint.h>
+
+// Literals are read a machine word at a time, so the source buffer needs this many NUL bytes after its end.
+#define LITERAL_PADDING 8
+
+struct Numeric_Literal {
+    int type;
+    int64_t int_const = 0;
+    double float_const = 0.0;
+
+    const uint8_t* end;
+    const char* error = nullptr;
+};
+
+// Scans a literal starting at a digit: decimal, '0x' hex or '0b' binary integers, and decimal floats with
+// an optional exponent. '_' may separate digits. A '.' only belongs to the literal when a digit follows it,
+// so '0..10' is still a range.
+Numeric_Literal scan_numeric_literal(const uint8_t* start);
+
+#endif //!LITERAL_H
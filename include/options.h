@@ -0,0 +1,48 @@
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include "err.h"
+
+#include <stdint.h>
+
+#define DEFAULT_CACHE_SIZE (512ULL << 20)
+#define DEFAULT_MAX_DEPTH 4096
+
+struct Options {
+    const char* input_file = nullptr;
+    const char* obj_name = nullptr;
+
+    bool emit_c = false;
+    bool ast_cache = true;
+    bool pch = true;
+    const char* cache_dir = nullptr;
+    bool build_cache = true;
+    uint64_t cache_size = DEFAULT_CACHE_SIZE;
+    bool use_ir = true;
+    bool dump_ir = false;
+    bool time_passes = false;
+    const char* time_report = nullptr;
+    int time_runs = 1;
+    bool perf_counters = false;
+    bool stats = false;
+    const char* trace_file = nullptr;
+    const char* dump_tokens = nullptr;
+    const char* dump_ast = nullptr;
+    int max_errors = DEFAULT_ERROR_LIMIT;
+    int max_depth = DEFAULT_MAX_DEPTH;
+
+    bool auto_memoize = true;
+    int memo_size = 1024;
+
+    bool inline_functions = true;
+    int inline_budget = 16;
+
+    bool release = false;
+    bool bounds_checks = true;
+};
+
+extern Options options;
+
+void parse_options(int argc, char* argv[]);
+
+#endif //!OPTIONS_H
@@ -4,6 +4,7 @@
 #include "../include/lexer.h"
 #include "arr.h"
 #include "sym.h"
+#include "stats.h"
 
 enum {
     AST_EXPRESSION,
@@ -18,12 +19,17 @@ enum {
     AST_DECLERATION,
     AST_CONDITION,
     AST_TYPE,
-    AST_SCOPE
+    AST_SCOPE,
+    AST_FOR,
+    AST_INDEX_EXPRESSION,
+    AST_FIELD_EXPRESSION,
+    AST_NEW_EXPRESSION,
+    AST_VECTOR_EXPRESSION,
+    AST_STRUCT
 };
 
 struct Ast {
-    uint32_t line, pos;
-    const char* file;
+    Source_Location loc;
     int type;
 };
 
@@ -32,28 +38,50 @@ struct Ast_Ident;
 struct Ast_Decleration;
 struct Ast_Function_Definition;
 struct Ast_Function_Call;
+struct Ast_Struct;
 
 struct Ast_Scope : public Ast {
-    Ast_Scope() { type = AST_SCOPE; }
+    Ast_Scope() { type = AST_SCOPE; count_stat(STAT_SCOPES); }
 
     SymTable table;
-    Ast* statements[64];
+    Ast** statements = nullptr;
     int size = 0;
+    int capacity = 0;
 
     Ast_Scope* parent = nullptr;
 
     Ast_Decleration* get_decleration(Ast_Ident* iden);
+
+    void add(Ast* ast) {
+        if (size == capacity) {
+            int grown = (capacity) ? capacity * 2 : 8;
+            statements = (Ast**) realloc(statements, sizeof(Ast*) * grown);
+            track_allocation(MEM_AST, (int64_t) sizeof(Ast*) * (grown - capacity));
+            capacity = grown;
+        }
+        statements[size++] = ast;
+    }
 };
 
 enum {
     AST_TYPE_INT,
-    AST_TYPE_BYTE
+    AST_TYPE_BYTE,
+    AST_TYPE_LONG,
+    AST_TYPE_FLOAT,
+    AST_TYPE_DOUBLE,
+    AST_TYPE_VOID,
+    AST_TYPE_ARRAY,
+    AST_TYPE_SLICE,
+    AST_TYPE_ARENA,
+    AST_TYPE_VECTOR,
+    AST_TYPE_STRUCT
 };
 
 struct Ast_Ident : public Ast {
     Ast_Ident() { type = AST_IDENTIFIER; }
 
     char* name;
+    Ast_Decleration* decleration = nullptr;
 };
 
 struct Ast_Type : public Ast {
@@ -61,6 +89,13 @@ struct Ast_Type : public Ast {
 
     int atom_type;
     bool constant = false;
+
+    Ast_Type* element = nullptr;
+    int64_t length = 0;
+
+    Ast_Ident* name = nullptr;
+    Ast_Struct* record = nullptr;
+    bool soa = false;
 };
 
 struct Ast_Decleration : public Ast {
@@ -75,6 +110,7 @@ struct Ast_Expression : public Ast {
     Ast_Expression() { type = AST_EXPRESSION; }
 
     Ast_Expression* next = nullptr;
+    Ast_Type* type_info = nullptr;
 };
 
 enum {
@@ -99,6 +135,19 @@ struct Ast_Binary_Expression : public Ast_Expression {
     Ast_Expression* right = nullptr;
 };
 
+// 'a+b+c' is (a+b)+c, so an operator chain grows down its left operands. Walks follow that spine in a loop
+// and recurse only into right operands, which keeps a chain of any length to one native frame.
+inline Ast_Binary_Expression* left_link(Ast_Binary_Expression* bin) {
+    Ast_Expression* left = bin->left;
+    return (left && left->type == AST_BINARY_EXPRESSION) ? static_cast<Ast_Binary_Expression*>(left) : nullptr;
+}
+
+// Pushes a chain from its top down to the link holding its first operand, so popping visits it in evaluation order.
+inline void push_chain(Ast_Binary_Expression* bin, Array<Ast_Binary_Expression*>* chain) {
+    for (; bin; bin = left_link(bin))
+        chain->push(bin);
+}
+
 enum {
     AST_INT_P,
     AST_FLOAT_P,
@@ -148,10 +197,58 @@ struct Ast_Postfix_Expression : public Ast_Expression {
     Ast_Expression* expr = nullptr;    
 };
 
+struct Ast_Index_Expression : public Ast_Expression {
+    Ast_Index_Expression() { type = AST_INDEX_EXPRESSION; }
+
+    Ast_Expression* base = nullptr;
+    Ast_Expression* index = nullptr;
+    int postfix = AST_UNARY_NONE;
+    bool checked = true;
+};
+
+struct Ast_Field_Expression : public Ast_Expression {
+    Ast_Field_Expression() { type = AST_FIELD_EXPRESSION; }
+
+    Ast_Expression* base = nullptr;
+    Ast_Ident* field = nullptr;
+    Ast_Decleration* member = nullptr;
+};
+
+// 'new [count]element in arena' yields a zeroed slice carved out of the arena.
+struct Ast_New_Expression : public Ast_Expression {
+    Ast_New_Expression() { type = AST_NEW_EXPRESSION; }
+
+    Ast_Type* element = nullptr;
+    Ast_Expression* count = nullptr;
+    Ast_Expression* arena = nullptr;
+};
+
+enum {
+    AST_VECTOR_BROADCAST,
+    AST_VECTOR_LANES,
+    AST_VECTOR_LOAD
+};
+
+// 'vecN T(x)' broadcasts x, 'vecN T(x0, .., xN-1)' lists every lane and 'vecN T(a, i)' views a[i] to a[i + N - 1].
+struct Ast_Vector_Expression : public Ast_Expression {
+    Ast_Vector_Expression() { type = AST_VECTOR_EXPRESSION; }
+
+    Ast_Type* vector = nullptr;
+    Ast_Expression* args[64];
+    size_t arg_count = 0;
+    int form = AST_VECTOR_BROADCAST;
+    bool checked = true;
+};
+
 enum {
     AST_FUNCTION_NONE = 0x00,
     AST_FUNCTION_GLOBAL = 0x01,
     AST_FUNCTION_LOCAL = 0x02,
+    AST_FUNCTION_INTERNAL = 0x04,
+    AST_FUNCTION_REACHABLE = 0x08,
+    AST_FUNCTION_MEMOIZE = 0x10,
+    AST_FUNCTION_PURE = 0x20,
+    AST_FUNCTION_MEMOIZED = 0x40,
 };
 
 struct Ast_Function_Definition : public Ast_Decleration {
@@ -162,6 +259,9 @@ struct Ast_Function_Definition : public Ast_Decleration {
     size_t arg_count = 0;
     int flags = AST_FUNCTION_GLOBAL;
     Ast_Ident* from = nullptr;
+
+    int memo_size = 0;
+    int memo_prefill = 0;
 };
 
 struct Ast_Function_Call : public Ast_Decleration {
@@ -175,7 +275,8 @@ struct Ast_Function_Call : public Ast_Decleration {
 enum {
     AST_ATTRIB_NONE = 0x00,
     AST_RETURN = 0x01,
-    AST_BREAK = 0x02
+    AST_BREAK = 0x02,
+    AST_CONTINUE = 0x04
 };
 
 struct Ast_Statement : public Ast {
@@ -191,22 +292,74 @@ enum {
     AST_CONTROL_IF,
     AST_CONTROL_ELSE,
     AST_CONTROL_ELIF,
-    AST_CONTROL_WHILE
+    AST_CONTROL_WHILE,
+    AST_CONTROL_BLOCK
 };
 
 struct Ast_ControlFlow : public Ast {
     Ast_ControlFlow() { type = AST_CONDITION; }
 
-    Ast_Expression* condition;
+    Ast_Expression* condition = nullptr;
     Ast_Scope scope;
     int flag = AST_CONTROL_NONE;
-    Ast_ControlFlow* next;
+    Ast_ControlFlow* next = nullptr;
+};
+
+enum {
+    AST_REDUCE_ADD,
+    AST_REDUCE_MIN,
+    AST_REDUCE_MAX,
+};
+
+struct Ast_Reduction {
+    int op;
+    Ast_Ident* ident;
+};
+
+struct Ast_For : public Ast {
+    Ast_For() { type = AST_FOR; }
+
+    Ast_Decleration* iterator = nullptr;
+    Ast_Expression* begin = nullptr;
+    Ast_Expression* end = nullptr;
+    Ast_Scope scope;
+    bool simd = false;
+
+    bool parallel = false;
+    int64_t grain = 0;
+    Array<Ast_Reduction> reductions;
+    Array<Ast_Decleration*> captures;
+};
+
+struct Ast_Struct : public Ast_Decleration {
+    Ast_Struct() { type = AST_STRUCT; }
+
+    Ast_Decleration* fields[64];
+    size_t field_count = 0;
 };
 
 struct Ast_Translation_Unit : public Ast {
     Ast_Scope scope;
 };
 
+enum {
+    PENDING_BINARY,
+    PENDING_PREFIX,
+    PENDING_PAREN
+};
+
+// Expressions are parsed with explicit stacks; an operator waits here until its operands are complete.
+struct Pending_Operator {
+    int kind;
+    Ast_Expression* node;
+};
+
+// 'height' is how many nested frames a later pass needs for the finished subtree; a chain's left spine costs none.
+struct Pending_Operand {
+    Ast_Expression* expr;
+    int height;
+};
+
 struct Parser {
     static Parser* init(Lexer* lexer);
     void run();
@@ -218,6 +371,7 @@ struct Parser {
 
     Lexer* lexer;
     uint32_t index = 0;
+    uint32_t node_count = 0;
 
     Token* peek();
     Token* peek_off(int off);
@@ -227,17 +381,25 @@ struct Parser {
     Ast* default_ast(Ast* ast);
 
     Ast_Type* parse_type();
+    Ast_Type* parse_vector_type();
     Ast_Ident* parse_identity();
     Ast_Decleration* parse_decleration();
     Ast* parse_statement();
     Ast_Expression* parse_expression();
-    Ast_Expression* parse_unary_expression();
+    void push_operand(Ast_Expression* expr, int height);
+    void reduce_prefix();
+    void reduce_binary();
     Ast_Expression* parse_posfix_expression();
+    Ast_Expression* parse_subscripts(Ast_Expression* expr);
     Ast_Expression* parse_primary_expression();
     Ast_Function_Definition* parse_function_definition();
     Ast_Function_Call* parse_function_call();
 
     Ast_Function_Definition* parse_function_decleration();
+    Ast_Function_Definition* parse_memoize_attribute();
+    Ast_Struct* parse_struct_definition();
+    Ast_For* parse_for_statement(bool simd);
+    Ast_For* parse_parallel_for();
 
     Ast_Expression* parse_postfix_symbol();
 
@@ -245,6 +407,21 @@ struct Parser {
 
     void add_identifier_to_scope(Ast_Decleration* dec);
 
+    Array<Pending_Operator> operators;
+    Array<Pending_Operand> operands;
+
+    // Blocks and bracketed sub-expressions still recurse, both are cut off at options.max_depth.
+    int scope_depth = 0;
+    int expression_depth = 0;
+    int nested_height = 0;
+    bool too_deep = false;
+
+    // The deepest nesting seen, stored with a cached tree so a lower --max-depth still rejects it.
+    int deepest = 0;
+
+    bool check_depth(int depth);
+    void skip_nested();
+
     int error_count = 0;
 };
 
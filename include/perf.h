@@ -0,0 +1,35 @@
+#ifndef PERF_H
+#define PERF_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define MAX_PERF_PHASES 16
+
+enum {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_CACHE_MISSES,
+    PERF_BRANCH_MISSES,
+    PERF_COUNTER_COUNT
+};
+
+struct Perf_Phase {
+    const char* label;
+    const char* unit;
+
+    double values[PERF_COUNTER_COUNT];
+    uint64_t units;
+    int samples;
+};
+
+// Returns false, after a warning, when the kernel or the machine gives us no counters at all.
+bool open_perf_counters();
+
+// Phases do not nest; the counts of a phase are normalized by the units it processed.
+void begin_perf_phase(const char* label);
+void end_perf_phase(uint64_t units, const char* unit);
+
+void report_perf_counters(FILE* file);
+
+#endif //!PERF_H
@@ -0,0 +1,24 @@
+#ifndef PURITY_H
+#define PURITY_H
+
+#include "parser.h"
+
+struct Purity {
+    Array<Ast_Decleration*> globals;
+    Ast_Function_Definition* current = nullptr;
+    bool pure = true;
+    bool recursive = false;
+
+    bool is_mutable_global(Ast_Decleration* dec);
+
+    void visit_expression(Ast_Expression* expr);
+    void visit_function_call(Ast_Function_Call* call);
+    void visit_statement(Ast* ast);
+    void visit_scope(Ast_Scope* scope);
+
+    bool check_function(Ast_Function_Definition* func);
+};
+
+void analyze_purity(Ast_Translation_Unit* root);
+
+#endif //!PURITY_H
@@ -0,0 +1,102 @@
+#ifndef SEMA_H
+#define SEMA_H
+
+#include "parser.h"
+
+Ast_Type* canonical_type(int atom_type, bool constant = false);
+
+Ast_Type* canonical_type(Ast_Type* type);
+
+Ast_Type* unqualified_type(Ast_Type* type);
+
+const char* type_name(Ast_Type* type);
+
+bool is_integral_type(Ast_Type* type);
+
+bool is_floating_type(Ast_Type* type);
+
+bool is_composite_type(Ast_Type* type);
+
+int64_t type_size(Ast_Type* type);
+
+Array<Ast_Type*>* interned_types();
+
+bool is_arena_mark(Ast_Expression* expr);
+
+// Each binding remembers the one it shadows, so leaving a scope restores the outer names without a search.
+struct Sema_Binding {
+    const char* name;
+    Ast_Decleration* dec;
+    uint32_t slot;
+    int shadowed;
+};
+
+// A name seen anywhere in the program and the innermost binding of it still in scope, -1 when there is none.
+struct Sema_Name {
+    const char* name;
+    int binding;
+};
+
+struct Sema {
+    Array<Sema_Binding> bindings;
+
+    // Open addressed by name; names are never removed, only their binding goes back to -1.
+    Sema_Name* names = nullptr;
+    uint32_t name_mask = 0;
+    uint32_t name_count = 0;
+
+    Ast_Function_Definition* current_function = nullptr;
+    int loop_depth = 0;
+    int error_count = 0;
+
+    bool field_access = false;
+
+    // Links of the operator chains being checked, each check only pops back down to where it started.
+    Array<Ast_Binary_Expression*> chain;
+
+    size_t function_marker = 0;
+    Ast_For* parallel_loop = nullptr;
+    size_t parallel_marker = 0;
+    int parallel_loop_depth = 0;
+
+    uint32_t find_name(const char* name);
+    uint32_t insert_name(const char* name);
+    Ast_Decleration* look_up(const char* name);
+    void bind(Ast_Decleration* dec);
+    void unbind(size_t marker);
+    int binding_of(Ast_Decleration* dec);
+    void capture(Ast* at, Ast_Decleration* dec, bool write);
+
+    void error(Ast* at, const char* fmt, ...);
+
+    bool is_lvalue(Ast_Expression* expr);
+    bool is_constant_storage(Ast_Expression* expr);
+    void check_assignable(Ast_Expression* target);
+    void check_conversion(Ast* at, Ast_Type* from, Ast_Type* to);
+
+    Ast_Type* check_expression(Ast_Expression* expr);
+    Ast_Type* check_binary_expression(Ast_Binary_Expression* bin);
+    Ast_Type* check_binary_operator(Ast_Binary_Expression* bin, Ast_Type* left, Ast_Type* right);
+    Ast_Type* check_vector_binary_expression(Ast_Binary_Expression* bin, Ast_Type* left, Ast_Type* right);
+    Ast_Type* check_unary_expression(Ast_Unary_Expression* unary);
+    Ast_Type* check_primary_expression(Ast_Primary_Expression* prime);
+    Ast_Type* check_index_expression(Ast_Index_Expression* index);
+    Ast_Type* check_field_expression(Ast_Field_Expression* field);
+    Ast_Type* check_new_expression(Ast_New_Expression* alloc);
+    Ast_Type* check_vector_expression(Ast_Vector_Expression* vector);
+    Ast_Type* check_function_call(Ast_Function_Call* call);
+    Ast_Type* resolve_type(Ast* at, Ast_Type* type);
+    void check_type(Ast* at, Ast_Type* type);
+    void check_condition(Ast_Expression* condition);
+    void check_assignment_chain(Ast_Expression* expr, Ast_Type* target_type);
+    void check_decleration(Ast_Decleration* dec);
+    void check_function_definition(Ast_Function_Definition* func);
+    void check_struct_definition(Ast_Struct* record);
+    void check_for_statement(Ast_For* loop);
+    void check_statement(Ast* ast);
+    void check_scope(Ast_Scope* scope);
+};
+
+int check_translation_unit(Ast_Translation_Unit* root);
+
+#endif //!SEMA_H
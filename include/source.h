@@ -0,0 +1,47 @@
+#ifndef SOURCE_H
+#define SOURCE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define SOURCE_FILE_MODE "r"
+
+// A location is an offset into the space of every loaded file; each file owns the range starting at its base.
+// 0 is never handed out, so it means "no location".
+typedef uint32_t Source_Location;
+
+struct Source_File {
+    const char* name;
+    uint8_t* text;
+    uint32_t size;
+    Source_Location base;
+
+    // Offsets where each line begins, only built the first time a location in this file is decomposed.
+    uint32_t* line_starts = nullptr;
+    uint32_t line_count = 0;
+};
+
+struct Source_Manager {
+    Source_File** files = nullptr;
+    int file_count = 0;
+    int capacity = 0;
+    Source_Location next_base = 1;
+
+    // Reads the whole file, NUL terminated and padded for the literal scanner.
+    Source_File* load_file(const char* path);
+
+    // Takes ownership of the text, which has to be padded the same way and is freed by clear().
+    Source_File* add_file(const char* name, uint8_t* text, size_t size);
+
+    Source_File* file_of(Source_Location loc);
+
+    uint32_t line_of(Source_Location loc);
+    uint32_t column_of(Source_Location loc);
+    uint32_t lines_in(Source_File* file);
+
+    void clear();
+};
+
+extern Source_Manager source_manager;
+
+#endif //!SOURCE_H
@@ -0,0 +1,38 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+enum {
+    MEM_SOURCE,
+    MEM_TOKENS,
+    MEM_AST,
+    MEM_SYMBOLS,
+    MEM_STRINGS,
+    MEM_BACKEND,
+    MEM_CATEGORY_COUNT
+};
+
+enum {
+    STAT_TOKENS,
+    STAT_NODES,
+    STAT_SCOPES,
+    STAT_SYMBOLS,
+    STAT_IDENTIFIERS,
+    STAT_IR_VALUES,
+    STAT_COUNT
+};
+
+// A negative size records memory that was given back or a buffer that shrank.
+void track_allocation(int category, int64_t bytes);
+
+void count_stat(int stat, uint64_t amount = 1);
+void set_stat(int stat, uint64_t value);
+
+// Starts a new translation unit; categories and counts only ever describe the last one.
+void reset_stats();
+
+void report_stats(FILE* file);
+
+#endif //!STATS_H
@@ -0,0 +1,46 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include "arr.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define MAX_TIMER_NODES 128
+#define MAX_TIMER_DEPTH 32
+#define MAX_TIMER_COUNTS 16
+
+uint64_t monotonic_ns();
+
+// One node per distinct label under a given parent, so re-entering a phase accumulates into it.
+struct Timer_Node {
+    const char* label;
+    int parent;
+    int depth;
+
+    uint64_t pending;
+    bool entered;
+    Array<uint64_t> samples;
+};
+
+void begin_timer(const char* label);
+
+// Returns the nanoseconds spent in the region that was just closed.
+uint64_t end_timer();
+
+// Closes a run, turning the time each node accumulated into one sample.
+void end_timer_run();
+
+// Amount of work done in a run (tokens, nodes, bytes), reported next to the timings.
+void record_timer_count(const char* label, uint64_t value);
+
+void report_timers(FILE* file);
+
+void write_time_report(FILE* file);
+
+struct Scoped_Timer {
+    Scoped_Timer(const char* label) { begin_timer(label); }
+    ~Scoped_Timer() { end_timer(); }
+};
+
+#endif //!TIMER_H
@@ -0,0 +1,40 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "arr.h"
+
+#include <stdint.h>
+
+struct Trace_Event {
+    const char* category;
+    size_t name;
+    uint64_t begin;
+    uint64_t end;
+};
+
+// Every thread records into its own buffer; buffers are only read when the trace is written at exit.
+struct Trace_Buffer {
+    int tid;
+    Array<Trace_Event> events;
+    Array<size_t> open;
+
+    // Span names are copied here, since identifiers read from an AST cache go away with its mapping.
+    String names;
+};
+
+extern bool trace_enabled;
+
+// Starts recording and writes the trace to the file when the process exits, fatal errors included.
+void enable_trace(const char* path);
+
+// Names are copied, categories must outlive the trace.
+void begin_trace(const char* category, const char* name);
+void rename_trace(const char* name);
+void end_trace();
+
+struct Scoped_Trace {
+    Scoped_Trace(const char* category, const char* name) { if (trace_enabled) begin_trace(category, name); }
+    ~Scoped_Trace() { if (trace_enabled) end_trace(); }
+};
+
+#endif //!TRACE_H
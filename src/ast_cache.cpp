@@ -0,0 +1,937 @@
+#include "../include/ast_cache.h"
+#include "../include/hash.h"
+#include "../include/err.h"
+#include "../include/options.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Node layouts, by type:
+//   identifier   value = name
+//   type         op = atom type, flags = constant | soa, value = length, child 0 = element, 1 = struct name
+//   decleration  child 0 = type, 1 = id, 2 = expression chain (assignments too)
+//   function     flags = function flags, op = has a body, value = memo size | prefill << 32,
+//                child 0 = return type, 1 = id, 2 = arguments, 3 = body, 4 = foreign header
+//   call         flags = run in directive, child 1 = id, 2 = arguments
+//   struct       child 1 = id, 2 = fields
+//   statement    flags = return/break/continue, child 2 = expression
+//   condition    op = control flag, child 0 = condition, 3 = body, 4 = next branch
+//   for          flags = simd | parallel, value = grain, child 0 = iterator, 1 = begin, 2 = end, 3 = body,
+//                4 = reductions (identifiers with op = reduction)
+//   binary       op, child 0 = left, 1 = right
+//   unary        op, child 0 = expression, 1 = nested expression
+//   primary      op = value type, value = constant or string, child 0 = identifier or call, 1 = postfix
+//   postfix      op
+//   index        op = postfix, flags = checked, child 0 = base, 1 = index
+//   field        child 0 = base, 1 = field
+//   new          child 0 = element type, 1 = count, 2 = arena
+//   vector       op = form, flags = checked, child 0 = vector type, 1 = arguments
+enum {
+    NEOAST_CONSTANT = 0x01,
+    NEOAST_SOA = 0x02,
+    NEOAST_CHECKED = 0x01,
+    NEOAST_DIRECTIVE = 0x01,
+    NEOAST_SIMD = 0x01,
+    NEOAST_PARALLEL = 0x02
+};
+
+#define NEOAST_MAX_ARGS 64
+
+// Any change to a record has to come with a new NEOAST_VERSION; update these sizes when it does.
+static_assert(sizeof(Neoast_Header) == 72 && sizeof(Neoast_Node) == 40 && NEOAST_VERSION == 3, "a .neoast record changed, bump NEOAST_VERSION");
+
+// A compiler built from other sources may parse differently, so the hash of its sources the Makefile passes in
+// is part of the key. A build without one falls back on the time this file was compiled.
+static uint64_t compiler_stamp() {
+#ifdef NEO_SOURCE_HASH
+    uint64_t sources = NEO_SOURCE_HASH;
+    return hash_bytes(&sources, sizeof(sources), NEOAST_VERSION);
+#else
+    return hash_string(__DATE__ " " __TIME__, NEOAST_VERSION);
+#endif
+}
+
+struct Ast_Cache_Writer {
+    uint8_t* data = nullptr;
+    uint32_t size = 0;
+    uint32_t capacity = 0;
+    uint32_t node_count = 0;
+    Source_Location base = 0;
+
+    char* strings = nullptr;
+    uint32_t strings_size = 0;
+    uint32_t strings_capacity = 0;
+
+    // Open addressing over string offsets, stored plus one so zero marks an empty slot.
+    uint32_t* slots = nullptr;
+    uint32_t slot_count = 0;
+    uint32_t interned = 0;
+
+    // The operator chain being written and the node of each of its links.
+    Array<Ast_Binary_Expression*> chain;
+    Array<uint32_t> chain_nodes;
+
+    uint32_t allocate(uint32_t bytes);
+    Neoast_Node* node_at(uint32_t at) { return (Neoast_Node*) (data + at); }
+    Neoast_List* list_at(uint32_t at) { return (Neoast_List*) (data + at); }
+
+    uint32_t new_node(Ast* ast, int type);
+    uint32_t new_list(uint32_t count);
+    void link(uint32_t at, int slot, uint32_t target);
+    void set_item(uint32_t list, uint32_t index, uint32_t target);
+    uint32_t intern(const char* str);
+
+    uint32_t write_ident(Ast_Ident* id);
+    uint32_t write_type(Ast_Type* type);
+    uint32_t write_expression(Ast_Expression* expr);
+    uint32_t write_expressions(Ast_Expression** exprs, size_t count);
+    uint32_t write_function_call(Ast_Function_Call* call);
+    uint32_t write_decleration(Ast_Decleration* dec);
+    uint32_t write_declerations(Ast_Decleration** decs, size_t count);
+    uint32_t write_function_definition(Ast_Function_Definition* func);
+    uint32_t write_statement(Ast* ast);
+    uint32_t write_scope(Ast_Scope* scope);
+};
+
+uint32_t Ast_Cache_Writer::allocate(uint32_t bytes) {
+    bytes = (bytes + 7) & ~7u;
+    if (size + bytes > capacity) {
+        uint32_t grown = (capacity) ? capacity * 2 : 4096;
+        while (grown < size + bytes)
+            grown *= 2;
+        data = (uint8_t*) realloc(data, grown);
+        capacity = grown;
+    }
+
+    uint32_t at = size;
+    memset(data + at, 0, bytes);
+    size += bytes;
+    return at;
+}
+
+uint32_t Ast_Cache_Writer::new_node(Ast* ast, int type) {
+    uint32_t at = allocate(sizeof(Neoast_Node));
+    Neoast_Node* node = node_at(at);
+    node->type = type;
+    node->offset = ast->loc - base;
+    node_count++;
+    return at;
+}
+
+uint32_t Ast_Cache_Writer::new_list(uint32_t count) {
+    uint32_t at = allocate(sizeof(Neoast_List) + sizeof(int32_t) * count);
+    list_at(at)->count = count;
+    return at;
+}
+
+// Children are always written after their parent, so every offset is positive.
+void Ast_Cache_Writer::link(uint32_t at, int slot, uint32_t target) {
+    if (target)
+        node_at(at)->child[slot] = (int32_t) (target - at);
+}
+
+void Ast_Cache_Writer::set_item(uint32_t list, uint32_t index, uint32_t target) {
+    if (target)
+        list_at(list)->items[index] = (int32_t) (target - list);
+}
+
+uint32_t Ast_Cache_Writer::intern(const char* str) {
+    if (interned * 2 >= slot_count) {
+        uint32_t old_count = slot_count;
+        uint32_t* old_slots = slots;
+
+        slot_count = (slot_count) ? slot_count * 2 : 1024;
+        slots = (uint32_t*) calloc(slot_count, sizeof(uint32_t));
+        for (uint32_t i = 0; i < old_count; i++) {
+            if (!old_slots[i])
+                continue;
+            uint32_t slot = hash_string(strings + old_slots[i] - 1) & (slot_count - 1);
+            while (slots[slot])
+                slot = (slot + 1) & (slot_count - 1);
+            slots[slot] = old_slots[i];
+        }
+        free(old_slots);
+    }
+
+    uint32_t slot = hash_string(str) & (slot_count - 1);
+    for (; slots[slot]; slot = (slot + 1) & (slot_count - 1)) {
+        if (strcmp(strings + slots[slot] - 1, str) == 0)
+            return slots[slot] - 1;
+    }
+
+    uint32_t length = strlen(str) + 1;
+    if (strings_size + length > strings_capacity) {
+        while (strings_size + length > strings_capacity)
+            strings_capacity = (strings_capacity) ? strings_capacity * 2 : 4096;
+        strings = (char*) realloc(strings, strings_capacity);
+    }
+
+    uint32_t at = strings_size;
+    memcpy(strings + at, str, length);
+    strings_size += length;
+
+    slots[slot] = at + 1;
+    interned++;
+    return at;
+}
+
+uint32_t Ast_Cache_Writer::write_ident(Ast_Ident* id) {
+    if (!id)
+        return 0;
+
+    uint32_t at = new_node(id, AST_IDENTIFIER);
+    uint32_t name = intern(id->name);
+    node_at(at)->value = name;
+    return at;
+}
+
+uint32_t Ast_Cache_Writer::write_type(Ast_Type* type) {
+    if (!type)
+        return 0;
+
+    uint32_t at = new_node(type, AST_TYPE);
+    Neoast_Node* node = node_at(at);
+    node->op = type->atom_type;
+    node->flags = ((type->constant) ? NEOAST_CONSTANT : 0) | ((type->soa) ? NEOAST_SOA : 0);
+    node->value = type->length;
+
+    link(at, 0, write_type(type->element));
+    link(at, 1, write_ident(type->name));
+    return at;
+}
+
+uint32_t Ast_Cache_Writer::write_expression(Ast_Expression* expr) {
+    if (!expr)
+        return 0;
+
+    uint32_t at = new_node(expr, expr->type);
+    switch (expr->type) {
+    case AST_BINARY_EXPRESSION: {
+        // The links of a chain are written down its spine, then their right operands from the bottom up.
+        size_t base = chain.top();
+        push_chain(static_cast<Ast_Binary_Expression*>(expr), &chain);
+        chain_nodes.push(at);
+        for (size_t i = base; i < chain.top(); i++) {
+            if (i > base) {
+                uint32_t below = new_node(chain.get(i), AST_BINARY_EXPRESSION);
+                link(chain_nodes.get(i - 1), 0, below);
+                chain_nodes.push(below);
+            }
+            node_at(chain_nodes.get(i))->op = chain.get(i)->op;
+        }
+
+        link(chain_nodes.get(chain.top() - 1), 0, write_expression(chain.get(chain.top() - 1)->left));
+        while (chain.top() > base) {
+            link(chain_nodes.get(chain.top() - 1), 1, write_expression(chain.get(chain.top() - 1)->right));
+            chain.pop();
+            chain_nodes.pop();
+        }
+        break;
+    }
+    case AST_UNARY_EXPESSION: {
+        auto unary = static_cast<Ast_Unary_Expression*>(expr);
+        node_at(at)->op = unary->op;
+        link(at, 0, write_expression(unary->expr));
+        link(at, 1, write_expression(unary->nested_expr));
+        break;
+    }
+    case AST_PRIMARY_EXPRESSION: {
+        auto prime = static_cast<Ast_Primary_Expression*>(expr);
+        node_at(at)->op = prime->v_type;
+        switch (prime->v_type) {
+        case AST_INT_P:   node_at(at)->value = prime->int_const; break;
+        case AST_FLOAT_P: memcpy(&node_at(at)->value, &prime->float_const, sizeof(double)); break;
+        case AST_CHAR_P:  node_at(at)->value = prime->char_const; break;
+        case AST_STR_P: {
+            uint32_t literal = intern(prime->string_literal);
+            node_at(at)->value = literal;
+            break;
+        }
+        case AST_ID_P:    link(at, 0, write_ident(prime->ident)); break;
+        case AST_CALL_P:  link(at, 0, write_function_call(prime->call)); break;
+        }
+        link(at, 1, write_expression(prime->expr));
+        break;
+    }
+    case AST_INDEX_EXPRESSION: {
+        auto index = static_cast<Ast_Index_Expression*>(expr);
+        node_at(at)->op = index->postfix;
+        node_at(at)->flags = (index->checked) ? NEOAST_CHECKED : 0;
+        link(at, 0, write_expression(index->base));
+        link(at, 1, write_expression(index->index));
+        break;
+    }
+    case AST_FIELD_EXPRESSION: {
+        auto field = static_cast<Ast_Field_Expression*>(expr);
+        link(at, 0, write_expression(field->base));
+        link(at, 1, write_ident(field->field));
+        break;
+    }
+    case AST_NEW_EXPRESSION: {
+        auto alloc = static_cast<Ast_New_Expression*>(expr);
+        link(at, 0, write_type(alloc->element));
+        link(at, 1, write_expression(alloc->count));
+        link(at, 2, write_expression(alloc->arena));
+        break;
+    }
+    case AST_VECTOR_EXPRESSION: {
+        auto vector = static_cast<Ast_Vector_Expression*>(expr);
+        node_at(at)->op = vector->form;
+        node_at(at)->flags = (vector->checked) ? NEOAST_CHECKED : 0;
+        link(at, 0, write_type(vector->vector));
+        link(at, 1, write_expressions(vector->args, vector->arg_count));
+        break;
+    }
+    default:
+        node_at(at)->op = static_cast<Ast_Postfix_Expression*>(expr)->op;
+        break;
+    }
+
+    link(at, 4, write_expression(expr->next));
+    return at;
+}
+
+uint32_t Ast_Cache_Writer::write_expressions(Ast_Expression** exprs, size_t count) {
+    uint32_t list = new_list(count);
+    for (size_t i = 0; i < count; i++)
+        set_item(list, i, write_expression(exprs[i]));
+    return list;
+}
+
+uint32_t Ast_Cache_Writer::write_function_call(Ast_Function_Call* call) {
+    uint32_t at = new_node(call, AST_FUNCTION_CALL);
+    node_at(at)->flags = (call->run_in_directive) ? NEOAST_DIRECTIVE : 0;
+    link(at, 1, write_ident(call->id));
+    link(at, 2, write_expressions(call->args, call->arg_count));
+    return at;
+}
+
+uint32_t Ast_Cache_Writer::write_decleration(Ast_Decleration* dec) {
+    if (!dec)
+        return 0;
+
+    uint32_t at = new_node(dec, dec->type);
+    link(at, 0, write_type(dec->type_info));
+    link(at, 1, write_ident(dec->id));
+    link(at, 2, write_expression(dec->expr));
+    return at;
+}
+
+uint32_t Ast_Cache_Writer::write_declerations(Ast_Decleration** decs, size_t count) {
+    uint32_t list = new_list(count);
+    for (size_t i = 0; i < count; i++)
+        set_item(list, i, write_decleration(decs[i]));
+    return list;
+}
+
+uint32_t Ast_Cache_Writer::write_function_definition(Ast_Function_Definition* func) {
+    uint32_t at = new_node(func, AST_FUNCTION_DEFINITION);
+    Neoast_Node* node = node_at(at);
+    node->flags = func->flags;
+    node->op = (func->scope.parent != nullptr);
+    node->value = (int64_t) ((uint64_t) (uint32_t) func->memo_size | ((uint64_t) (uint32_t) func->memo_prefill << 32));
+
+    link(at, 0, write_type(func->type_info));
+    link(at, 1, write_ident(func->id));
+    link(at, 2, write_declerations(func->args, func->arg_count));
+    link(at, 3, write_scope(&func->scope));
+    link(at, 4, write_ident(func->from));
+    return at;
+}
+
+uint32_t Ast_Cache_Writer::write_statement(Ast* ast) {
+    if (!ast)
+        return 0;
+
+    switch (ast->type) {
+    case AST_STATEMENT: {
+        auto stmt = static_cast<Ast_Statement*>(ast);
+        uint32_t at = new_node(stmt, AST_STATEMENT);
+        node_at(at)->flags = stmt->flags;
+        link(at, 2, write_expression(stmt->expr));
+        return at;
+    }
+    case AST_CONDITION: {
+        // Each 'elif' and 'else' hangs off the branch before it.
+        uint32_t first = 0;
+        uint32_t previous = 0;
+        for (auto condition = static_cast<Ast_ControlFlow*>(ast); condition; condition = condition->next) {
+            uint32_t at = new_node(condition, AST_CONDITION);
+            node_at(at)->op = condition->flag;
+            link(at, 0, write_expression(condition->condition));
+            link(at, 3, write_scope(&condition->scope));
+
+            if (previous)
+                link(previous, 4, at);
+            else
+                first = at;
+            previous = at;
+        }
+        return first;
+    }
+    case AST_FOR: {
+        auto loop = static_cast<Ast_For*>(ast);
+        uint32_t at = new_node(loop, AST_FOR);
+        node_at(at)->flags = ((loop->simd) ? NEOAST_SIMD : 0) | ((loop->parallel) ? NEOAST_PARALLEL : 0);
+        node_at(at)->value = loop->grain;
+
+        link(at, 0, write_decleration(loop->iterator));
+        link(at, 1, write_expression(loop->begin));
+        link(at, 2, write_expression(loop->end));
+        link(at, 3, write_scope(&loop->scope));
+
+        uint32_t reductions = new_list(loop->reductions.top());
+        for (size_t i = 0; i < loop->reductions.top(); i++) {
+            uint32_t ident = write_ident(loop->reductions.get(i).ident);
+            node_at(ident)->op = loop->reductions.get(i).op;
+            set_item(reductions, i, ident);
+        }
+        link(at, 4, reductions);
+        return at;
+    }
+    case AST_STRUCT: {
+        auto record = static_cast<Ast_Struct*>(ast);
+        uint32_t at = new_node(record, AST_STRUCT);
+        link(at, 1, write_ident(record->id));
+        link(at, 2, write_declerations(record->fields, record->field_count));
+        return at;
+    }
+    case AST_FUNCTION_DEFINITION:
+        return write_function_definition(static_cast<Ast_Function_Definition*>(ast));
+    case AST_FUNCTION_CALL:
+        return write_function_call(static_cast<Ast_Function_Call*>(ast));
+    default:
+        return write_decleration(static_cast<Ast_Decleration*>(ast));
+    }
+}
+
+uint32_t Ast_Cache_Writer::write_scope(Ast_Scope* scope) {
+    uint32_t list = new_list(scope->size);
+    for (int i = 0; i < scope->size; i++)
+        set_item(list, i, write_statement(scope->statements[i]));
+    return list;
+}
+
+#define CACHE_NEW(type, node) \
+    (track_allocation(MEM_AST, sizeof(type)), static_cast<type*>(fill(new type, node)))
+
+// Anything out of bounds or of the wrong type marks the whole file bad and it is parsed again.
+struct Ast_Cache_Reader {
+    const uint8_t* data;
+    uint32_t strings;
+    uint32_t strings_size;
+    Source_File* source;
+
+    Ast_Scope* current_scope = nullptr;
+    uint32_t node_count = 0;
+    bool bad = false;
+
+    const Neoast_Node* node_at(uint64_t at, int type = -1);
+    const Neoast_List* list_at(uint64_t at);
+    const Neoast_Node* child(const Neoast_Node* node, int slot, int type = -1);
+    const Neoast_List* list(const Neoast_Node* node, int slot, uint32_t limit = UINT32_MAX);
+    const Neoast_Node* item(const Neoast_List* list, uint32_t index, int type = -1);
+    char* string(int64_t ref);
+    Ast* fill(Ast* ast, const Neoast_Node* node);
+
+    Ast_Ident* read_ident(const Neoast_Node* node);
+    Ast_Type* read_type(const Neoast_Node* node);
+    Ast_Expression* read_expression(const Neoast_Node* node);
+    Ast_Function_Call* read_function_call(const Neoast_Node* node);
+    Ast_Decleration* read_decleration(const Neoast_Node* node);
+    Ast_Function_Definition* read_function_definition(const Neoast_Node* node);
+    Ast* read_statement(const Neoast_Node* node);
+    void read_scope(Ast_Scope* scope, const Neoast_List* list);
+    Ast_Translation_Unit* read_translation_unit(const Neoast_Node* node);
+};
+
+const Neoast_Node* Ast_Cache_Reader::node_at(uint64_t at, int type) {
+    if (at < sizeof(Neoast_Header) || at % 8 != 0 || at + sizeof(Neoast_Node) > strings) {
+        bad = true;
+        return nullptr;
+    }
+
+    const Neoast_Node* node = (const Neoast_Node*) (data + at);
+    if (type != -1 && node->type != type) {
+        bad = true;
+        return nullptr;
+    }
+    return node;
+}
+
+const Neoast_List* Ast_Cache_Reader::list_at(uint64_t at) {
+    if (at < sizeof(Neoast_Header) || at % 8 != 0 || at + sizeof(Neoast_List) > strings) {
+        bad = true;
+        return nullptr;
+    }
+
+    const Neoast_List* list = (const Neoast_List*) (data + at);
+    if (at + sizeof(Neoast_List) + sizeof(int32_t) * (uint64_t) list->count > strings) {
+        bad = true;
+        return nullptr;
+    }
+    return list;
+}
+
+const Neoast_Node* Ast_Cache_Reader::child(const Neoast_Node* node, int slot, int type) {
+    int32_t offset = node->child[slot];
+    if (offset == 0)
+        return nullptr;
+    if (offset < 0) {
+        bad = true;
+        return nullptr;
+    }
+    return node_at((const uint8_t*) node - data + offset, type);
+}
+
+const Neoast_List* Ast_Cache_Reader::list(const Neoast_Node* node, int slot, uint32_t limit) {
+    int32_t offset = node->child[slot];
+    if (offset <= 0) {
+        bad = true;
+        return nullptr;
+    }
+
+    const Neoast_List* list = list_at((const uint8_t*) node - data + offset);
+    if (list && list->count > limit) {
+        bad = true;
+        return nullptr;
+    }
+    return list;
+}
+
+const Neoast_Node* Ast_Cache_Reader::item(const Neoast_List* list, uint32_t index, int type) {
+    int32_t offset = list->items[index];
+    if (offset == 0)
+        return nullptr;
+    if (offset < 0) {
+        bad = true;
+        return nullptr;
+    }
+    return node_at((const uint8_t*) list - data + offset, type);
+}
+
+char* Ast_Cache_Reader::string(int64_t ref) {
+    if (ref < 0 || ref >= strings_size) {
+        bad = true;
+        return (char*) "";
+    }
+    return (char*) (data + strings + ref);
+}
+
+Ast* Ast_Cache_Reader::fill(Ast* ast, const Neoast_Node* node) {
+    if (node->offset > source->size)
+        bad = true;
+    ast->loc = source->base + node->offset;
+    node_count++;
+    return ast;
+}
+
+Ast_Ident* Ast_Cache_Reader::read_ident(const Neoast_Node* node) {
+    if (!node)
+        return nullptr;
+
+    auto id = CACHE_NEW(Ast_Ident, node);
+    id->name = string(node->value);
+    count_stat(STAT_IDENTIFIERS);
+    return id;
+}
+
+Ast_Type* Ast_Cache_Reader::read_type(const Neoast_Node* node) {
+    if (!node)
+        return nullptr;
+
+    auto type = CACHE_NEW(Ast_Type, node);
+    type->atom_type = node->op;
+    type->constant = (node->flags & NEOAST_CONSTANT);
+    type->soa = (node->flags & NEOAST_SOA);
+    type->length = node->value;
+    type->element = read_type(child(node, 0, AST_TYPE));
+    type->name = read_ident(child(node, 1, AST_IDENTIFIER));
+    return type;
+}
+
+Ast_Expression* Ast_Cache_Reader::read_expression(const Neoast_Node* node) {
+    if (!node || bad)
+        return nullptr;
+
+    Ast_Expression* expr = nullptr;
+    switch (node->type) {
+    case AST_BINARY_EXPRESSION: {
+        // A chain is read down its spine, each link hung on the left of the one above it.
+        auto bin = CACHE_NEW(Ast_Binary_Expression, node);
+        expr = bin;
+        for (const Neoast_Node* at = node;;) {
+            bin->op = at->op;
+            bin->right = read_expression(child(at, 1));
+
+            const Neoast_Node* left = child(at, 0);
+            if (!left || left->type != AST_BINARY_EXPRESSION || bad) {
+                bin->left = read_expression(left);
+                break;
+            }
+            auto link = CACHE_NEW(Ast_Binary_Expression, left);
+            bin->left = link;
+            bin = link;
+            at = left;
+        }
+        break;
+    }
+    case AST_UNARY_EXPESSION: {
+        auto unary = CACHE_NEW(Ast_Unary_Expression, node);
+        unary->op = node->op;
+        unary->expr = read_expression(child(node, 0));
+        unary->nested_expr = read_expression(child(node, 1));
+        expr = unary;
+        break;
+    }
+    case AST_PRIMARY_EXPRESSION: {
+        auto prime = CACHE_NEW(Ast_Primary_Expression, node);
+        prime->v_type = node->op;
+        switch (prime->v_type) {
+        case AST_INT_P:   prime->int_const = node->value; break;
+        case AST_FLOAT_P: memcpy(&prime->float_const, &node->value, sizeof(double)); break;
+        case AST_CHAR_P:  prime->char_const = (char) node->value; break;
+        case AST_STR_P:   prime->string_literal = string(node->value); break;
+        case AST_ID_P:    prime->ident = read_ident(child(node, 0, AST_IDENTIFIER)); break;
+        case AST_CALL_P:  prime->call = read_function_call(child(node, 0, AST_FUNCTION_CALL)); break;
+        default:          bad = true; break;
+        }
+        prime->expr = read_expression(child(node, 1, AST_EXPRESSION));
+        expr = prime;
+        break;
+    }
+    case AST_INDEX_EXPRESSION: {
+        auto index = CACHE_NEW(Ast_Index_Expression, node);
+        index->postfix = node->op;
+        index->checked = (node->flags & NEOAST_CHECKED);
+        index->base = read_expression(child(node, 0));
+        index->index = read_expression(child(node, 1));
+        expr = index;
+        break;
+    }
+    case AST_FIELD_EXPRESSION: {
+        auto field = CACHE_NEW(Ast_Field_Expression, node);
+        field->base = read_expression(child(node, 0));
+        field->field = read_ident(child(node, 1, AST_IDENTIFIER));
+        expr = field;
+        break;
+    }
+    case AST_NEW_EXPRESSION: {
+        auto alloc = CACHE_NEW(Ast_New_Expression, node);
+        alloc->element = read_type(child(node, 0, AST_TYPE));
+        alloc->count = read_expression(child(node, 1));
+        alloc->arena = read_expression(child(node, 2));
+        expr = alloc;
+        break;
+    }
+    case AST_VECTOR_EXPRESSION: {
+        auto vector = CACHE_NEW(Ast_Vector_Expression, node);
+        vector->form = node->op;
+        vector->checked = (node->flags & NEOAST_CHECKED);
+        vector->vector = read_type(child(node, 0, AST_TYPE));
+
+        const Neoast_List* args = list(node, 1, NEOAST_MAX_ARGS);
+        for (uint32_t i = 0; args && i < args->count; i++)
+            vector->args[vector->arg_count++] = read_expression(item(args, i));
+        expr = vector;
+        break;
+    }
+    case AST_EXPRESSION: {
+        auto postfix = CACHE_NEW(Ast_Postfix_Expression, node);
+        postfix->op = node->op;
+        expr = postfix;
+        break;
+    }
+    default:
+        bad = true;
+        return nullptr;
+    }
+
+    expr->next = read_expression(child(node, 4));
+    return expr;
+}
+
+Ast_Function_Call* Ast_Cache_Reader::read_function_call(const Neoast_Node* node) {
+    if (!node)
+        return nullptr;
+
+    auto call = CACHE_NEW(Ast_Function_Call, node);
+    call->run_in_directive = (node->flags & NEOAST_DIRECTIVE);
+    call->id = read_ident(child(node, 1, AST_IDENTIFIER));
+
+    const Neoast_List* args = list(node, 2, NEOAST_MAX_ARGS);
+    for (uint32_t i = 0; args && i < args->count; i++)
+        call->args[call->arg_count++] = read_expression(item(args, i));
+    return call;
+}
+
+Ast_Decleration* Ast_Cache_Reader::read_decleration(const Neoast_Node* node) {
+    if (!node)
+        return nullptr;
+    if (node->type != AST_DECLERATION && node->type != AST_ASSIGNMENT) {
+        bad = true;
+        return nullptr;
+    }
+
+    auto dec = CACHE_NEW(Ast_Decleration, node);
+    dec->type = node->type;
+    dec->type_info = read_type(child(node, 0, AST_TYPE));
+    dec->id = read_ident(child(node, 1, AST_IDENTIFIER));
+    dec->expr = read_expression(child(node, 2));
+    return dec;
+}
+
+Ast_Function_Definition* Ast_Cache_Reader::read_function_definition(const Neoast_Node* node) {
+    auto func = CACHE_NEW(Ast_Function_Definition, node);
+    func->flags = node->flags;
+    func->memo_size = (int) (uint32_t) node->value;
+    func->memo_prefill = (int) (uint32_t) ((uint64_t) node->value >> 32);
+    func->type_info = read_type(child(node, 0, AST_TYPE));
+    func->id = read_ident(child(node, 1, AST_IDENTIFIER));
+    func->from = read_ident(child(node, 4, AST_IDENTIFIER));
+
+    const Neoast_List* args = list(node, 2, NEOAST_MAX_ARGS);
+    for (uint32_t i = 0; args && i < args->count; i++)
+        func->args[func->arg_count++] = read_decleration(item(args, i));
+
+    if (node->op)
+        read_scope(&func->scope, list(node, 3));
+    return func;
+}
+
+Ast* Ast_Cache_Reader::read_statement(const Neoast_Node* node) {
+    if (!node || bad)
+        return nullptr;
+
+    switch (node->type) {
+    case AST_STATEMENT: {
+        auto stmt = CACHE_NEW(Ast_Statement, node);
+        stmt->flags = node->flags;
+        stmt->expr = read_expression(child(node, 2));
+        return stmt;
+    }
+    case AST_CONDITION: {
+        Ast_ControlFlow* first = nullptr;
+        Ast_ControlFlow** previous = &first;
+        for (const Neoast_Node* at = node; at && !bad; at = child(at, 4, AST_CONDITION)) {
+            auto condition = CACHE_NEW(Ast_ControlFlow, at);
+            condition->flag = at->op;
+            condition->condition = read_expression(child(at, 0));
+            read_scope(&condition->scope, list(at, 3));
+
+            *previous = condition;
+            previous = &condition->next;
+        }
+        return first;
+    }
+    case AST_FOR: {
+        auto loop = CACHE_NEW(Ast_For, node);
+        loop->simd = (node->flags & NEOAST_SIMD);
+        loop->parallel = (node->flags & NEOAST_PARALLEL);
+        loop->grain = node->value;
+        loop->iterator = read_decleration(child(node, 0, AST_DECLERATION));
+        loop->begin = read_expression(child(node, 1));
+        loop->end = read_expression(child(node, 2));
+        read_scope(&loop->scope, list(node, 3));
+
+        const Neoast_List* reductions = list(node, 4);
+        for (uint32_t i = 0; reductions && i < reductions->count; i++) {
+            const Neoast_Node* ident = item(reductions, i, AST_IDENTIFIER);
+            if (ident)
+                loop->reductions.push({ ident->op, read_ident(ident) });
+        }
+        return loop;
+    }
+    case AST_STRUCT: {
+        auto record = CACHE_NEW(Ast_Struct, node);
+        record->id = read_ident(child(node, 1, AST_IDENTIFIER));
+
+        const Neoast_List* fields = list(node, 2, NEOAST_MAX_ARGS);
+        for (uint32_t i = 0; fields && i < fields->count; i++)
+            record->fields[record->field_count++] = read_decleration(item(fields, i));
+        return record;
+    }
+    case AST_FUNCTION_DEFINITION:
+        return read_function_definition(node);
+    case AST_FUNCTION_CALL:
+        return read_function_call(node);
+    default:
+        return read_decleration(node);
+    }
+}
+
+void Ast_Cache_Reader::read_scope(Ast_Scope* scope, const Neoast_List* list) {
+    if (!list)
+        return;
+
+    scope->parent = current_scope;
+    current_scope = scope;
+
+    for (uint32_t i = 0; i < list->count && !bad; i++)
+        scope->add(read_statement(item(list, i)));
+
+    current_scope = scope->parent;
+}
+
+Ast_Translation_Unit* Ast_Cache_Reader::read_translation_unit(const Neoast_Node* node) {
+    if (!node)
+        return nullptr;
+
+    auto root = CACHE_NEW(Ast_Translation_Unit, node);
+    read_scope(&root->scope, list(node, 3));
+    return root;
+}
+
+void open_ast_cache(Ast_Cache* cache, Source_File* source) {
+    size_t length = strlen(source->name);
+    if (length > 4 && strcmp(source->name + length - 4, ".neo") == 0)
+        length -= 4;
+
+    cache->path = (char*) malloc(length + sizeof(".neoast"));
+    memcpy(cache->path, source->name, length);
+    strcpy(cache->path + length, ".neoast");
+
+    cache->source = source;
+    cache->source_hash = hash_bytes(source->text, source->size);
+    cache->source_size = source->size;
+}
+
+static bool valid_header(Ast_Cache* cache, const Neoast_Header* header) {
+    return memcmp(header->magic, NEOAST_MAGIC, sizeof(header->magic)) == 0 &&
+        header->version == NEOAST_VERSION &&
+        header->node_size == sizeof(Neoast_Node) &&
+        header->compiler == compiler_stamp() &&
+        header->source_hash == cache->source_hash &&
+        header->source_size == cache->source_size &&
+        header->depth <= (uint32_t) options.max_depth &&
+        header->size == cache->size &&
+        header->strings_size > 0 &&
+        (uint64_t) header->strings + header->strings_size == cache->size &&
+        cache->data[cache->size - 1] == '\0';
+}
+
+static void unmap_ast_cache(Ast_Cache* cache) {
+    if (cache->data)
+        munmap(cache->data, cache->size);
+    cache->data = nullptr;
+    cache->size = 0;
+}
+
+bool load_ast_cache(Ast_Cache* cache, Parser* parser) {
+    int fd = open(cache->path, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(Neoast_Header)) {
+        close(fd);
+        return false;
+    }
+
+    // Private and writable, so a pass that edits a name in place only touches its own copy of the page.
+    void* data = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return false;
+
+    cache->data = (uint8_t*) data;
+    cache->size = st.st_size;
+
+    const Neoast_Header* header = (const Neoast_Header*) cache->data;
+    if (!valid_header(cache, header)) {
+        unmap_ast_cache(cache);
+        return false;
+    }
+
+    Ast_Cache_Reader reader;
+    reader.data = cache->data;
+    reader.strings = header->strings;
+    reader.strings_size = header->strings_size;
+    reader.source = cache->source;
+
+    Ast_Translation_Unit* root = reader.read_translation_unit(reader.node_at(header->root, AST_SCOPE));
+
+    const Neoast_List* headers = reader.list_at(header->headers);
+    for (uint32_t i = 0; headers && i < headers->count; i++) {
+        const Neoast_Node* name = reader.item(headers, i, AST_IDENTIFIER);
+        if (name)
+            parser->extra_headers.insert(reader.string(name->value), Tok::T_IDENTIFIER);
+    }
+
+    // A bad file leaks whatever was already built; it only happens when the cache was damaged.
+    if (reader.bad) {
+        unmap_ast_cache(cache);
+        return false;
+    }
+
+    parser->root = root;
+    parser->current_scope = &root->scope;
+    parser->node_count = reader.node_count;
+    return true;
+}
+
+void write_ast_cache(Ast_Cache* cache, Parser* parser) {
+    Ast_Cache_Writer writer;
+    writer.base = cache->source->base;
+    writer.allocate(sizeof(Neoast_Header));
+
+    uint32_t root = writer.new_node(parser->root, AST_SCOPE);
+    writer.link(root, 3, writer.write_scope(&parser->root->scope));
+
+    uint32_t headers = writer.new_list(parser->extra_headers.table.top());
+    for (size_t i = 0; i < parser->extra_headers.table.top(); i++) {
+        uint32_t name = writer.allocate(sizeof(Neoast_Node));
+        Neoast_Node* node = writer.node_at(name);
+        node->type = AST_IDENTIFIER;
+        node->value = writer.intern(parser->extra_headers.table.get(i).name);
+        writer.set_item(headers, i, name);
+    }
+
+    if (writer.strings_size == 0)
+        writer.intern("");
+    uint32_t strings = writer.allocate(writer.strings_size);
+    memcpy(writer.data + strings, writer.strings, writer.strings_size);
+    writer.size = strings + writer.strings_size;
+
+    Neoast_Header* header = (Neoast_Header*) writer.data;
+    memcpy(header->magic, NEOAST_MAGIC, sizeof(header->magic));
+    header->version = NEOAST_VERSION;
+    header->node_size = sizeof(Neoast_Node);
+    header->compiler = compiler_stamp();
+    header->source_hash = cache->source_hash;
+    header->source_size = cache->source_size;
+    header->node_count = writer.node_count;
+    header->root = root;
+    header->headers = headers;
+    header->strings = strings;
+    header->strings_size = writer.strings_size;
+    header->size = writer.size;
+    header->depth = (uint32_t) parser->deepest;
+
+    // Written aside and renamed over the old file, so a concurrent build never maps half a cache.
+    char temp[4096];
+    snprintf(temp, sizeof(temp), "%s.%d", cache->path, (int) getpid());
+
+    FILE* file = fopen(temp, "wb");
+    bool written = file && fwrite(writer.data, 1, writer.size, file) == writer.size;
+    if (file)
+        written = (fclose(file) == 0) && written;
+    if (!written || rename(temp, cache->path) != 0) {
+        unlink(temp);
+        report_warning(0, "could not write the AST cache '%s'", cache->path);
+    }
+
+    free(writer.data);
+    free(writer.strings);
+    free(writer.slots);
+}
+
+void close_ast_cache(Ast_Cache* cache) {
+    unmap_ast_cache(cache);
+    free(cache->path);
+    cache->path = nullptr;
+}
@@ -0,0 +1,205 @@
+#include "../include/ast_dump.h"
+#include "../include/sema.h"
+
+#include <stdarg.h>
+
+static const char* operator_names[] = { "+", "-", "*", "/", "%", "==", "!=", "<=", ">=", "<", ">" };
+static const char* unary_names[] = { "++", "--", "()", "*", "&", "" };
+static const char* control_names[] = { "none", "if", "else", "elif", "while", "block" };
+
+void Ast_Dumper::node(Ast* at, Ast_Type* type, const char* fmt, ...) {
+    fprintf(file, "%*s", depth * 2, "");
+
+    va_list args;
+    va_start(args, fmt);
+    vfprintf(file, fmt, args);
+    va_end(args);
+
+    if (type)
+        fprintf(file, " : %s", type_name(type));
+    fprintf(file, " @%u\n", source_manager.line_of(at->loc));
+}
+
+void Ast_Dumper::dump_expression(Ast_Expression* expr) {
+    for (; expr; expr = expr->next) {
+        switch (expr->type) {
+        case AST_BINARY_EXPRESSION: {
+            // A chain is printed down its spine, then each right operand under its own link on the way back up.
+            size_t base = chain.top();
+            push_chain(static_cast<Ast_Binary_Expression*>(expr), &chain);
+            for (size_t i = base; i < chain.top(); i++) {
+                Ast_Binary_Expression* link = chain.get(i);
+                node(link, link->type_info, "binary %s", operator_names[link->op]);
+                depth++;
+            }
+
+            dump_expression(chain.get(chain.top() - 1)->left);
+            while (chain.top() > base) {
+                dump_expression(chain.get(chain.top() - 1)->right);
+                chain.pop();
+                depth--;
+            }
+            break;
+        }
+        case AST_UNARY_EXPESSION: {
+            auto unary = static_cast<Ast_Unary_Expression*>(expr);
+            node(unary, unary->type_info, "unary %s", unary_names[unary->op]);
+            depth++;
+            dump_expression(unary->nested_expr);
+            dump_expression(unary->expr);
+            depth--;
+            break;
+        }
+        case AST_PRIMARY_EXPRESSION: {
+            auto prime = static_cast<Ast_Primary_Expression*>(expr);
+            switch (prime->v_type) {
+            case AST_INT_P:   node(prime, prime->type_info, "int %lld", (long long) prime->int_const); break;
+            case AST_FLOAT_P: node(prime, prime->type_info, "float %g", prime->float_const); break;
+            case AST_STR_P:   node(prime, prime->type_info, "string \"%s\"", prime->string_literal); break;
+            case AST_CHAR_P:  node(prime, prime->type_info, "char %d", prime->char_const); break;
+            case AST_ID_P:    node(prime, prime->type_info, "identifier %s", prime->ident->name); break;
+            case AST_CALL_P:
+                node(prime, prime->type_info, "call");
+                depth++;
+                dump_function_call(prime->call);
+                depth--;
+                break;
+            }
+            if (prime->expr) {
+                depth++;
+                dump_expression(prime->expr);
+                depth--;
+            }
+            break;
+        }
+        case AST_INDEX_EXPRESSION: {
+            auto index = static_cast<Ast_Index_Expression*>(expr);
+            node(index, index->type_info, "index%s", (index->checked) ? " checked" : "");
+            depth++;
+            dump_expression(index->base);
+            dump_expression(index->index);
+            depth--;
+            break;
+        }
+        case AST_FIELD_EXPRESSION: {
+            auto field = static_cast<Ast_Field_Expression*>(expr);
+            node(field, field->type_info, "field %s", field->field->name);
+            depth++;
+            dump_expression(field->base);
+            depth--;
+            break;
+        }
+        case AST_NEW_EXPRESSION: {
+            auto alloc = static_cast<Ast_New_Expression*>(expr);
+            node(alloc, alloc->type_info, "new");
+            depth++;
+            dump_expression(alloc->count);
+            dump_expression(alloc->arena);
+            depth--;
+            break;
+        }
+        case AST_VECTOR_EXPRESSION: {
+            auto vector = static_cast<Ast_Vector_Expression*>(expr);
+            node(vector, vector->type_info, "vector %zu args", vector->arg_count);
+            depth++;
+            for (int i = 0; i < vector->arg_count; i++)
+                dump_expression(vector->args[i]);
+            depth--;
+            break;
+        }
+        default:
+            node(expr, expr->type_info, "expression %d", expr->type);
+            break;
+        }
+    }
+}
+
+void Ast_Dumper::dump_function_call(Ast_Function_Call* call) {
+    node(call, nullptr, "function call %s", call->id->name);
+    depth++;
+    for (int i = 0; i < call->arg_count; i++)
+        dump_expression(call->args[i]);
+    depth--;
+}
+
+void Ast_Dumper::dump_decleration(Ast_Decleration* dec) {
+    node(dec, dec->type_info, "%s %s", (dec->type == AST_ASSIGNMENT) ? "assignment" : "decleration", (dec->id) ? dec->id->name : "");
+    depth++;
+    dump_expression(dec->expr);
+    depth--;
+}
+
+void Ast_Dumper::dump_function_definition(Ast_Function_Definition* func) {
+    node(func, func->type_info, "function %s%s", func->id->name, (func->from) ? " foreign" : "");
+    depth++;
+    for (int i = 0; i < func->arg_count; i++)
+        node(func->args[i], func->args[i]->type_info, "argument %s", func->args[i]->id->name);
+    dump_scope(&func->scope);
+    depth--;
+}
+
+void Ast_Dumper::dump_statement(Ast* ast) {
+    switch (ast->type) {
+    case AST_STATEMENT: {
+        auto stmt = static_cast<Ast_Statement*>(ast);
+        const char* kind = (stmt->flags & AST_RETURN) ? "return" : (stmt->flags & AST_BREAK) ? "break" : (stmt->flags & AST_CONTINUE) ? "continue" : "statement";
+        node(stmt, nullptr, "%s", kind);
+        depth++;
+        dump_expression(stmt->expr);
+        depth--;
+        break;
+    }
+    case AST_CONDITION:
+        for (auto condition = static_cast<Ast_ControlFlow*>(ast); condition; condition = condition->next) {
+            node(condition, nullptr, "%s", control_names[condition->flag]);
+            depth++;
+            dump_expression(condition->condition);
+            dump_scope(&condition->scope);
+            depth--;
+        }
+        break;
+    case AST_FOR: {
+        auto loop = static_cast<Ast_For*>(ast);
+        node(loop, nullptr, "%sfor %s", (loop->parallel) ? "parallel " : (loop->simd) ? "simd " : "", loop->iterator->id->name);
+        depth++;
+        dump_expression(loop->begin);
+        dump_expression(loop->end);
+        dump_scope(&loop->scope);
+        depth--;
+        break;
+    }
+    case AST_DECLERATION:
+    case AST_ASSIGNMENT:
+        dump_decleration(static_cast<Ast_Decleration*>(ast));
+        break;
+    case AST_FUNCTION_DEFINITION:
+        dump_function_definition(static_cast<Ast_Function_Definition*>(ast));
+        break;
+    case AST_FUNCTION_CALL:
+        dump_function_call(static_cast<Ast_Function_Call*>(ast));
+        break;
+    case AST_STRUCT: {
+        auto record = static_cast<Ast_Struct*>(ast);
+        node(record, nullptr, "struct %s", record->id->name);
+        depth++;
+        for (int i = 0; i < record->field_count; i++)
+            node(record->fields[i], record->fields[i]->type_info, "field %s", record->fields[i]->id->name);
+        depth--;
+        break;
+    }
+    default:
+        node(ast, nullptr, "node %d", ast->type);
+        break;
+    }
+}
+
+void Ast_Dumper::dump_scope(Ast_Scope* scope) {
+    for (int i = 0; i < scope->size; i++)
+        dump_statement(scope->statements[i]);
+}
+
+void dump_translation_unit(FILE* file, Ast_Translation_Unit* root) {
+    Ast_Dumper dumper;
+    dumper.file = file;
+    dumper.dump_scope(&root->scope);
+}
@@ -0,0 +1,220 @@
+#include "../include/bounds.h"
+#include "../include/err.h"
+
+static Ast_Decleration* variable_of(Ast_Expression* expr) {
+    if (!expr || expr->type != AST_PRIMARY_EXPRESSION)
+        return nullptr;
+
+    auto prime = static_cast<Ast_Primary_Expression*>(expr);
+    if (prime->v_type != AST_ID_P || prime->expr)
+        return nullptr;
+    return prime->ident->decleration;
+}
+
+static bool int_literal(Ast_Expression* expr, int64_t* value) {
+    if (!expr || expr->type != AST_PRIMARY_EXPRESSION || expr->next)
+        return false;
+
+    auto prime = static_cast<Ast_Primary_Expression*>(expr);
+    if (prime->v_type != AST_INT_P || prime->expr)
+        return false;
+    *value = prime->int_const;
+    return true;
+}
+
+bool Bounds_Elider::is_global(Ast_Decleration* dec) {
+    for (int i = 0; i < globals.top(); i++) {
+        if (globals.get(i) == dec)
+            return true;
+    }
+    return false;
+}
+
+bool Bounds_Elider::assigns(Ast_Scope* scope, Ast_Decleration* dec) {
+    for (int i = 0; i < scope->size; i++) {
+        Ast* ast = scope->statements[i];
+
+        switch (ast->type) {
+        case AST_DECLERATION:
+        case AST_ASSIGNMENT: {
+            // Every link of a chain but the last one is written to.
+            Ast_Expression* link = static_cast<Ast_Decleration*>(ast)->expr;
+            for (; link && link->next; link = link->next) {
+                if (variable_of(link) == dec)
+                    return true;
+            }
+            break;
+        }
+        case AST_CONDITION: {
+            for (auto condition = static_cast<Ast_ControlFlow*>(ast); condition; condition = condition->next) {
+                if (assigns(&condition->scope, dec))
+                    return true;
+            }
+            break;
+        }
+        case AST_FOR:
+            if (assigns(&static_cast<Ast_For*>(ast)->scope, dec))
+                return true;
+            break;
+        }
+    }
+    return false;
+}
+
+bool Bounds_Elider::in_range(Ast_Index_Expression* index) {
+    Ast_Type* base = index->base->type_info;
+    int64_t value;
+
+    if (int_literal(index->index, &value)) {
+        if (base->atom_type != AST_TYPE_ARRAY && base->atom_type != AST_TYPE_VECTOR)
+            return false;
+        if (value < 0 || value >= base->length) {
+            report_warning(index->loc, "index %lld is out of bounds for %s of length %lld", (long long) value, (base->atom_type == AST_TYPE_ARRAY) ? "an array" : "a vector", (long long) base->length);
+            return false;
+        }
+        return true;
+    }
+
+    Ast_Decleration* iterator = variable_of(index->index);
+    if (!iterator)
+        return false;
+
+    for (int i = (int) loops.top() - 1; i >= 0; i--) {
+        Ast_For* loop = loops.get(i);
+        if (loop->iterator != iterator)
+            continue;
+
+        int64_t begin, end;
+        if (!int_literal(loop->begin, &begin) || begin < 0)
+            return false;
+
+        // The bound is evaluated once, so 'i in 0..a.len' stays valid as long as 'a' itself is not replaced.
+        if (int_literal(loop->end, &end))
+            return ((base->atom_type == AST_TYPE_ARRAY || base->atom_type == AST_TYPE_VECTOR) && end <= base->length);
+
+        if (loop->end->type != AST_FIELD_EXPRESSION || loop->end->next)
+            return false;
+
+        // A global could also be replaced by any function called from the loop.
+        Ast_Decleration* extent = variable_of(static_cast<Ast_Field_Expression*>(loop->end)->base);
+        if (!extent || extent != variable_of(index->base) || is_global(extent))
+            return false;
+        return !assigns(&loop->scope, extent);
+    }
+
+    return false;
+}
+
+void Bounds_Elider::visit_expression(Ast_Expression* expr) {
+    while (expr) {
+        switch (expr->type) {
+        case AST_BINARY_EXPRESSION: {
+            auto bin = static_cast<Ast_Binary_Expression*>(expr);
+            for (; left_link(bin); bin = left_link(bin))
+                visit_expression(bin->right);
+            visit_expression(bin->left);
+            visit_expression(bin->right);
+            break;
+        }
+        case AST_UNARY_EXPESSION: {
+            auto unary = static_cast<Ast_Unary_Expression*>(expr);
+            visit_expression(unary->nested_expr);
+            visit_expression(unary->expr);
+            break;
+        }
+        case AST_PRIMARY_EXPRESSION: {
+            auto prime = static_cast<Ast_Primary_Expression*>(expr);
+            if (prime->v_type == AST_CALL_P)
+                visit_function_call(prime->call);
+            break;
+        }
+        case AST_INDEX_EXPRESSION: {
+            auto index = static_cast<Ast_Index_Expression*>(expr);
+            visit_expression(index->base);
+            visit_expression(index->index);
+
+            if (index->checked && in_range(index)) {
+                index->checked = false;
+                elided++;
+            }
+            break;
+        }
+        case AST_FIELD_EXPRESSION:
+            visit_expression(static_cast<Ast_Field_Expression*>(expr)->base);
+            break;
+        case AST_NEW_EXPRESSION: {
+            auto alloc = static_cast<Ast_New_Expression*>(expr);
+            visit_expression(alloc->count);
+            visit_expression(alloc->arena);
+            break;
+        }
+        case AST_VECTOR_EXPRESSION: {
+            auto vector = static_cast<Ast_Vector_Expression*>(expr);
+            for (int i = 0; i < vector->arg_count; i++)
+                visit_expression(vector->args[i]);
+            break;
+        }
+        }
+
+        expr = expr->next;
+    }
+}
+
+void Bounds_Elider::visit_function_call(Ast_Function_Call* call) {
+    for (int i = 0; i < call->arg_count; i++)
+        visit_expression(call->args[i]);
+}
+
+void Bounds_Elider::visit_statement(Ast* ast) {
+    switch (ast->type) {
+    case AST_STATEMENT:
+        visit_expression(static_cast<Ast_Statement*>(ast)->expr);
+        break;
+    case AST_CONDITION: {
+        auto condition = static_cast<Ast_ControlFlow*>(ast);
+        while (condition) {
+            visit_expression(condition->condition);
+            visit_scope(&condition->scope);
+            condition = condition->next;
+        }
+        break;
+    }
+    case AST_FOR: {
+        auto loop = static_cast<Ast_For*>(ast);
+        visit_expression(loop->begin);
+        visit_expression(loop->end);
+
+        loops.push(loop);
+        visit_scope(&loop->scope);
+        loops.pop();
+        break;
+    }
+    case AST_DECLERATION:
+    case AST_ASSIGNMENT:
+        visit_expression(static_cast<Ast_Decleration*>(ast)->expr);
+        break;
+    case AST_FUNCTION_DEFINITION:
+        visit_scope(&static_cast<Ast_Function_Definition*>(ast)->scope);
+        break;
+    case AST_FUNCTION_CALL:
+        visit_function_call(static_cast<Ast_Function_Call*>(ast));
+        break;
+    }
+}
+
+void Bounds_Elider::visit_scope(Ast_Scope* scope) {
+    for (int i = 0; i < scope->size; i++)
+        visit_statement(scope->statements[i]);
+}
+
+void elide_bounds_checks(Ast_Translation_Unit* root) {
+    Bounds_Elider elider;
+
+    for (int i = 0; i < root->scope.size; i++) {
+        Ast* ast = root->scope.statements[i];
+        if (ast->type == AST_DECLERATION)
+            elider.globals.push(static_cast<Ast_Decleration*>(ast));
+    }
+
+    elider.visit_scope(&root->scope);
+}
@@ -1,5 +1,16 @@
 #include "../include/c_converter.h"
 #include "../include/err.h"
+#include "../include/ir.h"
+#include "../include/options.h"
+#include "../include/sema.h"
+#include "../include/const_eval.h"
+#include "../include/timer.h"
+#include "../include/trace.h"
+#include "../include/cache.h"
+#include "../include/hash.h"
+
+#include <limits.h>
+#include <unistd.h>
 
 #define FILE_NAME_LEN 256
 #define C_OUT_FILE_MODE "w"
@@ -7,6 +18,8 @@
 
 const char* C_include_preamble_buffer = 
 "#include <stdio.h>\n"
+"#include <stdlib.h>\n"
+"#include <string.h>\n"
 "#include <stdint.h>\n\n";
 
 const char* C_typedef_preamble_buffer = 
@@ -17,23 +30,275 @@ const char* C_typedef_preamble_buffer =
 "typedef uint64_t u64;\n"
 "typedef int64_t i64;\n\n";
 
+const char* C_runtime_preamble_buffer = 
+"typedef struct { i32* data; i64 len; } neo_slice_int;\n"
+"typedef struct { char* data; i64 len; } neo_slice_byte;\n"
+"typedef struct { i64* data; i64 len; } neo_slice_long;\n"
+"typedef struct { f32* data; i64 len; } neo_slice_float;\n"
+"typedef struct { f64* data; i64 len; } neo_slice_double;\n\n"
+"static inline i64 neo_bounds(i64 i, i64 n, int line) {\n"
+"\tif ((u64)i >= (u64)n) {\n"
+"\t\tfprintf(stderr, \"index %%lld is out of bounds for length %%lld on line %%d.\\n\", (long long)i, (long long)n, line);\n"
+"\t\tfflush(stdout);\n"
+"\t\tabort();\n"
+"\t}\n"
+"\treturn i;\n"
+"}\n\n"
+"static inline i64 neo_lanes(i64 i, i64 lanes, i64 n, int line) {\n"
+"\tif (i < 0 || i > n - lanes) {\n"
+"\t\tfprintf(stderr, \"%%lld lanes at index %%lld are out of bounds for length %%lld on line %%d.\\n\", (long long)lanes, (long long)i, (long long)n, line);\n"
+"\t\tfflush(stdout);\n"
+"\t\tabort();\n"
+"\t}\n"
+"\treturn i;\n"
+"}\n\n";
+
+// Work-stealing pool for parallel loops. Each worker owns a slice of the range, takes grain sized chunks
+// from its front and, once it runs dry, steals the upper half of another worker's remaining slice.
+// Bodies may call memoized functions from every worker at once, which is why memo entries carry a sequence number.
+const char* C_parallel_runtime_buffer = 
+"#include <pthread.h>\n"
+"#include <unistd.h>\n\n"
+"#define NEO_PAR_MAX_WORKERS 64\n\n"
+"typedef void (*neo_par_body)(void*, i64, i64);\n\n"
+"typedef struct {\n"
+"\tpthread_mutex_t lock;\n"
+"\ti64 begin, end;\n"
+"} __attribute__((aligned(64))) neo_par_range;\n\n"
+"static struct {\n"
+"\tint workers, active;\n"
+"\tu64 generation;\n"
+"\tpthread_mutex_t lock;\n"
+"\tpthread_cond_t wake, done;\n"
+"\tneo_par_body body;\n"
+"\tvoid* ctx;\n"
+"\ti64 grain;\n"
+"\tneo_par_range ranges[NEO_PAR_MAX_WORKERS];\n"
+"} neo_par = { 0, 0, 0, PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER };\n\n"
+"static pthread_mutex_t neo_par_reduce = PTHREAD_MUTEX_INITIALIZER;\n"
+"static __thread int neo_par_inside;\n\n"
+"static int neo_par_take(int self, i64* begin, i64* end) {\n"
+"\tneo_par_range* r = &neo_par.ranges[self];\n"
+"\tint found = 0;\n"
+"\tpthread_mutex_lock(&r->lock);\n"
+"\tif (r->begin < r->end) {\n"
+"\t\t*begin = r->begin;\n"
+"\t\t*end = (r->end - r->begin > neo_par.grain) ? r->begin + neo_par.grain : r->end;\n"
+"\t\tr->begin = *end;\n"
+"\t\tfound = 1;\n"
+"\t}\n"
+"\tpthread_mutex_unlock(&r->lock);\n"
+"\treturn found;\n"
+"}\n\n"
+"static int neo_par_steal(int self) {\n"
+"\tfor (int k = 1; k < neo_par.workers; k++) {\n"
+"\t\tint victim = (self + k < neo_par.workers) ? self + k : self + k - neo_par.workers;\n"
+"\t\tneo_par_range* v = &neo_par.ranges[victim];\n"
+"\t\ti64 begin = 0, end = 0;\n"
+"\t\tpthread_mutex_lock(&v->lock);\n"
+"\t\tif (v->begin < v->end) {\n"
+"\t\t\tbegin = v->begin + (v->end - v->begin) / 2;\n"
+"\t\t\tend = v->end;\n"
+"\t\t\tv->end = begin;\n"
+"\t\t}\n"
+"\t\tpthread_mutex_unlock(&v->lock);\n"
+"\t\tif (begin < end) {\n"
+"\t\t\tneo_par_range* r = &neo_par.ranges[self];\n"
+"\t\t\tpthread_mutex_lock(&r->lock);\n"
+"\t\t\tr->begin = begin;\n"
+"\t\t\tr->end = end;\n"
+"\t\t\tpthread_mutex_unlock(&r->lock);\n"
+"\t\t\treturn 1;\n"
+"\t\t}\n"
+"\t}\n"
+"\treturn 0;\n"
+"}\n\n"
+"static void neo_par_work(int self) {\n"
+"\ti64 begin, end;\n"
+"\tdo {\n"
+"\t\twhile (neo_par_take(self, &begin, &end))\n"
+"\t\t\tneo_par.body(neo_par.ctx, begin, end);\n"
+"\t} while (neo_par_steal(self));\n"
+"}\n\n"
+"static void* neo_par_thread(void* arg) {\n"
+"\tint self = (int)(intptr_t)arg;\n"
+"\tu64 seen = 0;\n"
+"\tneo_par_inside = 1;\n"
+"\tfor (;;) {\n"
+"\t\tpthread_mutex_lock(&neo_par.lock);\n"
+"\t\twhile (neo_par.generation == seen)\n"
+"\t\t\tpthread_cond_wait(&neo_par.wake, &neo_par.lock);\n"
+"\t\tseen = neo_par.generation;\n"
+"\t\tpthread_mutex_unlock(&neo_par.lock);\n\n"
+"\t\tneo_par_work(self);\n\n"
+"\t\tpthread_mutex_lock(&neo_par.lock);\n"
+"\t\tif (--neo_par.active == 0)\n"
+"\t\t\tpthread_cond_signal(&neo_par.done);\n"
+"\t\tpthread_mutex_unlock(&neo_par.lock);\n"
+"\t}\n"
+"\treturn 0;\n"
+"}\n\n"
+"static void neo_par_init(void) {\n"
+"\tconst char* env = getenv(\"NEO_THREADS\");\n"
+"\tlong workers = (env) ? atol(env) : sysconf(_SC_NPROCESSORS_ONLN);\n"
+"\tif (workers < 1) workers = 1;\n"
+"\tif (workers > NEO_PAR_MAX_WORKERS) workers = NEO_PAR_MAX_WORKERS;\n"
+"\tfor (int w = 0; w < workers; w++)\n"
+"\t\tpthread_mutex_init(&neo_par.ranges[w].lock, 0);\n"
+"\tneo_par.workers = 1;\n"
+"\tfor (int w = 1; w < workers; w++) {\n"
+"\t\tpthread_t thread;\n"
+"\t\tif (pthread_create(&thread, 0, neo_par_thread, (void*)(intptr_t)w) != 0)\n"
+"\t\t\tbreak;\n"
+"\t\tpthread_detach(thread);\n"
+"\t\tneo_par.workers++;\n"
+"\t}\n"
+"}\n\n"
+"static void neo_parallel_for(i64 begin, i64 end, i64 grain, neo_par_body body, void* ctx) {\n"
+"\tif (begin >= end) return;\n"
+"\tif (!neo_par.workers) neo_par_init();\n\n"
+"\tint workers = neo_par.workers;\n"
+"\ti64 n = end - begin;\n"
+"\tif (grain <= 0) grain = (n / (workers * 8) > 0) ? n / (workers * 8) : 1;\n"
+"\tif (workers == 1 || neo_par_inside || n <= grain) {\n"
+"\t\tbody(ctx, begin, end);\n"
+"\t\treturn;\n"
+"\t}\n\n"
+"\ti64 share = n / workers, extra = n - share * workers, at = begin;\n"
+"\tfor (int w = 0; w < workers; w++) {\n"
+"\t\tneo_par.ranges[w].begin = at;\n"
+"\t\tat += share + (w < extra);\n"
+"\t\tneo_par.ranges[w].end = at;\n"
+"\t}\n\n"
+"\tpthread_mutex_lock(&neo_par.lock);\n"
+"\tneo_par.body = body;\n"
+"\tneo_par.ctx = ctx;\n"
+"\tneo_par.grain = grain;\n"
+"\tneo_par.active = workers - 1;\n"
+"\tneo_par.generation++;\n"
+"\tpthread_cond_broadcast(&neo_par.wake);\n"
+"\tpthread_mutex_unlock(&neo_par.lock);\n\n"
+"\tneo_par_inside = 1;\n"
+"\tneo_par_work(0);\n"
+"\tneo_par_inside = 0;\n\n"
+"\tpthread_mutex_lock(&neo_par.lock);\n"
+"\twhile (neo_par.active > 0)\n"
+"\t\tpthread_cond_wait(&neo_par.done, &neo_par.lock);\n"
+"\tpthread_mutex_unlock(&neo_par.lock);\n"
+"}\n\n";
+
+// Arenas bump allocate out of a chain of blocks. A mark is the arena's position counted over all of its
+// blocks, resetting to it parks the newer blocks for reuse and released blocks go to a per-thread cache,
+// so steady state allocation never reaches malloc.
+const char* C_arena_runtime_buffer = 
+"#define NEO_ARENA_BLOCK_SIZE (64 * 1024)\n"
+"#define NEO_ARENA_MAX_BLOCK_SIZE (64 * 1024 * 1024)\n"
+"#define NEO_ARENA_CACHE_LIMIT 16\n\n"
+"typedef struct neo_arena_block {\n"
+"\tstruct neo_arena_block* prev;\n"
+"\ti64 base, size;\n"
+"\tchar data[] __attribute__((aligned(16)));\n"
+"} neo_arena_block;\n\n"
+"typedef struct {\n"
+"\tneo_arena_block* block;\n"
+"\tneo_arena_block* spare;\n"
+"\ti64 used;\n"
+"} neo_arena;\n\n"
+"static __thread neo_arena_block* neo_arena_cache;\n"
+"static __thread int neo_arena_cached;\n\n"
+"static neo_arena_block* neo_arena_take(neo_arena_block** list, i64 bytes) {\n"
+"\tfor (neo_arena_block** at = list; *at; at = &(*at)->prev) {\n"
+"\t\tif ((*at)->size >= bytes) {\n"
+"\t\t\tneo_arena_block* block = *at;\n"
+"\t\t\t*at = block->prev;\n"
+"\t\t\treturn block;\n"
+"\t\t}\n"
+"\t}\n"
+"\treturn 0;\n"
+"}\n\n"
+"static void* neo_arena_grow(neo_arena* a, i64 bytes) {\n"
+"\ti64 position = (a->block) ? a->block->base + a->used : 0;\n"
+"\tneo_arena_block* block = neo_arena_take(&a->spare, bytes);\n"
+"\tif (!block && (block = neo_arena_take(&neo_arena_cache, bytes)))\n"
+"\t\tneo_arena_cached--;\n"
+"\tif (!block) {\n"
+"\t\ti64 size = (a->block) ? a->block->size * 2 : NEO_ARENA_BLOCK_SIZE;\n"
+"\t\tif (size > NEO_ARENA_MAX_BLOCK_SIZE) size = NEO_ARENA_MAX_BLOCK_SIZE;\n"
+"\t\tif (size < bytes) size = bytes;\n"
+"\t\tblock = (neo_arena_block*) malloc(sizeof(neo_arena_block) + size);\n"
+"\t\tif (!block) {\n"
+"\t\t\tfprintf(stderr, \"out of memory allocating %%lld bytes from an arena.\\n\", (long long)bytes);\n"
+"\t\t\tabort();\n"
+"\t\t}\n"
+"\t\tblock->size = size;\n"
+"\t}\n"
+"\tblock->prev = a->block;\n"
+"\tblock->base = position;\n"
+"\ta->block = block;\n"
+"\ta->used = bytes;\n"
+"\treturn memset(block->data, 0, bytes);\n"
+"}\n\n"
+"static inline void* neo_arena_alloc(neo_arena* a, i64 count, i64 size, i64 align) {\n"
+"\tif (count < 0 || count > INT64_MAX / size) {\n"
+"\t\tfprintf(stderr, \"invalid arena allocation of %%lld elements.\\n\", (long long)count);\n"
+"\t\tabort();\n"
+"\t}\n"
+"\ti64 bytes = count * size;\n"
+"\tif (a->block) {\n"
+"\t\ti64 at = (a->used + align - 1) & ~(align - 1);\n"
+"\t\tif (at + bytes <= a->block->size) {\n"
+"\t\t\ta->used = at + bytes;\n"
+"\t\t\treturn memset(a->block->data + at, 0, bytes);\n"
+"\t\t}\n"
+"\t}\n"
+"\treturn neo_arena_grow(a, bytes);\n"
+"}\n\n"
+"static inline i64 neo_arena_mark(neo_arena* a) {\n"
+"\treturn (a->block) ? a->block->base + a->used : 0;\n"
+"}\n\n"
+"static void neo_arena_reset(neo_arena* a, i64 mark) {\n"
+"\twhile (a->block && a->block->base > mark) {\n"
+"\t\tneo_arena_block* block = a->block;\n"
+"\t\ta->block = block->prev;\n"
+"\t\ta->used = (a->block) ? block->base - a->block->base : 0;\n"
+"\t\tblock->prev = a->spare;\n"
+"\t\ta->spare = block;\n"
+"\t}\n"
+"\tif (a->block && mark - a->block->base < a->used)\n"
+"\t\ta->used = (mark > a->block->base) ? mark - a->block->base : 0;\n"
+"}\n\n"
+"static void neo_arena_free_blocks(neo_arena_block* block) {\n"
+"\twhile (block) {\n"
+"\t\tneo_arena_block* prev = block->prev;\n"
+"\t\tif (neo_arena_cached < NEO_ARENA_CACHE_LIMIT && block->size <= NEO_ARENA_BLOCK_SIZE * 16) {\n"
+"\t\t\tblock->prev = neo_arena_cache;\n"
+"\t\t\tneo_arena_cache = block;\n"
+"\t\t\tneo_arena_cached++;\n"
+"\t\t}\n"
+"\t\telse\n"
+"\t\t\tfree(block);\n"
+"\t\tblock = prev;\n"
+"\t}\n"
+"}\n\n"
+"static void neo_arena_release(neo_arena* a) {\n"
+"\tneo_arena_free_blocks(a->block);\n"
+"\tneo_arena_free_blocks(a->spare);\n"
+"\ta->block = a->spare = 0;\n"
+"\ta->used = 0;\n"
+"}\n\n";
+
 const char* C_postamble_buffer = 
 "\n"
 "int main(int argc, char *argv[]) {\n";
 
-Ast_Function_Call* run_directives[64];
-size_t run_directives_size = 0;
-
-FILE* open_c_file(const char* file_name, char* buf, SymTable* extra_headers) {    
-    memset(buf, 0, FILE_NAME_LEN);
-    strcpy(buf, file_name);
+bool link_parallel_runtime = false;
 
-    strcat(buf, C_OUT_FILE_TYPE);
-    FILE* file = fopen(buf, C_OUT_FILE_MODE);
-
-    if (!file) 
-        fatal_error("could not open %s for converting.\n", buf);
+// Empty when the preamble is written into the C file itself.
+char precompiled_header[PATH_MAX];
 
+// Guarded, so the C file can carry the preamble and still skip it when gcc was handed the precompiled copy first.
+void write_preamble(FILE* file, SymTable* extra_headers) {
+    fprintf(file, "#ifndef NEO_PREAMBLE\n#define NEO_PREAMBLE\n");
     fprintf(file, C_include_preamble_buffer);
 
     for (int i = 0; i < extra_headers->table.top(); i++) {
@@ -43,6 +308,60 @@ FILE* open_c_file(const char* file_name, char* buf, SymTable* extra_headers) {
     fprintf(file, "\n");
 
     fprintf(file, C_typedef_preamble_buffer);
+    fprintf(file, C_runtime_preamble_buffer);
+    fprintf(file, "#endif\n\n");
+}
+
+// The preamble only varies with the foreign headers, so it is shared as '<cache>/pch/<hash>.h' by every
+// program with the same header set and compiler. compile_and_link builds the .gch files and passes the
+// header to gcc with -include; the C file never names it.
+bool write_precompiled_header(SymTable* extra_headers) {
+    char* text = nullptr;
+    size_t size = 0;
+    FILE* memory = open_memstream(&text, &size);
+    write_preamble(memory, extra_headers);
+    fclose(memory);
+
+    char dir[PATH_MAX];
+    snprintf(dir, sizeof(dir), "%s/pch", cache_directory());
+    snprintf(precompiled_header, sizeof(precompiled_header), "%s/%016llx.h", dir,
+        (unsigned long long) hash_bytes(text, size, compiler_version()));
+
+    bool ready = (access(precompiled_header, R_OK) == 0);
+    if (!ready && make_directories(dir)) {
+        char temp[PATH_MAX + 16];
+        snprintf(temp, sizeof(temp), "%s.%d", precompiled_header, (int) getpid());
+
+        FILE* file = fopen(temp, "w");
+        ready = file && fwrite(text, 1, size, file) == size;
+        if (file)
+            ready = (fclose(file) == 0) && ready;
+        ready = ready && rename(temp, precompiled_header) == 0;
+        if (!ready)
+            unlink(temp);
+    }
+
+    free(text);
+    if (!ready)
+        precompiled_header[0] = '\0';
+    return ready;
+}
+
+FILE* open_c_file(const char* file_name, char* buf, SymTable* extra_headers) {    
+    memset(buf, 0, FILE_NAME_LEN);
+    strcpy(buf, file_name);
+
+    strcat(buf, C_OUT_FILE_TYPE);
+    FILE* file = fopen(buf, C_OUT_FILE_MODE);
+
+    if (!file) 
+        fatal_error("could not open %s for converting.\n", buf);
+
+    // The standard headers alone load about as fast as a .gch does, so only foreign headers are worth it.
+    precompiled_header[0] = '\0';
+    if (options.pch && !options.emit_c && extra_headers->table.top() > 0)
+        write_precompiled_header(extra_headers);
+    write_preamble(file, extra_headers);
 
     return file;
 }
@@ -56,10 +375,22 @@ void C_Converter::convert_postfix_expression(Ast_Expression* expr) {
         auto p = static_cast<Ast_Primary_Expression*>(expr);
         switch (p->v_type) {
         case AST_INT_P:
-            fprintf(file, "%d", p->int_const);
+            // Folding leaves negative literals behind operators, so 'x - -5' has to keep its parentheses.
+            if (p->int_const == INT64_MIN)
+                fprintf(file, "(-9223372036854775807LL-1)");
+            else if (p->int_const < 0)
+                fprintf(file, "(%lld)", (long long) p->int_const);
+            else
+                fprintf(file, "%lld", (long long) p->int_const);
+            break;
+        case AST_FLOAT_P:
+            emit_floating_literal(file, p->float_const, false);
             break;
         case AST_ID_P:
-            fprintf(file, "%s", p->ident->name);
+            if (is_captured_array(p->ident->decleration))
+                fprintf(file, "(*__ctx->%s)", p->ident->name);
+            else
+                fprintf(file, "%s", p->ident->name);
             break;
         case AST_CALL_P:
             convert_function_call(p->call);
@@ -82,12 +413,168 @@ void C_Converter::convert_postfix_expression(Ast_Expression* expr) {
             }
         }
     }
+    else if (expr->type == AST_INDEX_EXPRESSION) {
+        auto index = static_cast<Ast_Index_Expression*>(expr);
+        Ast_Type* base = index->base->type_info;
+
+        convert_expression(index->base);
+        if (base->atom_type == AST_TYPE_SLICE)
+            fprintf(file, ".data");
+        convert_subscript(index);
+    }
+    else if (expr->type == AST_NEW_EXPRESSION) {
+        auto alloc = static_cast<Ast_New_Expression*>(expr);
+
+        // The count is needed twice, for the allocation and for the slice length.
+        fprintf(file, "({i64 __n=");
+        convert_expression(alloc->count);
+        fprintf(file, ";(neo_slice_%s){(", type_name(alloc->element));
+        convert_type(alloc->element);
+        fprintf(file, "*)neo_arena_alloc(");
+        convert_expression(alloc->arena);
+        fprintf(file, ",__n,sizeof(");
+        convert_type(alloc->element);
+        fprintf(file, "),_Alignof(");
+        convert_type(alloc->element);
+        fprintf(file, ")),__n};})");
+    }
+    else if (expr->type == AST_VECTOR_EXPRESSION) {
+        auto vector = static_cast<Ast_Vector_Expression*>(expr);
+        Ast_Type* type = vector->vector;
+        const char* lane = type_name(type->element);
+
+        switch (vector->form) {
+        case AST_VECTOR_BROADCAST:
+            fprintf(file, "({");
+            convert_type(type->element);
+            fprintf(file, "__s=");
+            convert_expression(vector->args[0]);
+            fprintf(file, ";(neo_vec%lld_%s){", (long long) type->length, lane);
+            for (int i = 0; i < type->length; i++)
+                fprintf(file, (i) ? ",__s" : "__s");
+            fprintf(file, "};})");
+            break;
+        case AST_VECTOR_LANES:
+            fprintf(file, "((neo_vec%lld_%s){", (long long) type->length, lane);
+            for (int i = 0; i < vector->arg_count; i++) {
+                if (i)
+                    fprintf(file, ",");
+                convert_expression(vector->args[i]);
+            }
+            fprintf(file, "})");
+            break;
+        case AST_VECTOR_LOAD: {
+            // Arrays only guarantee the alignment of their elements, so lanes go through the unaligned variant.
+            Ast_Expression* from = vector->args[0];
+            fprintf(file, "(*(neo_vec%lld_%s_u*)&", (long long) type->length, lane);
+            convert_expression(from);
+            if (from->type_info->atom_type == AST_TYPE_SLICE)
+                fprintf(file, ".data");
+            fprintf(file, "[");
+            if (vector->checked && options.bounds_checks) {
+                fprintf(file, "neo_lanes(");
+                convert_expression(vector->args[1]);
+                fprintf(file, ",%lld,", (long long) type->length);
+                if (from->type_info->atom_type == AST_TYPE_SLICE) {
+                    convert_expression(from);
+                    fprintf(file, ".len");
+                }
+                else
+                    fprintf(file, "%lld", (long long) from->type_info->length);
+                fprintf(file, ",%u)", source_manager.line_of(vector->loc));
+            }
+            else
+                convert_expression(vector->args[1]);
+            fprintf(file, "])");
+            break;
+        }
+        }
+    }
+    else if (expr->type == AST_FIELD_EXPRESSION) {
+        auto field = static_cast<Ast_Field_Expression*>(expr);
+        Ast_Type* base = field->base->type_info;
+
+        if (field->member) {
+            // 'a[i].f' on a #soa array reads element i of the array holding every 'f'.
+            auto index = static_cast<Ast_Index_Expression*>(field->base);
+            if (field->base->type == AST_INDEX_EXPRESSION && index->base->type_info->soa) {
+                convert_expression(index->base);
+                fprintf(file, ".%s", field->field->name);
+                convert_subscript(index);
+            }
+            else {
+                convert_expression(field->base);
+                fprintf(file, ".%s", field->field->name);
+            }
+        }
+        else if ((base->atom_type == AST_TYPE_ARRAY || base->atom_type == AST_TYPE_VECTOR) && strcmp(field->field->name, "len") == 0)
+            fprintf(file, "((i64)%lld)", (long long) base->length);
+        else if (base->atom_type == AST_TYPE_VECTOR) {
+            // Spelled out lane by lane, gcc turns the loop into a shuffle tree.
+            const char* name = field->field->name;
+            fprintf(file, "({neo_vec%lld_%s __v=", (long long) base->length, type_name(base->element));
+            convert_expression(field->base);
+            fprintf(file, ";");
+            convert_type(field->type_info);
+            fprintf(file, "__r=__v[0];for(int __l=1;__l<%lld;__l++)", (long long) base->length);
+            if (strcmp(name, "sum") == 0)
+                fprintf(file, "__r+=__v[__l];");
+            else
+                fprintf(file, "if(__v[__l]%s__r)__r=__v[__l];", (strcmp(name, "min") == 0) ? "<" : ">");
+            fprintf(file, "__r;})");
+        }
+        else if (base->atom_type == AST_TYPE_ARENA) {
+            fprintf(file, "neo_arena_mark(");
+            convert_expression(field->base);
+            fprintf(file, ")");
+        }
+        else {
+            convert_expression(field->base);
+            fprintf(file, ".len");
+        }
+    }
 }
 
+void C_Converter::convert_subscript(Ast_Index_Expression* index) {
+    Ast_Type* base = index->base->type_info;
+
+    fprintf(file, "[");
+    if (index->checked && options.bounds_checks) {
+        fprintf(file, "neo_bounds(");
+        convert_expression(index->index);
+        if (base->atom_type == AST_TYPE_SLICE) {
+            fprintf(file, ",");
+            convert_expression(index->base);
+            fprintf(file, ".len");
+        }
+        else
+            fprintf(file, ",%lld", (long long) base->length);
+        fprintf(file, ",%u)", source_manager.line_of(index->loc));
+    }
+    else
+        convert_expression(index->index);
+    fprintf(file, "]");
+
+    if (index->postfix == AST_UNARY_INC)
+        fprintf(file, "++");
+    else if (index->postfix == AST_UNARY_DEC)
+        fprintf(file, "--");
+}
+
+static const char* operator_text[] = { "+", "-", "*", "/", "%", "==", "!=", "<=", ">=", "<", ">" };
+
+void C_Converter::push_task(int kind, Ast_Expression* expr, Ast_Expression* other, const char* text) {
+    tasks.push({ kind, expr, other, text });
+}
+
+// Prefix operators and parentheses only queue their operand, the postfix forms are written right away.
 void C_Converter::convert_unary_expression(Ast_Expression* expr) {
     auto unary = static_cast<Ast_Unary_Expression*>(expr);
 
     if (expr->type == AST_UNARY_EXPESSION) {
+        if (unary->expr)
+            push_task(TASK_UNARY, unary->expr);
+
         switch (unary->op) {
         case AST_UNARY_INC:
             fprintf(file, " ++");
@@ -103,68 +590,66 @@ void C_Converter::convert_unary_expression(Ast_Expression* expr) {
             break;
         case AST_UNARY_NESTED:
             fprintf(file, "(");
-            convert_expression(unary->nested_expr);
-            fprintf(file, ")");
+            push_task(TASK_TEXT, nullptr, nullptr, ")");
+            push_task(TASK_EXPRESSION, unary->nested_expr);
             break;
         }
-
-        if (unary->expr) {
-            convert_unary_expression(unary->expr);
-        }   
     }
-    else if (expr->type == AST_PRIMARY_EXPRESSION) {
+    else if (expr->type == AST_PRIMARY_EXPRESSION || expr->type == AST_INDEX_EXPRESSION || expr->type == AST_FIELD_EXPRESSION || expr->type == AST_NEW_EXPRESSION || expr->type == AST_VECTOR_EXPRESSION) {
         convert_postfix_expression(expr);
-
     }
 }
 
 void C_Converter::convert_binary_expression(Ast_Expression* expr) {
     if (expr->type == AST_BINARY_EXPRESSION) {
         auto bin = static_cast<Ast_Binary_Expression*>(expr);
-        convert_expression(bin->left);
-
-        switch (bin->op) {
-        case AST_OPERATOR_MULTIPLICATIVE:
-            fprintf(file, "*");
-            break;
-        case AST_OPERATOR_PLUS:
-            fprintf(file, "+");
-            break;
-        case AST_OPERATOR_DIVISION:
-            fprintf(file, "/");
-            break;
-         case AST_OPERATOR_MINUS:
-            fprintf(file, "-");
-            break;
-        case AST_OPERATOR_COMPARITIVE_EQUAL:
-            fprintf(file, "==");
-            break;
-        case AST_OPERATOR_COMPARITIVE_NOT_EQUAL:
-            fprintf(file, "!=");
-            break;
-        case AST_OPERATOR_LTE:
-            fprintf(file, "<=");
-            break;
-        case AST_OPERATOR_GTE:
-            fprintf(file, ">=");
-            break;
-        case AST_OPERATOR_LT:
-            fprintf(file, "<");
-            break;
-        case AST_OPERATOR_GT:
-            fprintf(file, ">");
-            break;
-        }
-
-        convert_expression(bin->right);
+        push_task(TASK_OPERAND, bin->right, bin->left);
+        push_task(TASK_TEXT, nullptr, nullptr, operator_text[bin->op]);
+        push_task(TASK_OPERAND, bin->left, bin->right);
     }
     else {
         convert_unary_expression(expr);
     }
 }
 
+void C_Converter::convert_operand(Ast_Expression* expr, Ast_Expression* other) {
+    Ast_Type* vector = other->type_info;
+
+    // A scalar next to a vector is broadcast by gcc, the cast keeps the lanes from being widened.
+    if (vector && vector->atom_type == AST_TYPE_VECTOR && expr->type_info && expr->type_info->atom_type != AST_TYPE_VECTOR) {
+        fprintf(file, "(");
+        convert_type(unqualified_type(vector->element));
+        fprintf(file, ")(");
+        push_task(TASK_TEXT, nullptr, nullptr, ")");
+    }
+    push_task(TASK_EXPRESSION, expr);
+}
+
+// Operator chains and parentheses run off the task stack, so their depth costs no native stack.
+// Subscripts, calls and the other postfix forms still recurse for their sub-expressions.
 void C_Converter::convert_expression(Ast_Expression* expr) {
-    convert_binary_expression(expr);
+    size_t base = tasks.top();
+    push_task(TASK_EXPRESSION, expr);
+
+    while (tasks.top() > base) {
+        Convert_Task task = tasks.get(tasks.top() - 1);
+        tasks.pop();
+
+        switch (task.kind) {
+        case TASK_EXPRESSION:
+            convert_binary_expression(task.expr);
+            break;
+        case TASK_UNARY:
+            convert_unary_expression(task.expr);
+            break;
+        case TASK_OPERAND:
+            convert_operand(task.expr, task.other);
+            break;
+        case TASK_TEXT:
+            fputs(task.text, file);
+            break;
+        }
+    }
 }
 
 void C_Converter::convert_identifier(Ast_Ident* id) {
@@ -175,6 +660,13 @@ void C_Converter::convert_type(Ast_Type* type) {
     if (type->constant)
         fprintf(file, "const ");
 
+    // Arrays are spelled as their element type here, the extents follow the name in convert_declarator.
+    while (type->atom_type == AST_TYPE_ARRAY && !type->soa) {
+        type = type->element;
+        if (type->constant)
+            fprintf(file, "const ");
+    }
+
     switch (type->atom_type) {
     case AST_TYPE_INT:
         fprintf(file, "i32 ");
@@ -182,7 +674,54 @@ void C_Converter::convert_type(Ast_Type* type) {
     case AST_TYPE_BYTE:
         fprintf(file, "char ");
         break;
+    case AST_TYPE_LONG:
+        fprintf(file, "i64 ");
+        break;
+    case AST_TYPE_FLOAT:
+        fprintf(file, "f32 ");
+        break;
+    case AST_TYPE_DOUBLE:
+        fprintf(file, "f64 ");
+        break;
+    case AST_TYPE_VOID:
+        fprintf(file, "void ");
+        break;
+    case AST_TYPE_SLICE:
+        fprintf(file, "neo_slice_%s ", type_name(type->element));
+        break;
+    case AST_TYPE_ARENA:
+        fprintf(file, "neo_arena* ");
+        break;
+    case AST_TYPE_VECTOR:
+        fprintf(file, "neo_vec%lld_%s ", (long long) type->length, type_name(type->element));
+        break;
+    case AST_TYPE_STRUCT:
+        fprintf(file, "struct %s ", type_name(type));
+        break;
+    case AST_TYPE_ARRAY:
+        fprintf(file, "neo_soa_%s_%lld ", type_name(type->element), (long long) type->length);
+        break;
+    }
+}
+
+void C_Converter::convert_declarator(Ast_Type* type, Ast_Ident* id) {
+    convert_type(type);
+    convert_identifier(id);
+
+    for (; type->atom_type == AST_TYPE_ARRAY && !type->soa; type = type->element)
+        fprintf(file, "[%lld]", (long long) type->length);
+}
+
+void C_Converter::convert_value(Ast_Expression* expr, Ast_Type* to) {
+    Ast_Type* from = expr->type_info;
+
+    if (to && from && to->atom_type == AST_TYPE_SLICE && from->atom_type == AST_TYPE_ARRAY) {
+        fprintf(file, "(neo_slice_%s){", type_name(to->element));
+        convert_expression(expr);
+        fprintf(file, ",%lld}", (long long) from->length);
     }
+    else
+        convert_expression(expr);
 }
 
 void C_Converter::convert_statement(Ast* ast) {
@@ -194,10 +733,16 @@ void C_Converter::convert_statement(Ast* ast) {
         case AST_RETURN: {
             fprintf(file, "return ");
             if (stmt->expr)
-                convert_expression(stmt->expr);
+                convert_value(stmt->expr, (current) ? current->type_info : nullptr);
             fprintf(file, ";\n");
             break;
         }
+        case AST_BREAK:
+            fprintf(file, "break;\n");
+            break;
+        case AST_CONTINUE:
+            fprintf(file, "continue;\n");
+            break;
         }
 
         break;
@@ -227,15 +772,25 @@ void C_Converter::convert_statement(Ast* ast) {
                     fprintf(file, "else{\n");
 
                 for(int i = 0; i < current->scope.size; i++) {
-                    convert_statement(condition->scope.statements[i]);
-            }
+                    convert_statement(current->scope.statements[i]);
+                }
 
-            fprintf(file, "}\n");
+                fprintf(file, "}\n");
 
-            current = current->next;
+                current = current->next;
             }
             break;
         }
+        case AST_CONTROL_BLOCK: {
+            fprintf(file, "{\n");
+
+            for(int i = 0; i < condition->scope.size; i++) {
+                convert_statement(condition->scope.statements[i]);
+            }
+
+            fprintf(file, "}\n");
+            break;
+        }
         case AST_CONTROL_WHILE: {
             fprintf(file, "while(");
             convert_expression(condition->condition);
@@ -251,70 +806,472 @@ void C_Converter::convert_statement(Ast* ast) {
         }
         break;
     }
+    case AST_FOR: {
+        auto loop = static_cast<Ast_For*>(ast);
+        if (loop->parallel) {
+            convert_parallel_for(loop);
+            break;
+        }
+
+        Ast_Type* type = canonical_type(loop->iterator->type_info->atom_type);
+        const char* name = loop->iterator->id->name;
+
+        // The bound is evaluated once up front so gcc sees a plain counted loop.
+        fprintf(file, "{\nconst ");
+        convert_type(type);
+        fprintf(file, "__end_%s=", name);
+        convert_expression(loop->end);
+        end();
+
+        if (loop->simd)
+            fprintf(file, "#pragma GCC ivdep\n");
+
+        fprintf(file, "for(");
+        convert_type(type);
+        fprintf(file, "%s=", name);
+        convert_expression(loop->begin);
+        fprintf(file, ";%s<__end_%s;%s++){\n", name, name, name);
+
+        for(int i = 0; i < loop->scope.size; i++) {
+            convert_statement(loop->scope.statements[i]);
+        }
+
+        fprintf(file, "}\n}\n");
+        break;
+    }
     default: {
         convert_decleration(static_cast<Ast_Decleration*>(ast));
     }
     }
 }
 
-void C_Converter::convert_function_definition(Ast_Function_Definition* func) {
-    if (func->from == nullptr) {
-        if (!func->type_info)
-            fprintf(file, "void ");
-        else {
-            convert_type(func->type_info);
-        }
-        
-        convert_identifier(func->id);
+void C_Converter::convert_function_signature(Ast_Function_Definition* func, const char* suffix, bool internal) {
+    if (internal)
+        fprintf(file, "static ");
 
-        fprintf(file, "(");
-        for(int i = 0; i < func->arg_count; i++) {
-            convert_type(func->args[i]->type_info);
-            convert_identifier(func->args[i]->id);
+    if (!func->type_info)
+        fprintf(file, "void ");
+    else {
+        convert_type(func->type_info);
+    }
 
-            if (i < func->arg_count - 1)
-                fprintf(file, ",");
+    fprintf(file, "%s%s", func->id->name, suffix);
+
+    fprintf(file, "(");
+    for(int i = 0; i < func->arg_count; i++) {
+        convert_declarator(func->args[i]->type_info, func->args[i]->id);
+
+        if (i < func->arg_count - 1)
+            fprintf(file, ",");
+    }
+    fprintf(file, ")");
+}
+
+void C_Converter::convert_function_body(Ast_Function_Definition* func) {
+    fprintf(file, " {\n");
+    current = func;
+
+    Ir_Function* ir = (options.use_ir) ? lower_function(func) : nullptr;
+    if (ir) {
+        if (options.dump_ir) {
+            printf("ir: lowered\n");
+            dump_function(stdout, ir);
         }
-        fprintf(file, ") ");
-        fprintf(file, "{\n");
 
+        optimize_function(ir);
+        emit_function_body(file, ir);
+        free_function(ir);
+    }
+    else {
         for(int i = 0; i < func->scope.size; i++) {
             convert_statement(func->scope.statements[i]);
         }
+    }
+
+    fprintf(file, "}\n");
+    current = nullptr;
+}
+
+uint64_t memo_hash(uint64_t h, uint64_t k) {
+    h ^= k + 0x9E3779B97F4A7C15ULL + (h << 6) + (h >> 2);
+    return h;
+}
+
+void C_Converter::convert_memoized_function(Ast_Function_Definition* func) {
+    const char* name = func->id->name;
+    uint64_t size = 1;
+    while (size < (uint64_t) ((func->memo_size > 0) ? func->memo_size : options.memo_size))
+        size <<= 1;
+
+    if (!memo_helpers) {
+        fprintf(file, "static inline u64 neo_memo_hash(u64 h, u64 k) { h ^= k + 0x9E3779B97F4A7C15ULL + (h << 6) + (h >> 2); return h; }\n");
+        fprintf(file, "static inline u64 neo_memo_f64(f64 x) { union { f64 f; u64 u; } b; b.f = x; return b.u; }\n");
+        memo_helpers = true;
+    }
+
+    convert_function_signature(func, "__impl", true);
+    end();
+
+    // Parallel loops can call into the table from every worker, so each entry is guarded by a sequence number.
+    // It is odd while a writer owns the entry and 0 while the entry is empty.
+    fprintf(file, "static struct { u32 seq; ");
+    for (int i = 0; i < func->arg_count; i++) {
+        convert_type(canonical_type(func->args[i]->type_info->atom_type));
+        fprintf(file, "k%d; ", i);
+    }
+    convert_type(canonical_type(func->type_info->atom_type));
+    fprintf(file, "value; } %s__memo[%llu]", name, (unsigned long long) size);
+
+    // Results for the first few arguments can be computed now and baked into the table.
+    bool single_integral = (func->arg_count == 1 && is_integral_type(func->args[0]->type_info) && is_integral_type(func->type_info));
+    if (func->memo_prefill > 0 && single_integral) {
+        Const_Evaluator evaluator;
+        evaluator.budget = 10000000;
+        evaluator.cached_function = func;
+        for (int i = 0; i < func->memo_prefill; i++) {
+            evaluator.cache.push(0);
+            evaluator.cached.push(false);
+        }
+
+        Array<bool> filled;
+        for (uint64_t i = 0; i < size; i++)
+            filled.push(false);
+
+        fprintf(file, " = {\n");
+        for (int64_t arg = 0; arg < func->memo_prefill; arg++) {
+            int64_t result;
+            if (!evaluate_function(&evaluator, func, &arg, &result)) {
+                report_warning(func->loc, "could not evaluate '%s(%lld)' at compile time, prefilling stopped", name, (long long) arg);
+                break;
+            }
+
+            uint64_t slot = memo_hash(0, (uint64_t) arg) & (size - 1);
+            if (filled.get(slot))
+                continue;
+            filled.get_arr()[slot] = true;
+            fprintf(file, "[%llu] = { 2, %lld, %lld },\n", (unsigned long long) slot, (long long) arg, (long long) result);
+        }
+        fprintf(file, "}");
+    }
+    else if (func->memo_prefill > 0)
+        report_warning(func->loc, "prefill needs a single integral argument and result, ignoring it for '%s'", name);
+    end();
+
+    convert_function_signature(func, "", func->flags & AST_FUNCTION_INTERNAL);
+    fprintf(file, " {\n");
+    fprintf(file, "u64 __h = 0;\n");
+    for (int i = 0; i < func->arg_count; i++) {
+        const char* arg = func->args[i]->id->name;
+        if (is_floating_type(func->args[i]->type_info))
+            fprintf(file, "__h = neo_memo_hash(__h, neo_memo_f64((f64)%s));\n", arg);
+        else
+            fprintf(file, "__h = neo_memo_hash(__h, (u64)(i64)%s);\n", arg);
+    }
+    fprintf(file, "__h &= %lluULL;\n", (unsigned long long) (size - 1));
+
+    // A hit only counts when the sequence number was even and unchanged across reading the entry.
+    fprintf(file, "u32 __s = __atomic_load_n(&%s__memo[__h].seq, __ATOMIC_ACQUIRE);\n", name);
+    fprintf(file, "if (__s && !(__s & 1)) {\n");
+    for (int i = 0; i < func->arg_count; i++) {
+        convert_type(canonical_type(func->args[i]->type_info->atom_type));
+        fprintf(file, "__k%d; __atomic_load(&%s__memo[__h].k%d, &__k%d, __ATOMIC_RELAXED);\n", i, name, i, i);
+    }
+    convert_type(canonical_type(func->type_info->atom_type));
+    fprintf(file, "__v; __atomic_load(&%s__memo[__h].value, &__v, __ATOMIC_RELAXED);\n", name);
+    fprintf(file, "__atomic_thread_fence(__ATOMIC_ACQUIRE);\n");
+    fprintf(file, "if (__atomic_load_n(&%s__memo[__h].seq, __ATOMIC_RELAXED) == __s", name);
+    for (int i = 0; i < func->arg_count; i++)
+        fprintf(file, " && __k%d == %s", i, func->args[i]->id->name);
+    fprintf(file, ") return __v;\n}\n");
+
+    convert_type(canonical_type(func->type_info->atom_type));
+    fprintf(file, "__r = %s__impl(", name);
+    for (int i = 0; i < func->arg_count; i++)
+        fprintf(file, "%s%s", func->args[i]->id->name, (i < func->arg_count - 1) ? "," : "");
+    fprintf(file, ");\n");
+
+    // A writer that loses the race for the entry just returns its result without storing it.
+    fprintf(file, "u32 __w = __atomic_load_n(&%s__memo[__h].seq, __ATOMIC_RELAXED);\n", name);
+    fprintf(file, "if (!(__w & 1) && __atomic_compare_exchange_n(&%s__memo[__h].seq, &__w, __w + 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {\n", name);
+    fprintf(file, "__atomic_thread_fence(__ATOMIC_RELEASE);\n");
+    for (int i = 0; i < func->arg_count; i++)
+        fprintf(file, "__atomic_store(&%s__memo[__h].k%d, &%s, __ATOMIC_RELAXED);\n", name, i, func->args[i]->id->name);
+    fprintf(file, "__atomic_store(&%s__memo[__h].value, &__r, __ATOMIC_RELAXED);\n", name);
+    fprintf(file, "__atomic_store_n(&%s__memo[__h].seq, __w + 2, __ATOMIC_RELEASE);\n}\n", name);
+    fprintf(file, "return __r;\n}\n");
+
+    convert_function_signature(func, "__impl", true);
+    convert_function_body(func);
+}
+
+bool C_Converter::is_captured_array(Ast_Decleration* dec) {
+    if (!parallel || !dec || !dec->type_info || dec->type_info->atom_type != AST_TYPE_ARRAY)
+        return false;
+
+    for (int i = 0; i < parallel->captures.top(); i++) {
+        if (parallel->captures.get(i) == dec)
+            return true;
+    }
+    return false;
+}
+
+const char* reduction_identity(int op, Ast_Type* type) {
+    if (op == AST_REDUCE_ADD)
+        return "0";
+
+    bool min = (op == AST_REDUCE_MIN);
+    switch (type->atom_type) {
+    case AST_TYPE_BYTE:   return (min) ? "INT8_MAX" : "INT8_MIN";
+    case AST_TYPE_INT:    return (min) ? "INT32_MAX" : "INT32_MIN";
+    case AST_TYPE_LONG:   return (min) ? "INT64_MAX" : "INT64_MIN";
+    case AST_TYPE_FLOAT:  return (min) ? "__builtin_inff()" : "-__builtin_inff()";
+    default:              return (min) ? "__builtin_inf()" : "-__builtin_inf()";
+    }
+}
+
+void C_Converter::convert_parallel_body(Ast_For* loop) {
+    if (!parallel_runtime) {
+        fprintf(file, C_parallel_runtime_buffer);
+        parallel_runtime = true;
+        link_parallel_runtime = true;
+    }
+
+    int id = (int) parallel_loops.top();
+    parallel_loops.push(loop);
+
+    // Arrays are shared through a pointer, everything else the body only reads is copied.
+    fprintf(file, "struct __parallel_%d_ctx {", id);
+    for (int i = 0; i < loop->captures.top(); i++) {
+        Ast_Decleration* dec = loop->captures.get(i);
+        Ast_Type* type = unqualified_type(dec->type_info);
+
+        convert_type(type);
+        if (type->atom_type == AST_TYPE_ARRAY) {
+            fprintf(file, "(*%s)", dec->id->name);
+            for (; type->atom_type == AST_TYPE_ARRAY && !type->soa; type = type->element)
+                fprintf(file, "[%lld]", (long long) type->length);
+        }
+        else
+            convert_identifier(dec->id);
+        fprintf(file, "; ");
+    }
+    for (int i = 0; i < loop->reductions.top(); i++) {
+        Ast_Ident* ident = loop->reductions.get(i).ident;
+        convert_type(unqualified_type(ident->decleration->type_info));
+        fprintf(file, "*%s; ", ident->name);
+    }
+    if (loop->captures.top() == 0 && loop->reductions.top() == 0)
+        fprintf(file, "char __none; ");
+    fprintf(file, "};\n");
+
+    fprintf(file, "static void __parallel_%d(void* __arg, i64 __begin, i64 __end) {\n", id);
+    fprintf(file, "struct __parallel_%d_ctx* __ctx = (struct __parallel_%d_ctx*) __arg;\n", id, id);
+    for (int i = 0; i < loop->captures.top(); i++) {
+        Ast_Decleration* dec = loop->captures.get(i);
+        if (dec->type_info->atom_type == AST_TYPE_ARRAY)
+            continue;
+
+        fprintf(file, "const ");
+        convert_declarator(unqualified_type(dec->type_info), dec->id);
+        fprintf(file, "=__ctx->%s", dec->id->name);
+        end();
+    }
+    for (int i = 0; i < loop->reductions.top(); i++) {
+        const Ast_Reduction& reduction = loop->reductions.get(i);
+        Ast_Type* type = unqualified_type(reduction.ident->decleration->type_info);
+        convert_type(type);
+        fprintf(file, "%s=%s", reduction.ident->name, reduction_identity(reduction.op, type));
+        end();
+    }
+
+    Ast_Type* type = canonical_type(loop->iterator->type_info->atom_type);
+    const char* name = loop->iterator->id->name;
+    if (loop->simd)
+        fprintf(file, "#pragma GCC ivdep\n");
+    fprintf(file, "for(");
+    convert_type(type);
+    fprintf(file, "%s=__begin;%s<__end;%s++){\n", name, name, name);
+
+    parallel = loop;
+    for (int i = 0; i < loop->scope.size; i++)
+        convert_statement(loop->scope.statements[i]);
+    parallel = nullptr;
+    fprintf(file, "}\n");
+
+    // Every chunk folds its partial result into the shared variable once.
+    if (loop->reductions.top() > 0) {
+        fprintf(file, "pthread_mutex_lock(&neo_par_reduce);\n");
+        for (int i = 0; i < loop->reductions.top(); i++) {
+            const Ast_Reduction& reduction = loop->reductions.get(i);
+            const char* var = reduction.ident->name;
+            switch (reduction.op) {
+            case AST_REDUCE_ADD:
+                fprintf(file, "*__ctx->%s+=%s;\n", var, var);
+                break;
+            case AST_REDUCE_MIN:
+                fprintf(file, "if(%s<*__ctx->%s)*__ctx->%s=%s;\n", var, var, var, var);
+                break;
+            case AST_REDUCE_MAX:
+                fprintf(file, "if(%s>*__ctx->%s)*__ctx->%s=%s;\n", var, var, var, var);
+                break;
+            }
+        }
+        fprintf(file, "pthread_mutex_unlock(&neo_par_reduce);\n");
+    }
+    fprintf(file, "}\n");
+}
+
+void C_Converter::convert_parallel_bodies(Ast_Scope* scope) {
+    for (int i = 0; i < scope->size; i++) {
+        Ast* ast = scope->statements[i];
+
+        if (ast->type == AST_CONDITION) {
+            for (auto condition = static_cast<Ast_ControlFlow*>(ast); condition; condition = condition->next)
+                convert_parallel_bodies(&condition->scope);
+        }
+        else if (ast->type == AST_FOR) {
+            auto loop = static_cast<Ast_For*>(ast);
+            if (loop->parallel)
+                convert_parallel_body(loop);
+            else
+                convert_parallel_bodies(&loop->scope);
+        }
+    }
+}
+
+void C_Converter::convert_parallel_for(Ast_For* loop) {
+    int id = 0;
+    while (id < parallel_loops.top() && parallel_loops.get(id) != loop)
+        id++;
 
-        fprintf(file, "}\n");
+    fprintf(file, "{\nstruct __parallel_%d_ctx __ctx_%d={", id, id);
+    for (int i = 0; i < loop->captures.top(); i++) {
+        Ast_Decleration* dec = loop->captures.get(i);
+        fprintf(file, "%s%s,", (dec->type_info->atom_type == AST_TYPE_ARRAY) ? "&" : "", dec->id->name);
+    }
+    for (int i = 0; i < loop->reductions.top(); i++)
+        fprintf(file, "&%s,", loop->reductions.get(i).ident->name);
+    if (loop->captures.top() == 0 && loop->reductions.top() == 0)
+        fprintf(file, "0");
+    fprintf(file, "};\n");
+
+    fprintf(file, "neo_parallel_for(");
+    convert_expression(loop->begin);
+    fprintf(file, ",");
+    convert_expression(loop->end);
+    fprintf(file, ",%lld,__parallel_%d,&__ctx_%d);\n}\n", (long long) loop->grain, id, id);
+}
+
+void C_Converter::convert_function_definition(Ast_Function_Definition* func) {
+    if (func->from == nullptr) {
+        Scoped_Trace trace("emit", func->id->name);
+        convert_parallel_bodies(&func->scope);
+
+        if (func->flags & AST_FUNCTION_MEMOIZED) {
+            convert_memoized_function(func);
+            return;
+        }
+
+        convert_function_signature(func, "", func->flags & AST_FUNCTION_INTERNAL);
+        convert_function_body(func);
     }
 }
 
 void C_Converter::convert_function_call(Ast_Function_Call* call) {
+    auto callee = static_cast<Ast_Function_Definition*>(call->id->decleration);
+
     fprintf(file, "%s(", call->id->name);
         for (int j = 0; j < call->arg_count; j++) {       
-            convert_expression(call->args[j]);
+            convert_value(call->args[j], (callee && j < callee->arg_count) ? callee->args[j]->type_info : nullptr);
             if (j < call->arg_count - 1)
                 fprintf(file, ",");
         }
     fprintf(file, ")");
 }
 
+void C_Converter::convert_struct_definition(Ast_Struct* record) {
+    const char* name = record->id->name;
+
+    fprintf(file, "struct %s {\n", name);
+    for (int i = 0; i < record->field_count; i++) {
+        convert_declarator(record->fields[i]->type_info, record->fields[i]->id);
+        end();
+    }
+    fprintf(file, "};\n");
+    fprintf(file, "typedef struct { struct %s* data; i64 len; } neo_slice_%s;\n", name, name);
+
+    // Each #soa array of this struct stores every field in its own array, one entry per element.
+    Array<Ast_Type*>* types = interned_types();
+    for (int i = 0; i < types->top(); i++) {
+        Ast_Type* type = types->get(i);
+        if (!type->soa || type->atom_type != AST_TYPE_ARRAY || type->element->record != record)
+            continue;
+        if (type->constant) {
+            unqualified_type(type);
+            continue;
+        }
+
+        fprintf(file, "typedef struct {\n");
+        for (int j = 0; j < record->field_count; j++) {
+            Ast_Type* field = record->fields[j]->type_info;
+            convert_type(field);
+            fprintf(file, "%s[%lld]", record->fields[j]->id->name, (long long) type->length);
+            for (; field->atom_type == AST_TYPE_ARRAY && !field->soa; field = field->element)
+                fprintf(file, "[%lld]", (long long) field->length);
+            end();
+        }
+        fprintf(file, "} neo_soa_%s_%lld;\n", name, (long long) type->length);
+    }
+    fprintf(file, "\n");
+}
+
 void C_Converter::convert_decleration(Ast_Decleration* decleration) {
+    if (decleration->type == AST_STRUCT) {
+        convert_struct_definition(static_cast<Ast_Struct*>(decleration));
+        return;
+    }
     if (decleration->type == AST_DECLERATION) {
-        convert_type(decleration->type_info);
-        convert_identifier(decleration->id);
+        // An arena lives in hidden storage and is released when its scope exits, the name is a pointer to it.
+        if (decleration->type_info->atom_type == AST_TYPE_ARENA && !decleration->expr) {
+            const char* name = decleration->id->name;
+            fprintf(file, "neo_arena __arena_%s", name);
+            if (current || parallel)
+                fprintf(file, " __attribute__((cleanup(neo_arena_release)))");
+            fprintf(file, "={0};\nneo_arena* const %s=&__arena_%s;\n", name, name);
+            return;
+        }
+
+        convert_declarator(decleration->type_info, decleration->id);
 
+        Ast_Type* target = decleration->type_info;
         Ast_Expression** expr = &decleration->expr;
         while (*expr) {
             fprintf(file, "=");
-            convert_expression(*expr);
+            convert_value(*expr, target);
+            target = (*expr)->type_info;
             expr = &(*expr)->next;
         }
+
+        if (!decleration->expr && is_composite_type(decleration->type_info))
+            fprintf(file, "={0}");
+        end();
+    }
+    else if (decleration->type == AST_ASSIGNMENT && is_arena_mark(decleration->expr)) {
+        fprintf(file, "neo_arena_reset(");
+        convert_expression(static_cast<Ast_Field_Expression*>(decleration->expr)->base);
+        fprintf(file, ",");
+        convert_expression(decleration->expr->next);
+        fprintf(file, ")");
         end();
     }
     else if (decleration->type == AST_ASSIGNMENT) {
         convert_expression(decleration->expr);
+        Ast_Type* target = decleration->expr->type_info;
         Ast_Expression** expr = &decleration->expr->next;
         while (*expr) {
             fprintf(file, "=");
-            convert_expression(*expr);
+            convert_value(*expr, target);
+            target = (*expr)->type_info;
             expr = &(*expr)->next;
         }
         end();
@@ -324,7 +1281,7 @@ void C_Converter::convert_decleration(Ast_Decleration* decleration) {
     else if(decleration->type == AST_FUNCTION_CALL) {
         auto call = static_cast<Ast_Function_Call*>(decleration);
         if (call->run_in_directive)
-            run_directives[run_directives_size++] = call;
+            run_directives.push(call);
         else {
             convert_function_call(call);
             end();
@@ -332,33 +1289,180 @@ void C_Converter::convert_decleration(Ast_Decleration* decleration) {
     }
 }
 
+void convert_vector_types(FILE* file) {
+    Array<Ast_Type*>* types = interned_types();
+
+    // Every vector type sema saw, including comparison masks, gets an aligned and an unaligned spelling.
+    for (int i = 0; i < types->top(); i++) {
+        Ast_Type* type = types->get(i);
+        if (type->atom_type != AST_TYPE_VECTOR)
+            continue;
+        if (type->constant) {
+            unqualified_type(type);
+            continue;
+        }
+
+        const char* lane = "i32";
+        switch (type->element->atom_type) {
+        case AST_TYPE_BYTE:   lane = "signed char"; break;
+        case AST_TYPE_LONG:   lane = "i64"; break;
+        case AST_TYPE_FLOAT:  lane = "f32"; break;
+        case AST_TYPE_DOUBLE: lane = "f64"; break;
+        default: break;
+        }
+
+        long long lanes = (long long) type->length;
+        long long size = (long long) type_size(type);
+        fprintf(file, "typedef %s neo_vec%lld_%s __attribute__((vector_size(%lld)));\n", lane, lanes, type_name(type->element), size);
+        fprintf(file, "typedef %s neo_vec%lld_%s_u __attribute__((vector_size(%lld), aligned(%lld), may_alias));\n", lane, lanes, type_name(type->element), size, (long long) type_size(type->element));
+    }
+    fprintf(file, "\n");
+}
+
+bool uses_arenas(Ast_Scope* scope) {
+    for (int i = 0; i < scope->size; i++) {
+        Ast* ast = scope->statements[i];
+
+        switch (ast->type) {
+        case AST_DECLERATION: {
+            Ast_Type* type = static_cast<Ast_Decleration*>(ast)->type_info;
+            if (type && type->atom_type == AST_TYPE_ARENA)
+                return true;
+            break;
+        }
+        case AST_FUNCTION_DEFINITION: {
+            auto func = static_cast<Ast_Function_Definition*>(ast);
+            for (int j = 0; j < func->arg_count; j++) {
+                if (func->args[j]->type_info && func->args[j]->type_info->atom_type == AST_TYPE_ARENA)
+                    return true;
+            }
+            if (uses_arenas(&func->scope))
+                return true;
+            break;
+        }
+        case AST_CONDITION: {
+            for (auto condition = static_cast<Ast_ControlFlow*>(ast); condition; condition = condition->next) {
+                if (uses_arenas(&condition->scope))
+                    return true;
+            }
+            break;
+        }
+        case AST_FOR:
+            if (uses_arenas(&static_cast<Ast_For*>(ast)->scope))
+                return true;
+            break;
+        }
+    }
+    return false;
+}
+
 void convert_transition_unit(const char* obj_name, Ast_Translation_Unit* root, SymTable* extra_headers) {
     C_Converter c;
     char buf[FILE_NAME_LEN];
+
+    begin_timer("codegen");
     c.file = open_c_file(obj_name, buf, extra_headers);
 
+    convert_vector_types(c.file);
+    if (uses_arenas(&root->scope))
+        fprintf(c.file, C_arena_runtime_buffer);
+
     for(int i = 0; i < root->scope.size; i++) {
         c.convert_decleration(static_cast<Ast_Decleration*>(root->scope.statements[i]));
     }
 
     fprintf(c.file, C_postamble_buffer);
 
-    for (int i = 0; i < run_directives_size; i++) {
-        c.convert_function_call(run_directives[i]);
+    for (int i = 0; i < c.run_directives.top(); i++) {
+        c.convert_function_call(c.run_directives.get(i));
         c.end();
     }
 
     fprintf(c.file, "\treturn 0;\n}");
+    record_timer_count("emitted_bytes", (uint64_t) ftell(c.file));
     fclose(c.file);
+    end_timer();
 
-    compile_and_link(buf, obj_name);
+    if (!options.emit_c)
+        compile_and_link(buf, obj_name);
+}
+
+// gcc picks whichever file in '<header>.gch/' was built with options compatible with this compile,
+// so there is one per set of flags. If none can be built gcc quietly reads the header as text.
+void build_precompiled_header(const char* flags) {
+    char variants[PATH_MAX + 8], gch[PATH_MAX * 2], temp[PATH_MAX * 2];
+    snprintf(variants, sizeof(variants), "%s.gch", precompiled_header);
+    snprintf(gch, sizeof(gch), "%s/%016llx.gch", variants, (unsigned long long) hash_string(flags));
+    if (access(gch, R_OK) == 0 || !make_directories(variants))
+        return;
+
+    Scoped_Timer timer("pch");
+    snprintf(temp, sizeof(temp), "%s.%d.tmp", precompiled_header, (int) getpid());
+
+    char cmd[PATH_MAX * 3];
+    snprintf(cmd, sizeof(cmd), "gcc -x c-header %s -o %s%s 2>/dev/null", precompiled_header, temp, flags);
+    if (system(cmd) != 0 || rename(temp, gch) != 0)
+        unlink(temp);
+}
+
+// The generated C carries its whole preamble, so hashing it covers the precompiled header too.
+uint64_t artifact_key(const char* file_name, const char* flags) {
+    uint64_t key = hash_string(flags, compiler_version());
+
+    FILE* file = fopen(file_name, "rb");
+    if (!file)
+        return 0;
+
+    char buffer[1 << 16];
+    size_t count;
+    while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        key = hash_bytes(buffer, count, key);
+    fclose(file);
+
+    return key;
 }
 
 void compile_and_link(const char* file_name, const char* obj_name) {
-    char cmd_buf[FILE_NAME_LEN] = "gcc ";
+    char flags[64] = "";
+    if (options.release)
+        strcat(flags, " -O2");
+    if (link_parallel_runtime)
+        strcat(flags, " -pthread");
+
+    uint64_t key = 0;
+    if (options.build_cache) {
+        Scoped_Timer timer("build cache");
+        key = artifact_key(file_name, flags);
+        if (key && restore_artifact(key, obj_name, 0755))
+            return;
+    }
+
+    if (precompiled_header[0])
+        build_precompiled_header(flags);
+
+    char cmd_buf[FILE_NAME_LEN + PATH_MAX] = "gcc ";
+    if (precompiled_header[0]) {
+        strcat(cmd_buf, "-include ");
+        strcat(cmd_buf, precompiled_header);
+        strcat(cmd_buf, " ");
+    }
     strcat(cmd_buf, file_name);
     strcat(cmd_buf, " -o ");
     strcat(cmd_buf, obj_name);
+    strcat(cmd_buf, flags);
 
-    system(cmd_buf);
+    int status;
+    {
+        Scoped_Timer timer("gcc");
+        status = system(cmd_buf);
+    }
+
+    // gcc has already printed why, the generated C is left behind to look at.
+    if (status != 0)
+        fatal_error("gcc could not compile '%s'.\n", file_name);
+
+    if (key) {
+        Scoped_Timer timer("build cache");
+        store_artifact(key, obj_name);
+    }
 }
\ No newline at end of file
@@ -0,0 +1,183 @@
+#include "../include/cache.h"
+#include "../include/options.h"
+#include "../include/hash.h"
+#include "../include/arr.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+const char* cache_directory() {
+    static char path[PATH_MAX];
+    if (path[0])
+        return path;
+
+    // Generated C includes files from here by path, so a relative directory is made absolute.
+    char cwd[PATH_MAX] = ".";
+    const char* env;
+    if (options.cache_dir || ((env = getenv("NEO_CACHE_DIR")) && *env)) {
+        const char* dir = (options.cache_dir) ? options.cache_dir : env;
+        if (dir[0] != '/' && getcwd(cwd, sizeof(cwd)))
+            snprintf(path, sizeof(path), "%s/%s", cwd, dir);
+        else
+            snprintf(path, sizeof(path), "%s", dir);
+    }
+    else if ((env = getenv("XDG_CACHE_HOME")) && *env)
+        snprintf(path, sizeof(path), "%s/neo", env);
+    else if ((env = getenv("HOME")) && *env)
+        snprintf(path, sizeof(path), "%s/.cache/neo", env);
+    else
+        snprintf(path, sizeof(path), "/tmp/neo-cache");
+
+    return path;
+}
+
+bool make_directories(const char* path) {
+    char partial[PATH_MAX];
+    snprintf(partial, sizeof(partial), "%s", path);
+
+    for (char* c = partial + 1; *c; c++) {
+        if (*c != '/')
+            continue;
+        *c = '\0';
+        if (mkdir(partial, 0755) != 0 && errno != EEXIST)
+            return false;
+        *c = '/';
+    }
+    return (mkdir(partial, 0755) == 0 || errno == EEXIST);
+}
+
+uint64_t compiler_version() {
+    static uint64_t version = 0;
+    if (version)
+        return version;
+
+    version = HASH_SEED;
+    FILE* gcc = popen("gcc -v 2>&1", "r");
+    if (!gcc)
+        return version;
+
+    char line[512];
+    while (fgets(line, sizeof(line), gcc))
+        version = hash_string(line, version);
+    pclose(gcc);
+
+    return version;
+}
+
+static void artifact_path(char* path, size_t size, uint64_t key) {
+    snprintf(path, size, "%s/artifacts/%016llx", cache_directory(), (unsigned long long) key);
+}
+
+static bool copy_file(const char* from, const char* to, int mode) {
+    int in = open(from, O_RDONLY);
+    if (in < 0)
+        return false;
+    int out = open(to, O_WRONLY | O_CREAT | O_TRUNC, mode);
+    if (out < 0) {
+        close(in);
+        return false;
+    }
+
+    char buffer[1 << 16];
+    ssize_t count;
+    bool copied = true;
+    while ((count = read(in, buffer, sizeof(buffer))) > 0) {
+        if (write(out, buffer, count) != count) {
+            copied = false;
+            break;
+        }
+    }
+
+    close(in);
+    return (close(out) == 0) && copied && count == 0;
+}
+
+bool restore_artifact(uint64_t key, const char* path, int mode) {
+    char artifact[PATH_MAX];
+    artifact_path(artifact, sizeof(artifact), key);
+
+    // The output is replaced rather than written over, so a running copy of the program is left alone.
+    char temp[PATH_MAX + 16];
+    snprintf(temp, sizeof(temp), "%s.%d", path, (int) getpid());
+    if (!copy_file(artifact, temp, mode) || rename(temp, path) != 0) {
+        unlink(temp);
+        return false;
+    }
+
+    // Eviction goes by modification time, so touching the artifact is what makes it recently used.
+    utimensat(AT_FDCWD, artifact, nullptr, 0);
+    return true;
+}
+
+struct Artifact {
+    char name[32];
+    off_t size;
+    time_t used;
+};
+
+static int compare_artifacts(const void* a, const void* b) {
+    const Artifact* left = (const Artifact*) a;
+    const Artifact* right = (const Artifact*) b;
+    return (left->used > right->used) - (left->used < right->used);
+}
+
+static void evict_artifacts(const char* dir, uint64_t limit) {
+    DIR* entries = opendir(dir);
+    if (!entries)
+        return;
+
+    Array<Artifact> artifacts;
+    uint64_t total = 0;
+
+    struct dirent* entry;
+    while ((entry = readdir(entries))) {
+        char path[PATH_MAX + 256];
+        struct stat st;
+        snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+        if (entry->d_name[0] == '.' || strlen(entry->d_name) >= sizeof(Artifact::name) || stat(path, &st) != 0 || !S_ISREG(st.st_mode))
+            continue;
+
+        Artifact artifact;
+        strcpy(artifact.name, entry->d_name);
+        artifact.size = st.st_size;
+        artifact.used = st.st_mtime;
+        artifacts.push(artifact);
+        total += st.st_size;
+    }
+    closedir(entries);
+
+    if (total <= limit)
+        return;
+
+    qsort(artifacts.get_arr(), artifacts.top(), sizeof(Artifact), compare_artifacts);
+    for (size_t i = 0; i < artifacts.top() && total > limit; i++) {
+        char path[PATH_MAX + 256];
+        snprintf(path, sizeof(path), "%s/%s", dir, artifacts.get(i).name);
+        if (unlink(path) == 0)
+            total -= artifacts.get(i).size;
+    }
+}
+
+void store_artifact(uint64_t key, const char* path) {
+    char dir[PATH_MAX], artifact[PATH_MAX], temp[PATH_MAX + 16];
+    snprintf(dir, sizeof(dir), "%s/artifacts", cache_directory());
+    if (!make_directories(dir))
+        return;
+
+    artifact_path(artifact, sizeof(artifact), key);
+    snprintf(temp, sizeof(temp), "%s.%d.tmp", artifact, (int) getpid());
+    if (!copy_file(path, temp, 0644) || rename(temp, artifact) != 0) {
+        unlink(temp);
+        return;
+    }
+
+    if (options.cache_size)
+        evict_artifacts(dir, options.cache_size);
+}
@@ -0,0 +1,143 @@
+#include "../include/call_graph.h"
+
+// Calls were resolved to their definitions by sema, so the callee needs no lookup.
+void Call_Graph::mark(Ast_Decleration* dec) {
+    if (!dec || dec->type != AST_FUNCTION_DEFINITION)
+        return;
+
+    auto func = static_cast<Ast_Function_Definition*>(dec);
+    if (!(func->flags & AST_FUNCTION_REACHABLE)) {
+        func->flags |= AST_FUNCTION_REACHABLE;
+        worklist.push(func);
+    }
+}
+
+void Call_Graph::visit_expression(Ast_Expression* expr) {
+    while (expr) {
+        switch (expr->type) {
+        case AST_BINARY_EXPRESSION: {
+            auto bin = static_cast<Ast_Binary_Expression*>(expr);
+            for (; left_link(bin); bin = left_link(bin))
+                visit_expression(bin->right);
+            visit_expression(bin->left);
+            visit_expression(bin->right);
+            break;
+        }
+        case AST_UNARY_EXPESSION: {
+            auto unary = static_cast<Ast_Unary_Expression*>(expr);
+            visit_expression(unary->nested_expr);
+            visit_expression(unary->expr);
+            break;
+        }
+        case AST_PRIMARY_EXPRESSION: {
+            auto prime = static_cast<Ast_Primary_Expression*>(expr);
+            if (prime->v_type == AST_CALL_P)
+                visit_function_call(prime->call);
+            break;
+        }
+        case AST_INDEX_EXPRESSION: {
+            auto index = static_cast<Ast_Index_Expression*>(expr);
+            visit_expression(index->base);
+            visit_expression(index->index);
+            break;
+        }
+        case AST_FIELD_EXPRESSION:
+            visit_expression(static_cast<Ast_Field_Expression*>(expr)->base);
+            break;
+        case AST_NEW_EXPRESSION: {
+            auto alloc = static_cast<Ast_New_Expression*>(expr);
+            visit_expression(alloc->count);
+            visit_expression(alloc->arena);
+            break;
+        }
+        case AST_VECTOR_EXPRESSION: {
+            auto vector = static_cast<Ast_Vector_Expression*>(expr);
+            for (int i = 0; i < vector->arg_count; i++)
+                visit_expression(vector->args[i]);
+            break;
+        }
+        }
+
+        expr = expr->next;
+    }
+}
+
+void Call_Graph::visit_function_call(Ast_Function_Call* call) {
+    mark(call->id->decleration);
+
+    for (int i = 0; i < call->arg_count; i++)
+        visit_expression(call->args[i]);
+}
+
+void Call_Graph::visit_statement(Ast* ast) {
+    switch (ast->type) {
+    case AST_STATEMENT:
+        visit_expression(static_cast<Ast_Statement*>(ast)->expr);
+        break;
+    case AST_CONDITION: {
+        auto condition = static_cast<Ast_ControlFlow*>(ast);
+        while (condition) {
+            visit_expression(condition->condition);
+            visit_scope(&condition->scope);
+            condition = condition->next;
+        }
+        break;
+    }
+    case AST_FOR: {
+        auto loop = static_cast<Ast_For*>(ast);
+        visit_expression(loop->begin);
+        visit_expression(loop->end);
+        visit_scope(&loop->scope);
+        break;
+    }
+    case AST_DECLERATION:
+    case AST_ASSIGNMENT:
+        visit_expression(static_cast<Ast_Decleration*>(ast)->expr);
+        break;
+    case AST_FUNCTION_DEFINITION:
+        visit_scope(&static_cast<Ast_Function_Definition*>(ast)->scope);
+        break;
+    case AST_FUNCTION_CALL:
+        visit_function_call(static_cast<Ast_Function_Call*>(ast));
+        break;
+    }
+}
+
+void Call_Graph::visit_scope(Ast_Scope* scope) {
+    for (int i = 0; i < scope->size; i++)
+        visit_statement(scope->statements[i]);
+}
+
+void eliminate_dead_functions(Ast_Translation_Unit* root) {
+    Call_Graph graph;
+
+    // Everything that is not a function definition at the top level runs from main and roots the graph.
+    for (int i = 0; i < root->scope.size; i++) {
+        Ast* ast = root->scope.statements[i];
+        if (ast->type != AST_FUNCTION_DEFINITION)
+            graph.visit_statement(ast);
+    }
+
+    while (graph.worklist.top() > 0) {
+        Ast_Function_Definition* func = graph.worklist.get(graph.worklist.top() - 1);
+        graph.worklist.pop();
+        graph.visit_scope(&func->scope);
+    }
+
+    int size = 0;
+    for (int i = 0; i < root->scope.size; i++) {
+        Ast* ast = root->scope.statements[i];
+
+        if (ast->type == AST_FUNCTION_DEFINITION) {
+            auto func = static_cast<Ast_Function_Definition*>(ast);
+            if (func->from == nullptr) {
+                if (!(func->flags & AST_FUNCTION_REACHABLE))
+                    continue;
+                func->flags |= AST_FUNCTION_INTERNAL;
+            }
+        }
+
+        root->scope.statements[size++] = ast;
+    }
+    root->scope.size = size;
+}
@@ -0,0 +1,341 @@
+#include "../include/const_eval.h"
+#include "../include/sema.h"
+
+#include <stdint.h>
+
+#define CONST_EVAL_MAX_DEPTH 2048
+
+Const_Local* Const_Evaluator::look_up(Ast_Decleration* dec) {
+    for (size_t i = locals.top(); i > frame; i--) {
+        Const_Local* local = &locals.get_arr()[i - 1];
+        if (local->dec == dec)
+            return local;
+    }
+    return nullptr;
+}
+
+int64_t Const_Evaluator::truncate(int64_t value, Ast_Type* type) {
+    if (!type || !is_integral_type(type)) {
+        failed = true;
+        return 0;
+    }
+
+    switch (type->atom_type) {
+    case AST_TYPE_BYTE: return (int8_t) value;
+    case AST_TYPE_INT:  return (int32_t) value;
+    default: break;
+    }
+    return value;
+}
+
+void Const_Evaluator::assign(Ast_Expression* target, int64_t value) {
+    while (target->type == AST_UNARY_EXPESSION && static_cast<Ast_Unary_Expression*>(target)->op == AST_UNARY_NESTED)
+        target = static_cast<Ast_Unary_Expression*>(target)->nested_expr;
+
+    if (target->type != AST_PRIMARY_EXPRESSION || static_cast<Ast_Primary_Expression*>(target)->v_type != AST_ID_P) {
+        failed = true;
+        return;
+    }
+
+    Const_Local* local = look_up(static_cast<Ast_Primary_Expression*>(target)->ident->decleration);
+    if (!local) {
+        failed = true;
+        return;
+    }
+
+    local->value = truncate(value, local->dec->type_info);
+}
+
+// Every link of a chain past the first is paid for here, since only the first went through evaluate_expression.
+int64_t Const_Evaluator::evaluate_binary_expression(Ast_Binary_Expression* bin) {
+    size_t base = chain.top();
+    push_chain(bin, &chain);
+    budget -= (long) (chain.top() - base - 1);
+
+    int64_t left = evaluate_expression(chain.get(chain.top() - 1)->left);
+    while (chain.top() > base) {
+        Ast_Binary_Expression* link = chain.get(chain.top() - 1);
+        chain.pop();
+
+        int64_t right = evaluate_expression(link->right);
+        left = evaluate_binary_operator(link, left, right);
+    }
+    return left;
+}
+
+int64_t Const_Evaluator::evaluate_binary_operator(Ast_Binary_Expression* bin, int64_t left, int64_t right) {
+    int64_t result = 0;
+
+    if (failed || !bin->type_info || !is_integral_type(bin->type_info)) {
+        failed = true;
+        return 0;
+    }
+
+    switch (bin->op) {
+    case AST_OPERATOR_PLUS:                     failed = __builtin_add_overflow(left, right, &result); break;
+    case AST_OPERATOR_MINUS:                    failed = __builtin_sub_overflow(left, right, &result); break;
+    case AST_OPERATOR_MULTIPLICATIVE:           failed = __builtin_mul_overflow(left, right, &result); break;
+    case AST_OPERATOR_COMPARITIVE_EQUAL:        return left == right;
+    case AST_OPERATOR_COMPARITIVE_NOT_EQUAL:    return left != right;
+    case AST_OPERATOR_LTE:                      return left <= right;
+    case AST_OPERATOR_GTE:                      return left >= right;
+    case AST_OPERATOR_LT:                       return left < right;
+    case AST_OPERATOR_GT:                       return left > right;
+    case AST_OPERATOR_DIVISION:
+    case AST_OPERATOR_MODULO:
+        if (right == 0 || (left == INT64_MIN && right == -1)) {
+            failed = true;
+            return 0;
+        }
+        result = (bin->op == AST_OPERATOR_DIVISION) ? left / right : left % right;
+        break;
+    default:
+        failed = true;
+        return 0;
+    }
+
+    // Overflow is undefined in the generated program, so it cannot be given a value here either.
+    if (truncate(result, bin->type_info) != result)
+        failed = true;
+    return result;
+}
+
+int64_t Const_Evaluator::evaluate_unary_expression(Ast_Unary_Expression* unary) {
+    switch (unary->op) {
+    case AST_UNARY_NESTED:
+        return evaluate_expression(unary->nested_expr);
+    case AST_UNARY_INC:
+    case AST_UNARY_DEC: {
+        int64_t value = evaluate_expression(unary->expr) + ((unary->op == AST_UNARY_INC) ? 1 : -1);
+        assign(unary->expr, value);
+        return evaluate_expression(unary->expr);
+    }
+    default:
+        failed = true;
+        return 0;
+    }
+}
+
+int64_t Const_Evaluator::evaluate_primary_expression(Ast_Primary_Expression* prime) {
+    switch (prime->v_type) {
+    case AST_INT_P:
+        return prime->int_const;
+    case AST_CHAR_P:
+        return prime->char_const;
+    case AST_ID_P: {
+        Ast_Decleration* dec = prime->ident->decleration;
+        Const_Local* local = (dec) ? look_up(dec) : nullptr;
+
+        if (!local) {
+            if (dec && dec->type_info && dec->type_info->constant && dec->expr && !dec->expr->next)
+                return truncate(evaluate_expression(dec->expr), dec->type_info);
+            failed = true;
+            return 0;
+        }
+
+        int64_t value = local->value;
+        if (prime->expr) {
+            int op = static_cast<Ast_Postfix_Expression*>(prime->expr)->op;
+            local->value = truncate(value + ((op == AST_UNARY_INC) ? 1 : -1), dec->type_info);
+        }
+        return value;
+    }
+    case AST_CALL_P: {
+        auto callee = static_cast<Ast_Function_Definition*>(prime->call->id->decleration);
+        if (!callee || prime->call->arg_count != callee->arg_count) {
+            failed = true;
+            return 0;
+        }
+
+        int64_t args[64];
+        for (int i = 0; i < prime->call->arg_count; i++)
+            args[i] = evaluate_expression(prime->call->args[i]);
+        return evaluate_call(callee, args);
+    }
+    default:
+        failed = true;
+        return 0;
+    }
+}
+
+int64_t Const_Evaluator::evaluate_expression(Ast_Expression* expr) {
+    if (failed || !expr || --budget <= 0) {
+        failed = true;
+        return 0;
+    }
+
+    switch (expr->type) {
+    case AST_BINARY_EXPRESSION:
+        return evaluate_binary_expression(static_cast<Ast_Binary_Expression*>(expr));
+    case AST_UNARY_EXPESSION:
+        return evaluate_unary_expression(static_cast<Ast_Unary_Expression*>(expr));
+    case AST_PRIMARY_EXPRESSION:
+        return evaluate_primary_expression(static_cast<Ast_Primary_Expression*>(expr));
+    default:
+        failed = true;
+        return 0;
+    }
+}
+
+int64_t Const_Evaluator::evaluate_assignment_chain(Ast_Expression* expr) {
+    Array<Ast_Expression*> links;
+    for (Ast_Expression* link = expr; link; link = link->next)
+        links.push(link);
+
+    int64_t value = evaluate_expression(links.get(links.top() - 1));
+    for (int i = (int) links.top() - 2; i >= 0 && !failed; i--) {
+        assign(links.get(i), value);
+        value = evaluate_expression(links.get(i));
+    }
+    return value;
+}
+
+int64_t Const_Evaluator::evaluate_call(Ast_Function_Definition* func, int64_t* args) {
+    if (failed || func->from || !(func->flags & AST_FUNCTION_PURE) || depth >= CONST_EVAL_MAX_DEPTH) {
+        failed = true;
+        return 0;
+    }
+
+    bool use_cache = (func == cached_function && args[0] >= 0 && args[0] < (int64_t) cache.top());
+    if (use_cache && cached.get(args[0]))
+        return cache.get(args[0]);
+
+    size_t saved_frame = frame;
+    frame = locals.top();
+    depth++;
+
+    for (int i = 0; i < func->arg_count; i++)
+        locals.push({ func->args[i], truncate(args[i], func->args[i]->type_info) });
+
+    execute_scope(&func->scope);
+
+    int64_t result = 0;
+    if (returned)
+        result = truncate(return_value, func->type_info);
+    else
+        failed = true;
+
+    returned = false;
+    while (locals.top() > frame)
+        locals.pop();
+    frame = saved_frame;
+    depth--;
+
+    if (use_cache && !failed) {
+        cache.get_arr()[args[0]] = result;
+        cached.get_arr()[args[0]] = true;
+    }
+    return result;
+}
+
+void Const_Evaluator::execute_statement(Ast* ast) {
+    if (--budget <= 0) {
+        failed = true;
+        return;
+    }
+
+    switch (ast->type) {
+    case AST_STATEMENT: {
+        auto stmt = static_cast<Ast_Statement*>(ast);
+        if (stmt->flags == AST_BREAK || stmt->flags == AST_CONTINUE) {
+            breaking = (stmt->flags == AST_BREAK);
+            continuing = (stmt->flags == AST_CONTINUE);
+            break;
+        }
+        else if (stmt->flags != AST_RETURN || !stmt->expr) {
+            failed = true;
+            return;
+        }
+        return_value = evaluate_expression(stmt->expr);
+        returned = true;
+        break;
+    }
+    case AST_CONDITION: {
+        auto condition = static_cast<Ast_ControlFlow*>(ast);
+        if (condition->flag == AST_CONTROL_WHILE) {
+            while (!failed && !returned && evaluate_expression(condition->condition)) {
+                execute_scope(&condition->scope);
+                continuing = false;
+                if (breaking) {
+                    breaking = false;
+                    break;
+                }
+            }
+            break;
+        }
+
+        for (Ast_ControlFlow* arm = condition; arm && !failed; arm = arm->next) {
+            if (arm->flag == AST_CONTROL_ELSE || arm->flag == AST_CONTROL_BLOCK || evaluate_expression(arm->condition)) {
+                execute_scope(&arm->scope);
+                break;
+            }
+        }
+        break;
+    }
+    case AST_FOR: {
+        auto loop = static_cast<Ast_For*>(ast);
+        int64_t begin = evaluate_expression(loop->begin);
+        int64_t end = evaluate_expression(loop->end);
+
+        size_t marker = locals.top();
+        locals.push({ loop->iterator, 0 });
+        for (int64_t i = begin; i < end && !failed && !returned; i++) {
+            locals.get_arr()[marker].value = i;
+            execute_scope(&loop->scope);
+            continuing = false;
+            if (breaking) {
+                breaking = false;
+                break;
+            }
+        }
+
+        while (locals.top() > marker)
+            locals.pop();
+        break;
+    }
+    case AST_DECLERATION: {
+        auto dec = static_cast<Ast_Decleration*>(ast);
+        int64_t value = (dec->expr) ? evaluate_assignment_chain(dec->expr) : 0;
+        locals.push({ dec, truncate(value, dec->type_info) });
+        break;
+    }
+    case AST_ASSIGNMENT:
+        evaluate_assignment_chain(static_cast<Ast_Decleration*>(ast)->expr);
+        break;
+    case AST_FUNCTION_CALL: {
+        auto call = static_cast<Ast_Function_Call*>(ast);
+        auto callee = static_cast<Ast_Function_Definition*>(call->id->decleration);
+        if (!callee || call->arg_count != callee->arg_count) {
+            failed = true;
+            return;
+        }
+
+        int64_t args[64];
+        for (int i = 0; i < call->arg_count; i++)
+            args[i] = evaluate_expression(call->args[i]);
+        evaluate_call(callee, args);
+        break;
+    }
+    default:
+        failed = true;
+        break;
+    }
+}
+
+void Const_Evaluator::execute_scope(Ast_Scope* scope) {
+    size_t marker = locals.top();
+
+    for (int i = 0; i < scope->size && !failed && !returned && !breaking && !continuing; i++)
+        execute_statement(scope->statements[i]);
+
+    while (locals.top() > marker)
+        locals.pop();
+}
+
+bool evaluate_function(Const_Evaluator* evaluator, Ast_Function_Definition* func, int64_t* args, int64_t* result) {
+    evaluator->failed = false;
+    evaluator->returned = false;
+
+    *result = evaluator->evaluate_call(func, args);
+    return !evaluator->failed;
+}
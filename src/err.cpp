@@ -1,36 +1,137 @@
 #include "../include/err.h"
+#include "../include/arr.h"
 
 #include <stdlib.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+static pthread_mutex_t diagnostics_lock = PTHREAD_MUTEX_INITIALIZER;
+static Array<Diagnostic> diagnostics;
+static uint64_t diagnostic_order = 0;
+
+static int error_limit = DEFAULT_ERROR_LIMIT;
+static int error_total = 0;
+
+static bool use_color() {
+    static int color = -1;
+    if (color < 0)
+        color = isatty(fileno(stderr));
+    return color;
+}
+
+static char* format_message(const char* fmt, va_list args) {
+    va_list copy;
+    va_copy(copy, args);
+    int length = vsnprintf(nullptr, 0, fmt, copy);
+    va_end(copy);
+
+    char* message = (char*) malloc(length + 1);
+    vsnprintf(message, length + 1, fmt, args);
+    return message;
+}
+
+static void write_diagnostic(FILE* file, const Diagnostic& diagnostic) {
+    bool error = (diagnostic.severity == DIAGNOSTIC_ERROR);
+
+    if (use_color())
+        fprintf(file, (error) ? "\033[0;31mneo error: \033[0m" : "\033[1;33mneo warning: \033[0m");
+    else
+        fprintf(file, (error) ? "neo error: " : "neo warning: ");
+
+    uint32_t line = source_manager.line_of(diagnostic.loc);
+    if (line)
+        fprintf(file, "%s on line %u.\n", diagnostic.message, line);
+    else
+        fprintf(file, "%s.\n", diagnostic.message);
+}
+
+static int compare_diagnostics(const void* a, const void* b) {
+    const Diagnostic* left = (const Diagnostic*) a;
+    const Diagnostic* right = (const Diagnostic*) b;
+
+    if (left->loc != right->loc)
+        return (left->loc < right->loc) ? -1 : 1;
+    return (left->order < right->order) ? -1 : (left->order > right->order);
+}
+
+void flush_diagnostics() {
+    pthread_mutex_lock(&diagnostics_lock);
+
+    size_t count = diagnostics.top();
+    if (count == 0) {
+        pthread_mutex_unlock(&diagnostics_lock);
+        return;
+    }
+
+    qsort(diagnostics.get_arr(), count, sizeof(Diagnostic), compare_diagnostics);
+
+    char* text = nullptr;
+    size_t size = 0;
+    FILE* buffer = open_memstream(&text, &size);
+    for (size_t i = 0; i < count; i++) {
+        write_diagnostic(buffer, diagnostics.get(i));
+        free(diagnostics.get(i).message);
+    }
+    fclose(buffer);
+
+    fwrite(text, 1, size, stderr);
+    fflush(stderr);
+    free(text);
+
+    while (diagnostics.top() > 0)
+        diagnostics.pop();
+    pthread_mutex_unlock(&diagnostics_lock);
+}
+
+static void report(int severity, Source_Location loc, const char* fmt, va_list args) {
+    Diagnostic diagnostic;
+    diagnostic.severity = severity;
+    diagnostic.loc = loc;
+    diagnostic.message = format_message(fmt, args);
+
+    pthread_mutex_lock(&diagnostics_lock);
+    diagnostic.order = diagnostic_order++;
+    diagnostics.push(diagnostic);
+
+    bool stop = false;
+    if (severity == DIAGNOSTIC_ERROR)
+        stop = (++error_total > error_limit && error_limit > 0);
+    pthread_mutex_unlock(&diagnostics_lock);
+
+    if (stop)
+        fatal_error("too many errors, stopping after %d.\n", error_limit);
+}
 
 void fatal_error(const char* fmt, ...) {
+    flush_diagnostics();
+
     va_list args;
     va_start(args, fmt);
-    
-    printf("\033[0;31mfatal neo error: \033[0m");
-    vprintf(fmt, args);
+
+    fprintf(stderr, (use_color()) ? "\033[0;31mfatal neo error: \033[0m" : "fatal neo error: ");
+    vfprintf(stderr, fmt, args);
 
     va_end(args);
     exit(EXIT_FAILURE);
 }
 
-void report_warning(const char* fmt, ...) {
+void report_warning(Source_Location loc, const char* fmt, ...) {
     va_list args;
     va_start(args, fmt);
-    
-    printf("\033[1;33mneo warning: \033[0m");    
-    vprintf(fmt, args);
-
+    report(DIAGNOSTIC_WARNING, loc, fmt, args);
     va_end(args);
 }
 
-void report_error(const char* fmt, ...) {
+void report_error(Source_Location loc, const char* fmt, ...) {
     va_list args;
     va_start(args, fmt);
-    
-    printf("\033[0;31mneo error: \033[0m");    
-    vprintf(fmt, args);
-
+    report(DIAGNOSTIC_ERROR, loc, fmt, args);
     va_end(args);
-}
\ No newline at end of file
+}
+
+void set_error_limit(int limit) {
+    error_limit = limit;
+}
@@ -0,0 +1,387 @@
+#include "../include/fold.h"
+#include "../include/sema.h"
+
+#include <stdint.h>
+
+bool is_literal(Ast_Expression* expr) {
+    if (!expr || expr->type != AST_PRIMARY_EXPRESSION)
+        return false;
+
+    auto prime = static_cast<Ast_Primary_Expression*>(expr);
+    return ((prime->v_type == AST_INT_P || prime->v_type == AST_CHAR_P) && !prime->expr);
+}
+
+int64_t literal_value(Ast_Expression* expr) {
+    auto prime = static_cast<Ast_Primary_Expression*>(expr);
+    return (prime->v_type == AST_CHAR_P) ? (int64_t) prime->char_const : prime->int_const;
+}
+
+Ast_Primary_Expression* make_literal(Ast_Expression* at, Ast_Primary_Expression* value) {
+    auto prime = new Ast_Primary_Expression;
+    track_allocation(MEM_AST, sizeof(Ast_Primary_Expression));
+    prime->loc = at->loc;
+    prime->type_info = at->type_info;
+
+    prime->v_type = value->v_type;
+    if (value->v_type == AST_CHAR_P)
+        prime->char_const = value->char_const;
+    else
+        prime->int_const = value->int_const;
+
+    return prime;
+}
+
+Ast_Primary_Expression* make_int_literal(Ast_Expression* at, int64_t value) {
+    auto prime = new Ast_Primary_Expression;
+    track_allocation(MEM_AST, sizeof(Ast_Primary_Expression));
+    prime->loc = at->loc;
+    prime->type_info = at->type_info;
+
+    prime->v_type = AST_INT_P;
+    prime->int_const = value;
+
+    return prime;
+}
+
+bool evaluate_binary(int op, int64_t left, int64_t right, bool wide, int64_t* result) {
+    switch (op) {
+    case AST_OPERATOR_PLUS:
+        if (__builtin_add_overflow(left, right, result))
+            return false;
+        break;
+    case AST_OPERATOR_MINUS:
+        if (__builtin_sub_overflow(left, right, result))
+            return false;
+        break;
+    case AST_OPERATOR_MULTIPLICATIVE:
+        if (__builtin_mul_overflow(left, right, result))
+            return false;
+        break;
+    case AST_OPERATOR_COMPARITIVE_EQUAL:        *result = left == right; break;
+    case AST_OPERATOR_COMPARITIVE_NOT_EQUAL:    *result = left != right; break;
+    case AST_OPERATOR_LTE:                      *result = left <= right; break;
+    case AST_OPERATOR_GTE:                      *result = left >= right; break;
+    case AST_OPERATOR_LT:                       *result = left < right;  break;
+    case AST_OPERATOR_GT:                       *result = left > right;  break;
+    case AST_OPERATOR_DIVISION:
+        if (right == 0 || (left == INT64_MIN && right == -1))
+            return false;
+        *result = left / right;
+        break;
+    case AST_OPERATOR_MODULO:
+        if (right == 0 || (left == INT64_MIN && right == -1))
+            return false;
+        *result = left % right;
+        break;
+    default:
+        return false;
+    }
+
+    // Anything that would overflow the emitted C type is left to run time.
+    return (wide || (*result >= INT32_MIN && *result <= INT32_MAX));
+}
+
+Ast_Primary_Expression* Folder::look_up(const char* name) {
+    for (int i = (int) bindings.top() - 1; i >= 0; i--) {
+        const Constant_Binding& binding = bindings.get(i);
+        if (strcmp(binding.name, name) == 0)
+            return (binding.known) ? binding.value : nullptr;
+    }
+
+    return nullptr;
+}
+
+void Folder::bind(Ast_Decleration* dec) {
+    if (!dec->id)
+        return;
+
+    Constant_Binding binding = { dec->id->name, false, nullptr };
+
+    if (dec->type_info && dec->type_info->constant && is_integral_type(dec->type_info) &&
+        dec->expr && !dec->expr->next && is_literal(dec->expr)) {
+        binding.known = true;
+        binding.value = static_cast<Ast_Primary_Expression*>(dec->expr);
+    }
+
+    bindings.push(binding);
+}
+
+// A chain is folded from its first operand up, so each link sees the folded result of the one below it.
+Ast_Expression* Folder::fold_binary_expression(Ast_Binary_Expression* bin) {
+    size_t base = chain.top();
+    push_chain(bin, &chain);
+
+    Ast_Expression* left = fold_expression(chain.get(chain.top() - 1)->left);
+    while (chain.top() > base) {
+        Ast_Binary_Expression* link = chain.get(chain.top() - 1);
+        chain.pop();
+
+        link->left = left;
+        link->right = fold_expression(link->right);
+        left = fold_binary_operator(link);
+    }
+    return left;
+}
+
+Ast_Expression* Folder::fold_binary_operator(Ast_Binary_Expression* bin) {
+    if (is_literal(bin->left) && is_literal(bin->right)) {
+        int64_t result;
+        if (bin->type_info && is_floating_type(bin->type_info))
+            return bin;
+
+        bool wide = (bin->type_info && bin->type_info->atom_type == AST_TYPE_LONG);
+        if (evaluate_binary(bin->op, literal_value(bin->left), literal_value(bin->right), wide, &result))
+            return make_int_literal(bin, result);
+        return bin;
+    }
+
+    if (is_literal(bin->right)) {
+        int64_t value = literal_value(bin->right);
+        switch (bin->op) {
+        case AST_OPERATOR_PLUS:
+        case AST_OPERATOR_MINUS:
+            if (value == 0)
+                return bin->left;
+            break;
+        case AST_OPERATOR_MULTIPLICATIVE:
+        case AST_OPERATOR_DIVISION:
+            if (value == 1)
+                return bin->left;
+            break;
+        }
+    }
+    else if (is_literal(bin->left)) {
+        int64_t value = literal_value(bin->left);
+        if ((bin->op == AST_OPERATOR_PLUS && value == 0) || (bin->op == AST_OPERATOR_MULTIPLICATIVE && value == 1))
+            return bin->right;
+    }
+
+    return bin;
+}
+
+Ast_Expression* Folder::fold_unary_expression(Ast_Unary_Expression* unary) {
+    switch (unary->op) {
+    case AST_UNARY_NESTED:
+        unary->nested_expr = fold_expression(unary->nested_expr);
+        if (!unary->expr && is_literal(unary->nested_expr))
+            return make_literal(unary, static_cast<Ast_Primary_Expression*>(unary->nested_expr));
+        break;
+    case AST_UNARY_DEREF:
+        unary->expr = fold_expression(unary->expr);
+        break;
+    default:
+        // Operands of ++, -- and & are lvalues and must keep their identifiers.
+        break;
+    }
+
+    return unary;
+}
+
+Ast_Expression* Folder::fold_primary_expression(Ast_Primary_Expression* prime) {
+    switch (prime->v_type) {
+    case AST_ID_P: {
+        if (prime->expr)
+            break;
+
+        auto value = look_up(prime->ident->name);
+        if (value)
+            return make_literal(prime, value);
+        break;
+    }
+    case AST_CALL_P:
+        fold_function_call(prime->call);
+        break;
+    }
+
+    return prime;
+}
+
+Ast_Expression* Folder::fold_expression(Ast_Expression* expr) {
+    if (!expr)
+        return nullptr;
+
+    Ast_Expression* next = expr->next;
+    Ast_Expression* folded = expr;
+
+    switch (expr->type) {
+    case AST_BINARY_EXPRESSION:
+        folded = fold_binary_expression(static_cast<Ast_Binary_Expression*>(expr));
+        break;
+    case AST_UNARY_EXPESSION:
+        folded = fold_unary_expression(static_cast<Ast_Unary_Expression*>(expr));
+        break;
+    case AST_PRIMARY_EXPRESSION:
+        folded = fold_primary_expression(static_cast<Ast_Primary_Expression*>(expr));
+        break;
+    case AST_INDEX_EXPRESSION: {
+        auto index = static_cast<Ast_Index_Expression*>(expr);
+        index->index = fold_expression(index->index);
+        break;
+    }
+    case AST_FIELD_EXPRESSION: {
+        // The length of an array or a vector is part of its type.
+        auto field = static_cast<Ast_Field_Expression*>(expr);
+        Ast_Type* base = field->base->type_info;
+        if (base && (base->atom_type == AST_TYPE_ARRAY || base->atom_type == AST_TYPE_VECTOR) && field->base->type == AST_PRIMARY_EXPRESSION && strcmp(field->field->name, "len") == 0)
+            folded = make_int_literal(field, base->length);
+        break;
+    }
+    case AST_NEW_EXPRESSION: {
+        auto alloc = static_cast<Ast_New_Expression*>(expr);
+        alloc->count = fold_expression(alloc->count);
+        break;
+    }
+    case AST_VECTOR_EXPRESSION: {
+        auto vector = static_cast<Ast_Vector_Expression*>(expr);
+        for (int i = 0; i < vector->arg_count; i++)
+            vector->args[i] = fold_expression(vector->args[i]);
+        break;
+    }
+    }
+
+    folded->next = next;
+    return folded;
+}
+
+void Folder::fold_function_call(Ast_Function_Call* call) {
+    for (int i = 0; i < call->arg_count; i++)
+        call->args[i] = fold_expression(call->args[i]);
+}
+
+void Folder::fold_assignment_chain(Ast_Expression** expr) {
+    if (!*expr)
+        return;
+
+    // Every link but the last is an assignment target.
+    while ((*expr)->next)
+        expr = &(*expr)->next;
+
+    *expr = fold_expression(*expr);
+}
+
+void Folder::fold_function_definition(Ast_Function_Definition* func) {
+    size_t marker = bindings.top();
+
+    for (int i = 0; i < func->arg_count; i++)
+        bind(func->args[i]);
+
+    fold_scope(&func->scope);
+
+    while (bindings.top() > marker)
+        bindings.pop();
+}
+
+Ast* Folder::fold_control_flow(Ast_ControlFlow* condition) {
+    if (condition->flag == AST_CONTROL_WHILE) {
+        condition->condition = fold_expression(condition->condition);
+        if (is_literal(condition->condition) && literal_value(condition->condition) == 0)
+            return nullptr;
+
+        fold_scope(&condition->scope);
+        return condition;
+    }
+
+    Ast_ControlFlow* head = nullptr;
+    Ast_ControlFlow** tail = &head;
+
+    Ast_ControlFlow* current = condition;
+    while (current) {
+        Ast_ControlFlow* following = current->next;
+        bool always = (current->flag == AST_CONTROL_ELSE || current->flag == AST_CONTROL_BLOCK);
+
+        if (!always) {
+            current->condition = fold_expression(current->condition);
+            if (is_literal(current->condition)) {
+                if (literal_value(current->condition) == 0) {
+                    current = following;
+                    continue;
+                }
+                always = true;
+            }
+        }
+
+        fold_scope(&current->scope);
+
+        if (always)
+            current->flag = (head) ? AST_CONTROL_ELSE : AST_CONTROL_BLOCK;
+        else
+            current->flag = (head) ? AST_CONTROL_ELIF : AST_CONTROL_IF;
+
+        current->next = nullptr;
+        *tail = current;
+        tail = &current->next;
+
+        if (always)
+            break;
+        current = following;
+    }
+
+    return head;
+}
+
+Ast* Folder::fold_for_statement(Ast_For* loop) {
+    loop->begin = fold_expression(loop->begin);
+    loop->end = fold_expression(loop->end);
+
+    if (is_literal(loop->begin) && is_literal(loop->end) && literal_value(loop->begin) >= literal_value(loop->end))
+        return nullptr;
+
+    size_t marker = bindings.top();
+    bind(loop->iterator);
+    fold_scope(&loop->scope);
+
+    while (bindings.top() > marker)
+        bindings.pop();
+    return loop;
+}
+
+Ast* Folder::fold_statement(Ast* ast) {
+    switch (ast->type) {
+    case AST_STATEMENT: {
+        auto stmt = static_cast<Ast_Statement*>(ast);
+        stmt->expr = fold_expression(stmt->expr);
+        break;
+    }
+    case AST_CONDITION:
+        return fold_control_flow(static_cast<Ast_ControlFlow*>(ast));
+    case AST_FOR:
+        return fold_for_statement(static_cast<Ast_For*>(ast));
+    case AST_DECLERATION: {
+        auto dec = static_cast<Ast_Decleration*>(ast);
+        fold_assignment_chain(&dec->expr);
+        bind(dec);
+        break;
+    }
+    case AST_ASSIGNMENT:
+        fold_assignment_chain(&static_cast<Ast_Decleration*>(ast)->expr);
+        break;
+    case AST_FUNCTION_DEFINITION:
+        fold_function_definition(static_cast<Ast_Function_Definition*>(ast));
+        break;
+    case AST_FUNCTION_CALL:
+        fold_function_call(static_cast<Ast_Function_Call*>(ast));
+        break;
+    }
+
+    return ast;
+}
+
+void Folder::fold_scope(Ast_Scope* scope) {
+    size_t marker = bindings.top();
+
+    int size = 0;
+    for (int i = 0; i < scope->size; i++) {
+        Ast* stmt = fold_statement(scope->statements[i]);
+        if (stmt)
+            scope->statements[size++] = stmt;
+    }
+    scope->size = size;
+
+    while (bindings.top() > marker)
+        bindings.pop();
+}
+
+void fold_translation_unit(Ast_Translation_Unit* root) {
+    Folder folder;
+    folder.fold_scope(&root->scope);
+}
@@ -0,0 +1,24 @@
+#include "../include/hash.h"
+
+#define HASH_PRIME 0x100000001b3ULL
+
+uint64_t hash_bytes(const void* data, size_t size, uint64_t seed) {
+    const uint8_t* bytes = (const uint8_t*) data;
+    uint64_t hash = seed;
+
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= HASH_PRIME;
+    }
+    return hash;
+}
+
+uint64_t hash_string(const char* str, uint64_t seed) {
+    uint64_t hash = seed;
+
+    for (; *str; str++) {
+        hash ^= (uint8_t) *str;
+        hash *= HASH_PRIME;
+    }
+    return hash;
+}
@@ -0,0 +1,852 @@
+#include "../include/inline.h"
+#include "../include/sema.h"
+#include "../include/options.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define INLINE_MAX_DEPTH 8
+#define INLINE_MAX_DUPLICATE_SIZE 3
+#define TAIL_CALL_NAME_LEN 128
+
+template <typename T>
+T* new_node(Ast* at) {
+    T* node = new T;
+    track_allocation(MEM_AST, sizeof(T));
+    node->loc = at->loc;
+    return node;
+}
+
+int expression_size(Ast_Expression* expr) {
+    int size = 0;
+    for (; expr; expr = expr->next) {
+        size++;
+        switch (expr->type) {
+        case AST_BINARY_EXPRESSION: {
+            auto bin = static_cast<Ast_Binary_Expression*>(expr);
+            while (Ast_Binary_Expression* link = left_link(bin)) {
+                size += expression_size(bin->right) + 1;
+                bin = link;
+            }
+            size += expression_size(bin->left) + expression_size(bin->right);
+            break;
+        }
+        case AST_UNARY_EXPESSION: {
+            auto unary = static_cast<Ast_Unary_Expression*>(expr);
+            size += expression_size(unary->nested_expr) + expression_size(unary->expr);
+            break;
+        }
+        case AST_PRIMARY_EXPRESSION: {
+            auto prime = static_cast<Ast_Primary_Expression*>(expr);
+            if (prime->v_type == AST_CALL_P) {
+                for (int i = 0; i < prime->call->arg_count; i++)
+                    size += expression_size(prime->call->args[i]);
+            }
+            break;
+        }
+        case AST_INDEX_EXPRESSION: {
+            auto index = static_cast<Ast_Index_Expression*>(expr);
+            size += expression_size(index->base) + expression_size(index->index);
+            break;
+        }
+        case AST_FIELD_EXPRESSION:
+            size += expression_size(static_cast<Ast_Field_Expression*>(expr)->base);
+            break;
+        case AST_NEW_EXPRESSION:
+            size += expression_size(static_cast<Ast_New_Expression*>(expr)->count);
+            break;
+        case AST_VECTOR_EXPRESSION: {
+            auto vector = static_cast<Ast_Vector_Expression*>(expr);
+            for (int i = 0; i < vector->arg_count; i++)
+                size += expression_size(vector->args[i]);
+            break;
+        }
+        }
+    }
+    return size;
+}
+
+bool has_side_effects(Ast_Expression* expr) {
+    for (; expr; expr = expr->next) {
+        switch (expr->type) {
+        case AST_BINARY_EXPRESSION: {
+            auto bin = static_cast<Ast_Binary_Expression*>(expr);
+            for (; left_link(bin); bin = left_link(bin)) {
+                if (has_side_effects(bin->right))
+                    return true;
+            }
+            if (has_side_effects(bin->left) || has_side_effects(bin->right))
+                return true;
+            break;
+        }
+        case AST_UNARY_EXPESSION: {
+            auto unary = static_cast<Ast_Unary_Expression*>(expr);
+            if (unary->op == AST_UNARY_INC || unary->op == AST_UNARY_DEC || has_side_effects(unary->nested_expr) || has_side_effects(unary->expr))
+                return true;
+            break;
+        }
+        case AST_PRIMARY_EXPRESSION: {
+            auto prime = static_cast<Ast_Primary_Expression*>(expr);
+            if (prime->expr || prime->v_type == AST_CALL_P)
+                return true;
+            break;
+        }
+        case AST_INDEX_EXPRESSION: {
+            auto index = static_cast<Ast_Index_Expression*>(expr);
+            if (index->postfix != AST_UNARY_NONE || has_side_effects(index->base) || has_side_effects(index->index))
+                return true;
+            break;
+        }
+        case AST_FIELD_EXPRESSION:
+            if (has_side_effects(static_cast<Ast_Field_Expression*>(expr)->base))
+                return true;
+            break;
+        case AST_NEW_EXPRESSION:
+            return true;
+        case AST_VECTOR_EXPRESSION: {
+            auto vector = static_cast<Ast_Vector_Expression*>(expr);
+            for (int i = 0; i < vector->arg_count; i++) {
+                if (has_side_effects(vector->args[i]))
+                    return true;
+            }
+            break;
+        }
+        }
+    }
+    return false;
+}
+
+int count_uses(Ast_Expression* expr, Ast_Decleration* dec) {
+    int uses = 0;
+    for (; expr; expr = expr->next) {
+        switch (expr->type) {
+        case AST_BINARY_EXPRESSION: {
+            auto bin = static_cast<Ast_Binary_Expression*>(expr);
+            for (; left_link(bin); bin = left_link(bin))
+                uses += count_uses(bin->right, dec);
+            uses += count_uses(bin->left, dec) + count_uses(bin->right, dec);
+            break;
+        }
+        case AST_UNARY_EXPESSION: {
+            auto unary = static_cast<Ast_Unary_Expression*>(expr);
+            uses += count_uses(unary->nested_expr, dec) + count_uses(unary->expr, dec);
+            break;
+        }
+        case AST_PRIMARY_EXPRESSION: {
+            auto prime = static_cast<Ast_Primary_Expression*>(expr);
+            if (prime->v_type == AST_ID_P && prime->ident->decleration == dec)
+                uses++;
+            else if (prime->v_type == AST_CALL_P) {
+                for (int i = 0; i < prime->call->arg_count; i++)
+                    uses += count_uses(prime->call->args[i], dec);
+            }
+            break;
+        }
+        case AST_INDEX_EXPRESSION: {
+            auto index = static_cast<Ast_Index_Expression*>(expr);
+            uses += count_uses(index->base, dec) + count_uses(index->index, dec);
+            break;
+        }
+        case AST_FIELD_EXPRESSION:
+            uses += count_uses(static_cast<Ast_Field_Expression*>(expr)->base, dec);
+            break;
+        case AST_NEW_EXPRESSION: {
+            auto alloc = static_cast<Ast_New_Expression*>(expr);
+            uses += count_uses(alloc->count, dec) + count_uses(alloc->arena, dec);
+            break;
+        }
+        case AST_VECTOR_EXPRESSION: {
+            auto vector = static_cast<Ast_Vector_Expression*>(expr);
+            for (int i = 0; i < vector->arg_count; i++)
+                uses += count_uses(vector->args[i], dec);
+            break;
+        }
+        }
+    }
+    return uses;
+}
+
+// Walks down to the variable an element or field access starts from.
+static bool is_parameter(Ast_Expression* expr, Ast_Function_Definition* func) {
+    while (expr && (expr->type == AST_INDEX_EXPRESSION || expr->type == AST_FIELD_EXPRESSION))
+        expr = (expr->type == AST_INDEX_EXPRESSION) ? static_cast<Ast_Index_Expression*>(expr)->base : static_cast<Ast_Field_Expression*>(expr)->base;
+    if (!expr || expr->type != AST_PRIMARY_EXPRESSION || static_cast<Ast_Primary_Expression*>(expr)->v_type != AST_ID_P)
+        return false;
+
+    Ast_Decleration* dec = static_cast<Ast_Primary_Expression*>(expr)->ident->decleration;
+    for (int i = 0; i < func->arg_count; i++) {
+        if (func->args[i] == dec)
+            return true;
+    }
+    return false;
+}
+
+// An argument is pasted in place of its parameter, so a body that increments or takes the address of one
+// would write to the caller's variable, or to a literal.
+bool writes_parameter(Ast_Expression* expr, Ast_Function_Definition* func) {
+    for (; expr; expr = expr->next) {
+        switch (expr->type) {
+        case AST_BINARY_EXPRESSION: {
+            auto bin = static_cast<Ast_Binary_Expression*>(expr);
+            for (; left_link(bin); bin = left_link(bin)) {
+                if (writes_parameter(bin->right, func))
+                    return true;
+            }
+            if (writes_parameter(bin->left, func) || writes_parameter(bin->right, func))
+                return true;
+            break;
+        }
+        case AST_UNARY_EXPESSION: {
+            auto unary = static_cast<Ast_Unary_Expression*>(expr);
+            bool writes = (unary->op == AST_UNARY_INC || unary->op == AST_UNARY_DEC || unary->op == AST_UNARY_REF);
+            if ((writes && is_parameter(unary->expr, func)) || writes_parameter(unary->nested_expr, func) || writes_parameter(unary->expr, func))
+                return true;
+            break;
+        }
+        case AST_PRIMARY_EXPRESSION: {
+            auto prime = static_cast<Ast_Primary_Expression*>(expr);
+            if (prime->expr && is_parameter(prime, func))
+                return true;
+            if (prime->v_type == AST_CALL_P) {
+                for (int i = 0; i < prime->call->arg_count; i++) {
+                    if (writes_parameter(prime->call->args[i], func))
+                        return true;
+                }
+            }
+            break;
+        }
+        case AST_INDEX_EXPRESSION: {
+            auto index = static_cast<Ast_Index_Expression*>(expr);
+            if ((index->postfix != AST_UNARY_NONE && is_parameter(index, func)) || writes_parameter(index->base, func) || writes_parameter(index->index, func))
+                return true;
+            break;
+        }
+        case AST_FIELD_EXPRESSION:
+            if (writes_parameter(static_cast<Ast_Field_Expression*>(expr)->base, func))
+                return true;
+            break;
+        case AST_NEW_EXPRESSION: {
+            auto alloc = static_cast<Ast_New_Expression*>(expr);
+            if (writes_parameter(alloc->count, func) || writes_parameter(alloc->arena, func))
+                return true;
+            break;
+        }
+        case AST_VECTOR_EXPRESSION: {
+            auto vector = static_cast<Ast_Vector_Expression*>(expr);
+            for (int i = 0; i < vector->arg_count; i++) {
+                if (writes_parameter(vector->args[i], func))
+                    return true;
+            }
+            break;
+        }
+        }
+    }
+    return false;
+}
+
+bool is_simple_operand(Ast_Expression* expr) {
+    if (expr->type != AST_PRIMARY_EXPRESSION)
+        return false;
+    auto prime = static_cast<Ast_Primary_Expression*>(expr);
+    return (prime->v_type != AST_CALL_P && !prime->expr);
+}
+
+Ast_Unary_Expression* make_nested(Ast_Expression* expr) {
+    auto nested = new_node<Ast_Unary_Expression>(expr);
+    nested->op = AST_UNARY_NESTED;
+    nested->nested_expr = expr;
+    nested->type_info = expr->type_info;
+    return nested;
+}
+
+Inline_Function* Inliner::find_function(Ast_Function_Definition* func) {
+    for (int i = 0; i < functions.top(); i++) {
+        if (functions.get(i).func == func)
+            return &functions.get_arr()[i];
+    }
+    return nullptr;
+}
+
+bool Inliner::reaches(Ast_Function_Definition* from, Ast_Function_Definition* target, Array<Ast_Function_Definition*>* visited) {
+    Inline_Function* node = find_function(from);
+    if (!node)
+        return false;
+
+    for (int i = 0; i < node->callees.top(); i++) {
+        Ast_Function_Definition* callee = node->callees.get(i);
+        if (callee == target)
+            return true;
+
+        bool seen = false;
+        for (int j = 0; j < visited->top() && !seen; j++)
+            seen = (visited->get(j) == callee);
+        if (seen)
+            continue;
+
+        visited->push(callee);
+        if (reaches(callee, target, visited))
+            return true;
+    }
+    return false;
+}
+
+void Inliner::collect_expression(Ast_Expression* expr, Array<Ast_Function_Definition*>* callees) {
+    for (; expr; expr = expr->next) {
+        switch (expr->type) {
+        case AST_BINARY_EXPRESSION: {
+            auto bin = static_cast<Ast_Binary_Expression*>(expr);
+            for (; left_link(bin); bin = left_link(bin))
+                collect_expression(bin->right, callees);
+            collect_expression(bin->left, callees);
+            collect_expression(bin->right, callees);
+            break;
+        }
+        case AST_UNARY_EXPESSION: {
+            auto unary = static_cast<Ast_Unary_Expression*>(expr);
+            collect_expression(unary->nested_expr, callees);
+            collect_expression(unary->expr, callees);
+            break;
+        }
+        case AST_PRIMARY_EXPRESSION: {
+            auto prime = static_cast<Ast_Primary_Expression*>(expr);
+            if (prime->v_type != AST_CALL_P)
+                break;
+
+            if (prime->call->id->decleration)
+                callees->push(static_cast<Ast_Function_Definition*>(prime->call->id->decleration));
+            for (int i = 0; i < prime->call->arg_count; i++)
+                collect_expression(prime->call->args[i], callees);
+            break;
+        }
+        case AST_INDEX_EXPRESSION: {
+            auto index = static_cast<Ast_Index_Expression*>(expr);
+            collect_expression(index->base, callees);
+            collect_expression(index->index, callees);
+            break;
+        }
+        case AST_FIELD_EXPRESSION:
+            collect_expression(static_cast<Ast_Field_Expression*>(expr)->base, callees);
+            break;
+        case AST_NEW_EXPRESSION:
+            collect_expression(static_cast<Ast_New_Expression*>(expr)->count, callees);
+            break;
+        case AST_VECTOR_EXPRESSION: {
+            auto vector = static_cast<Ast_Vector_Expression*>(expr);
+            for (int i = 0; i < vector->arg_count; i++)
+                collect_expression(vector->args[i], callees);
+            break;
+        }
+        }
+    }
+}
+
+void Inliner::collect_scope(Ast_Scope* scope, Array<Ast_Function_Definition*>* callees) {
+    for (int i = 0; i < scope->size; i++) {
+        Ast* ast = scope->statements[i];
+
+        switch (ast->type) {
+        case AST_STATEMENT:
+            collect_expression(static_cast<Ast_Statement*>(ast)->expr, callees);
+            break;
+        case AST_CONDITION:
+            for (auto condition = static_cast<Ast_ControlFlow*>(ast); condition; condition = condition->next) {
+                collect_expression(condition->condition, callees);
+                collect_scope(&condition->scope, callees);
+            }
+            break;
+        case AST_FOR: {
+            auto loop = static_cast<Ast_For*>(ast);
+            collect_expression(loop->begin, callees);
+            collect_expression(loop->end, callees);
+            collect_scope(&loop->scope, callees);
+            break;
+        }
+        case AST_DECLERATION:
+        case AST_ASSIGNMENT:
+            collect_expression(static_cast<Ast_Decleration*>(ast)->expr, callees);
+            break;
+        case AST_FUNCTION_DEFINITION:
+            collect_scope(&static_cast<Ast_Function_Definition*>(ast)->scope, callees);
+            break;
+        case AST_FUNCTION_CALL: {
+            auto call = static_cast<Ast_Function_Call*>(ast);
+            if (call->id->decleration)
+                callees->push(static_cast<Ast_Function_Definition*>(call->id->decleration));
+            for (int j = 0; j < call->arg_count; j++)
+                collect_expression(call->args[j], callees);
+            break;
+        }
+        }
+    }
+}
+
+Ast_Expression* Inliner::inline_body(Ast_Function_Definition* func) {
+    Inline_Function* node = find_function(func);
+    if (!node || node->recursive || func->from || (func->flags & AST_FUNCTION_MEMOIZE) || !func->type_info)
+        return nullptr;
+
+    if (func->scope.size != 1 || func->scope.statements[0]->type != AST_STATEMENT)
+        return nullptr;
+
+    auto stmt = static_cast<Ast_Statement*>(func->scope.statements[0]);
+    Ast_Expression* body = stmt->expr;
+    if (stmt->flags != AST_RETURN || !body || body->next || !body->type_info)
+        return nullptr;
+
+    // The return converts to the declared type; an inlined body has no such conversion point.
+    if (body->type_info->atom_type != func->type_info->atom_type)
+        return nullptr;
+
+    if (expression_size(body) > options.inline_budget)
+        return nullptr;
+
+    if (writes_parameter(body, func))
+        return nullptr;
+
+    for (int i = 0; i < func->arg_count; i++) {
+        if (!func->args[i]->type_info)
+            return nullptr;
+    }
+
+    return body;
+}
+
+Ast_Expression* Inliner::substitute(Ast_Expression* expr, Ast_Function_Definition* func, Ast_Expression** args) {
+    if (!expr)
+        return nullptr;
+
+    switch (expr->type) {
+    case AST_BINARY_EXPRESSION: {
+        // A chain is copied link by link on the way down, each copy's left operand is the next one.
+        auto bin = static_cast<Ast_Binary_Expression*>(expr);
+        Ast_Expression* result = nullptr;
+        Ast_Expression** slot = &result;
+        for (;;) {
+            auto copy = new_node<Ast_Binary_Expression>(bin);
+            copy->op = bin->op;
+            copy->type_info = bin->type_info;
+            copy->right = substitute(bin->right, func, args);
+            *slot = copy;
+            slot = &copy->left;
+
+            Ast_Binary_Expression* link = left_link(bin);
+            if (!link)
+                break;
+            bin = link;
+        }
+        *slot = substitute(bin->left, func, args);
+        return result;
+    }
+    case AST_UNARY_EXPESSION: {
+        auto unary = static_cast<Ast_Unary_Expression*>(expr);
+        auto copy = new_node<Ast_Unary_Expression>(unary);
+        copy->op = unary->op;
+        copy->type_info = unary->type_info;
+        copy->nested_expr = substitute(unary->nested_expr, func, args);
+        copy->expr = substitute(unary->expr, func, args);
+        return copy;
+    }
+    case AST_PRIMARY_EXPRESSION: {
+        auto prime = static_cast<Ast_Primary_Expression*>(expr);
+
+        if (func && prime->v_type == AST_ID_P) {
+            for (int i = 0; i < func->arg_count; i++) {
+                if (prime->ident->decleration != func->args[i])
+                    continue;
+
+                Ast_Expression* arg = substitute(args[i], nullptr, nullptr);
+                return (is_simple_operand(arg)) ? arg : make_nested(arg);
+            }
+        }
+
+        auto copy = new_node<Ast_Primary_Expression>(prime);
+        *copy = *prime;
+        copy->next = nullptr;
+
+        if (prime->v_type == AST_CALL_P) {
+            copy->call = new_node<Ast_Function_Call>(prime->call);
+            copy->call->id = prime->call->id;
+            copy->call->arg_count = prime->call->arg_count;
+            for (int i = 0; i < prime->call->arg_count; i++)
+                copy->call->args[i] = substitute(prime->call->args[i], func, args);
+        }
+        return copy;
+    }
+    case AST_INDEX_EXPRESSION: {
+        auto index = static_cast<Ast_Index_Expression*>(expr);
+        auto copy = new_node<Ast_Index_Expression>(index);
+        copy->type_info = index->type_info;
+        copy->postfix = index->postfix;
+        copy->checked = index->checked;
+        copy->base = substitute(index->base, func, args);
+        copy->index = substitute(index->index, func, args);
+        return copy;
+    }
+    case AST_FIELD_EXPRESSION: {
+        auto field = static_cast<Ast_Field_Expression*>(expr);
+        auto copy = new_node<Ast_Field_Expression>(field);
+        copy->type_info = field->type_info;
+        copy->field = field->field;
+        copy->member = field->member;
+        copy->base = substitute(field->base, func, args);
+        return copy;
+    }
+    case AST_NEW_EXPRESSION: {
+        auto alloc = static_cast<Ast_New_Expression*>(expr);
+        auto copy = new_node<Ast_New_Expression>(alloc);
+        copy->type_info = alloc->type_info;
+        copy->element = alloc->element;
+        copy->count = substitute(alloc->count, func, args);
+        copy->arena = substitute(alloc->arena, func, args);
+        return copy;
+    }
+    case AST_VECTOR_EXPRESSION: {
+        auto vector = static_cast<Ast_Vector_Expression*>(expr);
+        auto copy = new_node<Ast_Vector_Expression>(vector);
+        copy->type_info = vector->type_info;
+        copy->vector = vector->vector;
+        copy->form = vector->form;
+        copy->checked = vector->checked;
+        copy->arg_count = vector->arg_count;
+        for (int i = 0; i < vector->arg_count; i++)
+            copy->args[i] = substitute(vector->args[i], func, args);
+        return copy;
+    }
+    }
+
+    return expr;
+}
+
+Ast_Expression* Inliner::inline_call(Ast_Primary_Expression* prime, int depth) {
+    Ast_Function_Call* call = prime->call;
+    auto callee = static_cast<Ast_Function_Definition*>(call->id->decleration);
+    if (prime->expr || !callee || callee->type != AST_FUNCTION_DEFINITION || call->arg_count != callee->arg_count)
+        return prime;
+
+    Ast_Expression* body = inline_body(callee);
+    if (!body)
+        return prime;
+
+    for (int i = 0; i < call->arg_count; i++) {
+        Ast_Expression* arg = call->args[i];
+        if (has_side_effects(arg) || !arg->type_info || arg->type_info->atom_type != callee->args[i]->type_info->atom_type)
+            return prime;
+
+        // Arguments are substituted by value, so a repeated parameter repeats its argument.
+        if (count_uses(body, callee->args[i]) > 1 && !is_simple_operand(arg) && expression_size(arg) > INLINE_MAX_DUPLICATE_SIZE)
+            return prime;
+    }
+
+    Ast_Unary_Expression* result = make_nested(substitute(body, callee, call->args));
+    result->type_info = unqualified_type(callee->type_info);
+    inlined++;
+
+    return inline_expression(result, depth + 1);
+}
+
+Ast_Expression* Inliner::inline_expression(Ast_Expression* expr, int depth) {
+    if (!expr)
+        return nullptr;
+
+    switch (expr->type) {
+    case AST_BINARY_EXPRESSION: {
+        // Links of a chain are never replaced, only the operands hanging off it.
+        auto bin = static_cast<Ast_Binary_Expression*>(expr);
+        for (; left_link(bin); bin = left_link(bin))
+            bin->right = inline_expression(bin->right, depth);
+        bin->left = inline_expression(bin->left, depth);
+        bin->right = inline_expression(bin->right, depth);
+        break;
+    }
+    case AST_UNARY_EXPESSION: {
+        auto unary = static_cast<Ast_Unary_Expression*>(expr);
+        unary->nested_expr = inline_expression(unary->nested_expr, depth);
+        unary->expr = inline_expression(unary->expr, depth);
+        break;
+    }
+    case AST_PRIMARY_EXPRESSION: {
+        auto prime = static_cast<Ast_Primary_Expression*>(expr);
+        if (prime->v_type != AST_CALL_P)
+            break;
+
+        for (int i = 0; i < prime->call->arg_count; i++)
+            prime->call->args[i] = inline_expression(prime->call->args[i], depth);
+
+        if (depth < INLINE_MAX_DEPTH) {
+            Ast_Expression* result = inline_call(prime, depth);
+            if (result != prime) {
+                result->next = inline_expression(prime->next, depth);
+                return result;
+            }
+        }
+        break;
+    }
+    case AST_INDEX_EXPRESSION: {
+        auto index = static_cast<Ast_Index_Expression*>(expr);
+        index->base = inline_expression(index->base, depth);
+        index->index = inline_expression(index->index, depth);
+        break;
+    }
+    case AST_FIELD_EXPRESSION: {
+        auto field = static_cast<Ast_Field_Expression*>(expr);
+        field->base = inline_expression(field->base, depth);
+        break;
+    }
+    case AST_NEW_EXPRESSION: {
+        auto alloc = static_cast<Ast_New_Expression*>(expr);
+        alloc->count = inline_expression(alloc->count, depth);
+        break;
+    }
+    case AST_VECTOR_EXPRESSION: {
+        auto vector = static_cast<Ast_Vector_Expression*>(expr);
+        for (int i = 0; i < vector->arg_count; i++)
+            vector->args[i] = inline_expression(vector->args[i], depth);
+        break;
+    }
+    }
+
+    expr->next = inline_expression(expr->next, depth);
+    return expr;
+}
+
+void Inliner::inline_function_call(Ast_Function_Call* call) {
+    for (int i = 0; i < call->arg_count; i++)
+        call->args[i] = inline_expression(call->args[i], 0);
+}
+
+void Inliner::inline_statement(Ast* ast) {
+    switch (ast->type) {
+    case AST_STATEMENT: {
+        auto stmt = static_cast<Ast_Statement*>(ast);
+        stmt->expr = inline_expression(stmt->expr, 0);
+        break;
+    }
+    case AST_CONDITION:
+        for (auto condition = static_cast<Ast_ControlFlow*>(ast); condition; condition = condition->next) {
+            condition->condition = inline_expression(condition->condition, 0);
+            inline_scope(&condition->scope);
+        }
+        break;
+    case AST_FOR: {
+        auto loop = static_cast<Ast_For*>(ast);
+        loop->begin = inline_expression(loop->begin, 0);
+        loop->end = inline_expression(loop->end, 0);
+        inline_scope(&loop->scope);
+        break;
+    }
+    case AST_DECLERATION:
+    case AST_ASSIGNMENT: {
+        auto dec = static_cast<Ast_Decleration*>(ast);
+        dec->expr = inline_expression(dec->expr, 0);
+        break;
+    }
+    case AST_FUNCTION_DEFINITION:
+        inline_scope(&static_cast<Ast_Function_Definition*>(ast)->scope);
+        break;
+    case AST_FUNCTION_CALL:
+        inline_function_call(static_cast<Ast_Function_Call*>(ast));
+        break;
+    }
+}
+
+void Inliner::inline_scope(Ast_Scope* scope) {
+    for (int i = 0; i < scope->size; i++)
+        inline_statement(scope->statements[i]);
+}
+
+void inline_functions(Ast_Translation_Unit* root) {
+    if (!options.inline_functions)
+        return;
+
+    Inliner inliner;
+
+    for (int i = 0; i < root->scope.size; i++) {
+        Ast* ast = root->scope.statements[i];
+        if (ast->type != AST_FUNCTION_DEFINITION || static_cast<Ast_Function_Definition*>(ast)->from)
+            continue;
+
+        Inline_Function node;
+        node.func = static_cast<Ast_Function_Definition*>(ast);
+        inliner.collect_scope(&node.func->scope, &node.callees);
+        inliner.functions.push(node);
+    }
+
+    // Anything on a call cycle is never inlined, which also bounds how far inlining can expand.
+    for (int i = 0; i < inliner.functions.top(); i++) {
+        Inline_Function* node = &inliner.functions.get_arr()[i];
+        Array<Ast_Function_Definition*> visited;
+        node->recursive = inliner.reaches(node->func, node->func, &visited);
+    }
+
+    for (int i = 0; i < root->scope.size; i++)
+        inliner.inline_statement(root->scope.statements[i]);
+}
+
+bool Tail_Call_Rewriter::is_self_call(Ast_Expression* expr) {
+    if (!expr || expr->next || expr->type != AST_PRIMARY_EXPRESSION)
+        return false;
+
+    auto prime = static_cast<Ast_Primary_Expression*>(expr);
+    return (prime->v_type == AST_CALL_P && !prime->expr && prime->call->id->decleration == func && prime->call->arg_count == func->arg_count);
+}
+
+Ast* Tail_Call_Rewriter::rewrite_call(Ast_Function_Call* call) {
+    bool side_effects = false;
+    for (int i = 0; i < call->arg_count; i++)
+        side_effects |= has_side_effects(call->args[i]);
+
+    Array<int> changed;
+    for (int i = 0; i < call->arg_count; i++) {
+        Ast_Expression* arg = call->args[i];
+        bool same = (!side_effects && arg->type == AST_PRIMARY_EXPRESSION && static_cast<Ast_Primary_Expression*>(arg)->v_type == AST_ID_P &&
+            static_cast<Ast_Primary_Expression*>(arg)->ident->decleration == func->args[i]);
+        if (!same)
+            changed.push(i);
+    }
+
+    // Arguments are all evaluated before any parameter is reassigned, through temporaries when more than one changes.
+    bool temporaries = (changed.top() > 1 || side_effects);
+
+    auto block = new_node<Ast_ControlFlow>(call);
+    block->flag = AST_CONTROL_BLOCK;
+
+    Ast_Decleration* temps[64];
+    for (int i = 0; i < changed.top() && temporaries; i++) {
+        Ast_Decleration* param = func->args[changed.get(i)];
+
+        auto temp = new_node<Ast_Decleration>(call);
+        temp->type_info = unqualified_type(param->type_info);
+        temp->id = new_node<Ast_Ident>(call);
+        temp->id->name = (char*) malloc(TAIL_CALL_NAME_LEN);
+        track_allocation(MEM_STRINGS, TAIL_CALL_NAME_LEN);
+        snprintf(temp->id->name, TAIL_CALL_NAME_LEN, "__tail_%s", param->id->name);
+        temp->id->decleration = temp;
+        temp->expr = call->args[changed.get(i)];
+
+        temps[i] = temp;
+        block->scope.add(temp);
+    }
+
+    for (int i = 0; i < changed.top(); i++) {
+        Ast_Decleration* param = func->args[changed.get(i)];
+
+        auto target = new_node<Ast_Primary_Expression>(call);
+        target->v_type = AST_ID_P;
+        target->ident = new_node<Ast_Ident>(call);
+        target->ident->name = param->id->name;
+        target->ident->decleration = param;
+        target->type_info = param->type_info;
+
+        if (temporaries) {
+            auto value = new_node<Ast_Primary_Expression>(call);
+            value->v_type = AST_ID_P;
+            value->ident = temps[i]->id;
+            value->type_info = temps[i]->type_info;
+            target->next = value;
+        }
+        else
+            target->next = call->args[changed.get(i)];
+
+        auto assignment = new_node<Ast_Decleration>(call);
+        assignment->type = AST_ASSIGNMENT;
+        assignment->expr = target;
+        block->scope.add(assignment);
+    }
+
+    auto next = new_node<Ast_Statement>(call);
+    next->flags = AST_CONTINUE;
+    block->scope.add(next);
+
+    rewritten++;
+    return block;
+}
+
+void Tail_Call_Rewriter::rewrite_scope(Ast_Scope* scope, bool at_end) {
+    for (int i = 0; i < scope->size; i++) {
+        Ast* ast = scope->statements[i];
+        bool last = at_end && (i == scope->size - 1);
+        Ast* rewritten_call = nullptr;
+
+        switch (ast->type) {
+        case AST_STATEMENT: {
+            auto stmt = static_cast<Ast_Statement*>(ast);
+            if (stmt->flags == AST_RETURN && is_self_call(stmt->expr))
+                rewritten_call = rewrite_call(static_cast<Ast_Primary_Expression*>(stmt->expr)->call);
+            break;
+        }
+        case AST_FUNCTION_CALL: {
+            // A void function calling itself right before it returns is a tail call as well.
+            auto call = static_cast<Ast_Function_Call*>(ast);
+            bool returns_next = (i + 1 < scope->size && scope->statements[i + 1]->type == AST_STATEMENT &&
+                static_cast<Ast_Statement*>(scope->statements[i + 1])->flags == AST_RETURN);
+            if (!func->type_info && call->id->decleration == func && call->arg_count == func->arg_count && (last || returns_next))
+                rewritten_call = rewrite_call(call);
+            break;
+        }
+        case AST_CONDITION: {
+            // A continue inside a nested loop would restart that loop instead, so loops are left alone.
+            auto condition = static_cast<Ast_ControlFlow*>(ast);
+            if (condition->flag == AST_CONTROL_WHILE)
+                break;
+            for (; condition; condition = condition->next)
+                rewrite_scope(&condition->scope, last);
+            break;
+        }
+        }
+
+        if (rewritten_call)
+            scope->statements[i] = rewritten_call;
+    }
+}
+
+void eliminate_tail_calls(Ast_Translation_Unit* root) {
+    for (int i = 0; i < root->scope.size; i++) {
+        Ast* ast = root->scope.statements[i];
+        if (ast->type != AST_FUNCTION_DEFINITION)
+            continue;
+
+        auto func = static_cast<Ast_Function_Definition*>(ast);
+        if (func->from || (func->flags & AST_FUNCTION_MEMOIZE))
+            continue;
+
+        bool assignable = true;
+        for (int j = 0; j < func->arg_count; j++)
+            assignable &= (func->args[j]->type_info && !func->args[j]->type_info->constant);
+        if (!assignable)
+            continue;
+
+        Tail_Call_Rewriter rewriter;
+        rewriter.func = func;
+        rewriter.rewrite_scope(&func->scope, true);
+        if (rewriter.rewritten == 0)
+            continue;
+
+        auto one = new_node<Ast_Primary_Expression>(func);
+        one->v_type = AST_INT_P;
+        one->int_const = 1;
+        one->type_info = canonical_type(AST_TYPE_INT);
+
+        auto loop = new_node<Ast_ControlFlow>(func);
+        loop->flag = AST_CONTROL_WHILE;
+        loop->condition = one;
+        loop->scope.parent = &func->scope;
+
+        for (int j = 0; j < func->scope.size; j++)
+            loop->scope.add(func->scope.statements[j]);
+
+        Ast* tail = func->scope.statements[func->scope.size - 1];
+        if (tail->type == AST_CONDITION && static_cast<Ast_ControlFlow*>(tail)->flag == AST_CONTROL_BLOCK) {
+            Ast_Scope* block = &static_cast<Ast_ControlFlow*>(tail)->scope;
+            tail = block->statements[block->size - 1];
+        }
+
+        if (tail->type != AST_STATEMENT || !(static_cast<Ast_Statement*>(tail)->flags & (AST_RETURN | AST_CONTINUE))) {
+            auto exit = new_node<Ast_Statement>(func);
+            exit->flags = AST_BREAK;
+            loop->scope.add(exit);
+        }
+
+        func->scope.statements[0] = loop;
+        func->scope.size = 1;
+    }
+}
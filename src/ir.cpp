@@ -0,0 +1,363 @@
+#include "../include/ir.h"
+#include "../include/sema.h"
+
+Ir_Value* Ir_Function::new_value(int op, Ast_Type* type) {
+    auto value = new Ir_Value;
+    track_allocation(MEM_BACKEND, sizeof(Ir_Value));
+    count_stat(STAT_IR_VALUES);
+    value->op = op;
+    value->id = value_count++;
+    value->type = type;
+    value->imm = 0;
+
+    values.push(value);
+    return value;
+}
+
+Ir_Block* Ir_Function::new_block() {
+    auto block = new Ir_Block;
+    track_allocation(MEM_BACKEND, sizeof(Ir_Block));
+    block->id = block_count++;
+
+    blocks.push(block);
+    all_blocks.push(block);
+    return block;
+}
+
+int Ir_Function::instruction_count() {
+    int count = 0;
+    for (int i = 0; i < blocks.top(); i++) {
+        Ir_Block* block = blocks.get(i);
+        count += block->phis.top() + block->insts.top() + (block->term != IR_TERM_NONE);
+    }
+    return count;
+}
+
+Ir_Value* resolve(Ir_Value* value) {
+    while (value && value->forward)
+        value = value->forward;
+    return value;
+}
+
+bool ir_is_pure(Ir_Value* value) {
+    switch (value->op) {
+    case IR_LOAD:
+    case IR_STORE:
+    case IR_CALL:
+    case IR_PHI:
+        return false;
+    default: break;
+    }
+    return true;
+}
+
+void ir_add_edge(Ir_Block* from, Ir_Block* to) {
+    to->preds.push(from);
+}
+
+void compact_values(Array<Ir_Value*>* values) {
+    size_t size = 0;
+    for (int i = 0; i < values->top(); i++) {
+        Ir_Value* value = values->get(i);
+        if (value->forward)
+            continue;
+
+        for (int j = 0; j < value->args.top(); j++)
+            value->args.get_arr()[j] = resolve(value->args.get(j));
+        values->get_arr()[size++] = value;
+    }
+
+    while (values->top() > size)
+        values->pop();
+}
+
+void ir_resolve_operands(Ir_Function* func) {
+    for (int i = 0; i < func->blocks.top(); i++) {
+        Ir_Block* block = func->blocks.get(i);
+        compact_values(&block->phis);
+        compact_values(&block->insts);
+        block->term_value = resolve(block->term_value);
+    }
+}
+
+int ir_successor_count(Ir_Block* block) {
+    switch (block->term) {
+    case IR_TERM_JUMP:   return 1;
+    case IR_TERM_BRANCH: return 2;
+    default: break;
+    }
+    return 0;
+}
+
+void ir_remove_pred(Ir_Block* block, int index) {
+    for (int i = index; i + 1 < block->preds.top(); i++)
+        block->preds.get_arr()[i] = block->preds.get(i + 1);
+    block->preds.pop();
+
+    for (int i = 0; i < block->phis.top(); i++) {
+        Ir_Value* phi = block->phis.get(i);
+        for (int j = index; j + 1 < phi->args.top(); j++)
+            phi->args.get_arr()[j] = phi->args.get(j + 1);
+        phi->args.pop();
+    }
+}
+
+void ir_remove_unreachable_blocks(Ir_Function* func) {
+    Array<bool> reachable;
+    for (int i = 0; i < func->block_count; i++)
+        reachable.push(false);
+
+    Array<Ir_Block*> stack;
+    stack.push(func->entry);
+    reachable.get_arr()[func->entry->id] = true;
+
+    while (stack.top() > 0) {
+        Ir_Block* block = stack.get(stack.top() - 1);
+        stack.pop();
+
+        for (int i = 0; i < ir_successor_count(block); i++) {
+            Ir_Block* succ = block->targets[i];
+            if (!reachable.get(succ->id)) {
+                reachable.get_arr()[succ->id] = true;
+                stack.push(succ);
+            }
+        }
+    }
+
+    size_t size = 0;
+    for (int i = 0; i < func->blocks.top(); i++) {
+        Ir_Block* block = func->blocks.get(i);
+        if (!reachable.get(block->id))
+            continue;
+
+        size_t kept = 0;
+        for (int j = 0; j < block->preds.top(); j++) {
+            if (!reachable.get(block->preds.get(j)->id))
+                continue;
+
+            for (int k = 0; k < block->phis.top(); k++) {
+                Ir_Value* phi = block->phis.get(k);
+                phi->args.get_arr()[kept] = phi->args.get(j);
+            }
+            block->preds.get_arr()[kept++] = block->preds.get(j);
+        }
+
+        while (block->preds.top() > kept)
+            block->preds.pop();
+        for (int k = 0; k < block->phis.top(); k++) {
+            Ir_Value* phi = block->phis.get(k);
+            while (phi->args.top() > kept)
+                phi->args.pop();
+        }
+
+        func->blocks.get_arr()[size++] = block;
+    }
+
+    while (func->blocks.top() > size)
+        func->blocks.pop();
+}
+
+Ir_Block* intersect(Ir_Block* a, Ir_Block* b) {
+    while (a != b) {
+        while (a->rpo_index > b->rpo_index)
+            a = a->idom;
+        while (b->rpo_index > a->rpo_index)
+            b = b->idom;
+    }
+    return a;
+}
+
+void ir_compute_dominators(Ir_Function* func) {
+    // Reverse post-order, then the iterative algorithm of Cooper, Harvey and Kennedy.
+    ir_remove_unreachable_blocks(func);
+
+    Array<Ir_Block*> post_order;
+    Array<Ir_Block*> stack;
+    Array<int> next_successor;
+
+    for (int i = 0; i < func->blocks.top(); i++) {
+        func->blocks.get(i)->rpo_index = -1;
+        func->blocks.get(i)->idom = nullptr;
+        func->blocks.get(i)->dom_children.clear();
+    }
+
+    func->entry->rpo_index = 0;
+    stack.push(func->entry);
+    next_successor.push(0);
+
+    while (stack.top() > 0) {
+        Ir_Block* block = stack.get(stack.top() - 1);
+        int next = next_successor.get(next_successor.top() - 1);
+
+        if (next < ir_successor_count(block)) {
+            next_successor.get_arr()[next_successor.top() - 1]++;
+
+            Ir_Block* succ = block->targets[next];
+            if (succ->rpo_index == -1) {
+                succ->rpo_index = 0;
+                stack.push(succ);
+                next_successor.push(0);
+            }
+            continue;
+        }
+
+        post_order.push(block);
+        stack.pop();
+        next_successor.pop();
+    }
+
+    int count = (int) post_order.top();
+    for (int i = 0; i < count; i++) {
+        Ir_Block* block = post_order.get(count - 1 - i);
+        block->rpo_index = i;
+        func->blocks.get_arr()[i] = block;
+    }
+
+    func->entry->idom = func->entry;
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+
+        for (int i = 1; i < count; i++) {
+            Ir_Block* block = func->blocks.get(i);
+            Ir_Block* idom = nullptr;
+
+            for (int j = 0; j < block->preds.top(); j++) {
+                Ir_Block* pred = block->preds.get(j);
+                if (!pred->idom)
+                    continue;
+                idom = (idom) ? intersect(pred, idom) : pred;
+            }
+
+            if (idom != block->idom) {
+                block->idom = idom;
+                changed = true;
+            }
+        }
+    }
+
+    for (int i = 1; i < count; i++) {
+        Ir_Block* block = func->blocks.get(i);
+        block->idom->dom_children.push(block);
+    }
+}
+
+bool ir_dominates(Ir_Block* a, Ir_Block* b) {
+    while (true) {
+        if (a == b)
+            return true;
+        if (b->idom == b)
+            return false;
+        b = b->idom;
+    }
+}
+
+const char* ir_op_name(int op) {
+    switch (op) {
+    case IR_CONST: return "const";
+    case IR_PARAM: return "param";
+    case IR_UNDEF: return "undef";
+    case IR_PHI:   return "phi";
+    case IR_COPY:  return "copy";
+    case IR_CAST:  return "cast";
+    case IR_ADD:   return "add";
+    case IR_SUB:   return "sub";
+    case IR_MUL:   return "mul";
+    case IR_DIV:   return "div";
+    case IR_MOD:   return "mod";
+    case IR_SHL:   return "shl";
+    case IR_EQ:    return "eq";
+    case IR_NE:    return "ne";
+    case IR_LT:    return "lt";
+    case IR_LE:    return "le";
+    case IR_GT:    return "gt";
+    case IR_GE:    return "ge";
+    case IR_LOAD:  return "load";
+    case IR_STORE: return "store";
+    case IR_CALL:  return "call";
+    default: break;
+    }
+    return "?";
+}
+
+void dump_value(FILE* file, Ir_Value* value) {
+    if (value->type && value->type->atom_type != AST_TYPE_VOID)
+        fprintf(file, "    v%d:%s = %s", value->id, type_name(value->type), ir_op_name(value->op));
+    else
+        fprintf(file, "    %s", ir_op_name(value->op));
+
+    if (value->flags & IR_FLAG_WRAP)
+        fprintf(file, ".wrap");
+
+    switch (value->op) {
+    case IR_CONST:
+        if (is_floating_type(value->type))
+            fprintf(file, " %g", value->fimm);
+        else
+            fprintf(file, " %lld", (long long) value->imm);
+        break;
+    case IR_PARAM:
+        fprintf(file, " %lld", (long long) value->imm);
+        break;
+    case IR_LOAD:
+    case IR_STORE:
+    case IR_CALL:
+        fprintf(file, " %s", value->name);
+        break;
+    }
+
+    for (int i = 0; i < value->args.top(); i++)
+        fprintf(file, "%s v%d", (i == 0) ? "" : ",", value->args.get(i)->id);
+
+    if (value->op == IR_PHI) {
+        fprintf(file, " [");
+        for (int i = 0; i < value->block->preds.top(); i++)
+            fprintf(file, "%sb%d", (i == 0) ? "" : " ", value->block->preds.get(i)->id);
+        fprintf(file, "]");
+    }
+
+    fprintf(file, "\n");
+}
+
+void dump_function(FILE* file, Ir_Function* func) {
+    fprintf(file, "function %s (%d instructions)\n", func->def->id->name, func->instruction_count());
+
+    for (int i = 0; i < func->blocks.top(); i++) {
+        Ir_Block* block = func->blocks.get(i);
+        fprintf(file, "  b%d:", block->id);
+        for (int j = 0; j < block->preds.top(); j++)
+            fprintf(file, "%s b%d", (j == 0) ? " preds" : "", block->preds.get(j)->id);
+        fprintf(file, "\n");
+
+        for (int j = 0; j < block->phis.top(); j++)
+            dump_value(file, block->phis.get(j));
+        for (int j = 0; j < block->insts.top(); j++)
+            dump_value(file, block->insts.get(j));
+
+        switch (block->term) {
+        case IR_TERM_JUMP:
+            fprintf(file, "    jump b%d\n", block->targets[0]->id);
+            break;
+        case IR_TERM_BRANCH:
+            fprintf(file, "    branch v%d, b%d, b%d\n", block->term_value->id, block->targets[0]->id, block->targets[1]->id);
+            break;
+        case IR_TERM_RETURN:
+            if (block->term_value)
+                fprintf(file, "    return v%d\n", block->term_value->id);
+            else
+                fprintf(file, "    return\n");
+            break;
+        }
+    }
+}
+
+void free_function(Ir_Function* func) {
+    for (int i = 0; i < func->values.top(); i++)
+        delete func->values.get(i);
+
+    for (int i = 0; i < func->all_blocks.top(); i++)
+        delete func->all_blocks.get(i);
+
+    delete func;
+}
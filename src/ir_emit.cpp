@@ -0,0 +1,278 @@
+#include "../include/ir.h"
+#include "../include/sema.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#define IR_LITERAL_SIZE 64
+
+const char* c_type(Ast_Type* type) {
+    switch (type->atom_type) {
+    case AST_TYPE_INT:    return "i32";
+    case AST_TYPE_BYTE:   return "char";
+    case AST_TYPE_LONG:   return "i64";
+    case AST_TYPE_FLOAT:  return "f32";
+    case AST_TYPE_DOUBLE: return "f64";
+    default: break;
+    }
+    return "void";
+}
+
+const char* c_unsigned_type(Ast_Type* type) {
+    return (type->atom_type == AST_TYPE_LONG) ? "u64" : "u32";
+}
+
+void emit_floating_literal(FILE* file, double value, bool single) {
+    if (value != value) {
+        fprintf(file, "(0.0/0.0)");
+        return;
+    }
+    if (value == 1.0 / 0.0 || value == -1.0 / 0.0) {
+        fprintf(file, "(%s1.0/0.0)", (value < 0) ? "-" : "");
+        return;
+    }
+
+    char buf[IR_LITERAL_SIZE];
+    snprintf(buf, IR_LITERAL_SIZE, (single) ? "%.9g" : "%.17g", value);
+    if (!strchr(buf, '.') && !strchr(buf, 'e'))
+        strcat(buf, ".0");
+
+    fprintf(file, "%s%s", buf, (single) ? "f" : "");
+}
+
+void emit_operand(FILE* file, Ir_Value* value) {
+    switch (value->op) {
+    case IR_CONST:
+        switch (value->type->atom_type) {
+        case AST_TYPE_FLOAT:
+            emit_floating_literal(file, value->fimm, true);
+            break;
+        case AST_TYPE_DOUBLE:
+            emit_floating_literal(file, value->fimm, false);
+            break;
+        case AST_TYPE_BYTE:
+            fprintf(file, "((char)%lld)", (long long) value->imm);
+            break;
+        case AST_TYPE_LONG:
+            if (value->imm == INT64_MIN)
+                fprintf(file, "(-9223372036854775807LL-1)");
+            else
+                fprintf(file, "%lldLL", (long long) value->imm);
+            break;
+        default:
+            if (value->imm == INT32_MIN)
+                fprintf(file, "(-2147483647-1)");
+            else
+                fprintf(file, "%lld", (long long) value->imm);
+            break;
+        }
+        break;
+    case IR_PARAM:
+        fprintf(file, "%s", value->name);
+        break;
+    case IR_UNDEF:
+        fprintf(file, "0");
+        break;
+    default:
+        fprintf(file, "__v%d", value->id);
+        break;
+    }
+}
+
+bool needs_temporary(Ir_Value* value) {
+    if (value->op == IR_CONST || value->op == IR_PARAM || value->op == IR_UNDEF)
+        return false;
+    return (value->type && value->type->atom_type != AST_TYPE_VOID);
+}
+
+const char* c_operator(int op) {
+    switch (op) {
+    case IR_ADD: return "+";
+    case IR_SUB: return "-";
+    case IR_MUL: return "*";
+    case IR_DIV: return "/";
+    case IR_MOD: return "%";
+    case IR_SHL: return "<<";
+    case IR_EQ:  return "==";
+    case IR_NE:  return "!=";
+    case IR_LT:  return "<";
+    case IR_LE:  return "<=";
+    case IR_GT:  return ">";
+    case IR_GE:  return ">=";
+    default: break;
+    }
+    return "?";
+}
+
+void emit_instruction(FILE* file, Ir_Value* value) {
+    switch (value->op) {
+    case IR_CONST:
+    case IR_PARAM:
+    case IR_UNDEF:
+        return;
+    case IR_STORE:
+        fprintf(file, "%s = ", value->name);
+        emit_operand(file, value->args.get(0));
+        fprintf(file, ";\n");
+        return;
+    case IR_CALL:
+        if (needs_temporary(value))
+            fprintf(file, "__v%d = ", value->id);
+        fprintf(file, "%s(", value->name);
+        for (int i = 0; i < value->args.top(); i++) {
+            if (i > 0)
+                fprintf(file, ", ");
+            emit_operand(file, value->args.get(i));
+        }
+        fprintf(file, ");\n");
+        return;
+    default: break;
+    }
+
+    fprintf(file, "__v%d = ", value->id);
+
+    switch (value->op) {
+    case IR_LOAD:
+        fprintf(file, "%s", value->name);
+        break;
+    case IR_COPY:
+        emit_operand(file, value->args.get(0));
+        break;
+    case IR_CAST:
+        fprintf(file, "(%s)", c_type(value->type));
+        emit_operand(file, value->args.get(0));
+        break;
+    default:
+        if (value->flags & IR_FLAG_WRAP) {
+            // Wrapping arithmetic goes through the unsigned type, where overflow is defined.
+            const char* unsigned_type = c_unsigned_type(value->type);
+            fprintf(file, "(%s)((%s)", c_type(value->type), unsigned_type);
+            emit_operand(file, value->args.get(0));
+            if (value->op == IR_SHL)
+                fprintf(file, " << ");
+            else
+                fprintf(file, " %s (%s)", c_operator(value->op), unsigned_type);
+            emit_operand(file, value->args.get(1));
+            fprintf(file, ")");
+        }
+        else {
+            emit_operand(file, value->args.get(0));
+            fprintf(file, " %s ", c_operator(value->op));
+            emit_operand(file, value->args.get(1));
+        }
+        break;
+    }
+
+    fprintf(file, ";\n");
+}
+
+void split_critical_edges(Ir_Function* func) {
+    int count = (int) func->blocks.top();
+
+    for (int i = 0; i < count; i++) {
+        Ir_Block* block = func->blocks.get(i);
+        if (block->term != IR_TERM_BRANCH)
+            continue;
+
+        for (int t = 0; t < 2; t++) {
+            Ir_Block* succ = block->targets[t];
+            if (succ->preds.top() < 2 || succ->phis.top() == 0)
+                continue;
+
+            Ir_Block* edge = func->new_block();
+            edge->term = IR_TERM_JUMP;
+            edge->targets[0] = succ;
+            edge->preds.push(block);
+
+            for (int j = 0; j < succ->preds.top(); j++) {
+                if (succ->preds.get(j) == block) {
+                    succ->preds.get_arr()[j] = edge;
+                    break;
+                }
+            }
+            block->targets[t] = edge;
+        }
+    }
+}
+
+void emit_phi_copies(FILE* file, Ir_Block* from, Ir_Block* to) {
+    if (to->phis.top() == 0)
+        return;
+
+    int index = -1;
+    for (int i = 0; i < to->preds.top(); i++) {
+        if (to->preds.get(i) == from) {
+            index = i;
+            break;
+        }
+    }
+    if (index == -1)
+        return;
+
+    if (to->phis.top() == 1) {
+        Ir_Value* phi = to->phis.get(0);
+        fprintf(file, "__v%d = ", phi->id);
+        emit_operand(file, phi->args.get(index));
+        fprintf(file, ";\n");
+        return;
+    }
+
+    // Phis read their operands in parallel, so every operand is captured before any phi is written.
+    fprintf(file, "{\n");
+    for (int i = 0; i < to->phis.top(); i++) {
+        Ir_Value* phi = to->phis.get(i);
+        fprintf(file, "%s __p%d = ", c_type(phi->type), i);
+        emit_operand(file, phi->args.get(index));
+        fprintf(file, ";\n");
+    }
+    for (int i = 0; i < to->phis.top(); i++)
+        fprintf(file, "__v%d = __p%d;\n", to->phis.get(i)->id, i);
+    fprintf(file, "}\n");
+}
+
+void emit_function_body(FILE* file, Ir_Function* func) {
+    split_critical_edges(func);
+    ir_compute_dominators(func);
+
+    for (int i = 0; i < func->blocks.top(); i++) {
+        Ir_Block* block = func->blocks.get(i);
+        for (int j = 0; j < block->phis.top(); j++)
+            fprintf(file, "%s __v%d;\n", c_type(block->phis.get(j)->type), block->phis.get(j)->id);
+        for (int j = 0; j < block->insts.top(); j++) {
+            Ir_Value* inst = block->insts.get(j);
+            if (needs_temporary(inst))
+                fprintf(file, "%s __v%d;\n", c_type(inst->type), inst->id);
+        }
+    }
+
+    for (int i = 0; i < func->blocks.top(); i++) {
+        Ir_Block* block = func->blocks.get(i);
+        fprintf(file, "__b%d:;\n", block->id);
+
+        for (int j = 0; j < block->insts.top(); j++)
+            emit_instruction(file, block->insts.get(j));
+
+        for (int j = 0; j < ir_successor_count(block); j++)
+            emit_phi_copies(file, block, block->targets[j]);
+
+        switch (block->term) {
+        case IR_TERM_JUMP:
+            fprintf(file, "goto __b%d;\n", block->targets[0]->id);
+            break;
+        case IR_TERM_BRANCH:
+            fprintf(file, "if (");
+            emit_operand(file, block->term_value);
+            fprintf(file, ") goto __b%d; else goto __b%d;\n", block->targets[0]->id, block->targets[1]->id);
+            break;
+        case IR_TERM_RETURN:
+            if (block->term_value) {
+                fprintf(file, "return ");
+                emit_operand(file, block->term_value);
+                fprintf(file, ";\n");
+            }
+            else
+                fprintf(file, "return;\n");
+            break;
+        }
+    }
+}
@@ -0,0 +1,600 @@
+#include "../include/ir.h"
+#include "../include/sema.h"
+
+struct Ir_Builder {
+    Ir_Function* func;
+    Ir_Block* current;
+    Array<Ast_Decleration*> vars;
+    Array<Ir_Block*> break_targets;
+    Array<Ir_Block*> continue_targets;
+    Array<Ast_Binary_Expression*> chain;
+    bool failed = false;
+
+    int find_slot(Ast_Decleration* dec);
+    int new_slot(Ast_Decleration* dec);
+    Ast_Type* slot_type(int slot);
+
+    void open_block();
+    Ir_Value* emit(int op, Ast_Type* type);
+    Ir_Value* constant(Ast_Type* type, int64_t imm);
+    Ir_Value* convert(Ir_Value* value, Ast_Type* type);
+
+    void write_variable(int slot, Ir_Block* block, Ir_Value* value);
+    Ir_Value* read_variable(int slot, Ir_Block* block);
+    Ir_Value* read_variable_recursive(int slot, Ir_Block* block);
+    Ir_Value* add_phi_operands(int slot, Ir_Value* phi);
+    Ir_Value* try_remove_trivial_phi(Ir_Value* phi);
+    void seal_block(Ir_Block* block);
+
+    void jump(Ir_Block* target);
+    void branch(Ir_Value* condition, Ir_Block* on_true, Ir_Block* on_false);
+
+    Ir_Value* load(Ast_Ident* ident);
+    void store(Ast_Ident* ident, Ir_Value* value);
+    Ir_Value* increment(Ast_Expression* target, int op, bool prefix);
+
+    Ir_Value* lower_expression(Ast_Expression* expr);
+    Ir_Value* lower_binary_expression(Ast_Binary_Expression* bin);
+    Ir_Value* lower_binary_operator(Ast_Binary_Expression* bin, Ir_Value* left, Ir_Value* right);
+    Ir_Value* lower_unary_expression(Ast_Unary_Expression* unary);
+    Ir_Value* lower_primary_expression(Ast_Primary_Expression* prime);
+    Ir_Value* lower_function_call(Ast_Function_Call* call);
+    Ir_Value* lower_assignment_chain(Ast_Expression* expr);
+    void lower_control_flow(Ast_ControlFlow* condition);
+    void lower_statement(Ast* ast);
+    void lower_scope(Ast_Scope* scope);
+};
+
+Ast_Type* value_type(Ast_Type* type) {
+    return (type) ? canonical_type(type->atom_type) : nullptr;
+}
+
+int Ir_Builder::find_slot(Ast_Decleration* dec) {
+    for (int i = (int) vars.top() - 1; i >= 0; i--) {
+        if (vars.get(i) == dec)
+            return i;
+    }
+    return -1;
+}
+
+int Ir_Builder::new_slot(Ast_Decleration* dec) {
+    // Arrays and slices live in memory, which the IR does not model yet.
+    if (!dec->type_info || is_composite_type(dec->type_info))
+        failed = true;
+    vars.push(dec);
+    return (int) vars.top() - 1;
+}
+
+Ast_Type* Ir_Builder::slot_type(int slot) {
+    return value_type(vars.get(slot)->type_info);
+}
+
+void Ir_Builder::open_block() {
+    // Code after a return is unreachable; it is still lowered so that the builder stays simple.
+    if (current->term != IR_TERM_NONE) {
+        current = func->new_block();
+        current->sealed = true;
+    }
+}
+
+Ir_Value* Ir_Builder::emit(int op, Ast_Type* type) {
+    open_block();
+
+    Ir_Value* value = func->new_value(op, type);
+    value->block = current;
+    current->insts.push(value);
+    return value;
+}
+
+Ir_Value* Ir_Builder::constant(Ast_Type* type, int64_t imm) {
+    Ir_Value* value = emit(IR_CONST, type);
+    if (is_floating_type(type))
+        value->fimm = (double) imm;
+    else
+        value->imm = imm;
+    return value;
+}
+
+Ir_Value* Ir_Builder::convert(Ir_Value* value, Ast_Type* type) {
+    if (!type || !value || value->type == type)
+        return value;
+
+    Ir_Value* cast = emit(IR_CAST, type);
+    cast->args.push(value);
+    return cast;
+}
+
+void Ir_Builder::write_variable(int slot, Ir_Block* block, Ir_Value* value) {
+    while (block->defs.top() <= slot)
+        block->defs.push(nullptr);
+    block->defs.get_arr()[slot] = value;
+}
+
+Ir_Value* Ir_Builder::read_variable(int slot, Ir_Block* block) {
+    if (slot < block->defs.top() && block->defs.get(slot))
+        return resolve(block->defs.get(slot));
+    return read_variable_recursive(slot, block);
+}
+
+Ir_Value* Ir_Builder::read_variable_recursive(int slot, Ir_Block* block) {
+    // Braun et al., "Simple and Efficient Construction of Static Single Assignment Form".
+    Ir_Value* value = nullptr;
+
+    if (!block->sealed) {
+        value = func->new_value(IR_PHI, slot_type(slot));
+        value->block = block;
+        value->slot = slot;
+        block->phis.push(value);
+        block->incomplete_phis.push(value);
+    }
+    else if (block->preds.top() == 1) {
+        value = read_variable(slot, block->preds.get(0));
+    }
+    else if (block->preds.top() == 0) {
+        value = func->new_value(IR_UNDEF, slot_type(slot));
+        value->block = block;
+        block->insts.push(value);
+    }
+    else {
+        value = func->new_value(IR_PHI, slot_type(slot));
+        value->block = block;
+        value->slot = slot;
+        block->phis.push(value);
+
+        write_variable(slot, block, value);
+        value = add_phi_operands(slot, value);
+    }
+
+    write_variable(slot, block, value);
+    return value;
+}
+
+Ir_Value* Ir_Builder::add_phi_operands(int slot, Ir_Value* phi) {
+    for (int i = 0; i < phi->block->preds.top(); i++)
+        phi->args.push(read_variable(slot, phi->block->preds.get(i)));
+    return try_remove_trivial_phi(phi);
+}
+
+Ir_Value* Ir_Builder::try_remove_trivial_phi(Ir_Value* phi) {
+    Ir_Value* same = nullptr;
+
+    for (int i = 0; i < phi->args.top(); i++) {
+        Ir_Value* op = resolve(phi->args.get(i));
+        if (op == same || op == phi)
+            continue;
+        if (same)
+            return phi;
+        same = op;
+    }
+
+    if (!same) {
+        same = func->new_value(IR_UNDEF, phi->type);
+        same->block = func->entry;
+        func->entry->insts.push(same);
+    }
+
+    // Users of the phi see the replacement through resolve(); phis that become trivial as a
+    // consequence are cleaned up by copy propagation.
+    phi->forward = same;
+    return same;
+}
+
+void Ir_Builder::seal_block(Ir_Block* block) {
+    for (int i = 0; i < block->incomplete_phis.top(); i++) {
+        Ir_Value* phi = block->incomplete_phis.get(i);
+        add_phi_operands(phi->slot, phi);
+    }
+
+    block->sealed = true;
+}
+
+void Ir_Builder::jump(Ir_Block* target) {
+    if (current->term != IR_TERM_NONE)
+        return;
+
+    current->term = IR_TERM_JUMP;
+    current->targets[0] = target;
+    ir_add_edge(current, target);
+}
+
+void Ir_Builder::branch(Ir_Value* condition, Ir_Block* on_true, Ir_Block* on_false) {
+    if (current->term != IR_TERM_NONE)
+        return;
+
+    current->term = IR_TERM_BRANCH;
+    current->term_value = condition;
+    current->targets[0] = on_true;
+    current->targets[1] = on_false;
+    ir_add_edge(current, on_true);
+    ir_add_edge(current, on_false);
+}
+
+Ir_Value* Ir_Builder::load(Ast_Ident* ident) {
+    if (!ident->decleration) {
+        failed = true;
+        return nullptr;
+    }
+
+    int slot = find_slot(ident->decleration);
+    if (slot != -1) {
+        open_block();
+        return read_variable(slot, current);
+    }
+
+    Ir_Value* value = emit(IR_LOAD, value_type(ident->decleration->type_info));
+    value->name = ident->name;
+    return value;
+}
+
+void Ir_Builder::store(Ast_Ident* ident, Ir_Value* value) {
+    if (!ident->decleration || !value) {
+        failed = true;
+        return;
+    }
+
+    int slot = find_slot(ident->decleration);
+    if (slot != -1) {
+        open_block();
+        write_variable(slot, current, convert(value, slot_type(slot)));
+        return;
+    }
+
+    Ir_Value* converted = convert(value, value_type(ident->decleration->type_info));
+    Ir_Value* st = emit(IR_STORE, canonical_type(AST_TYPE_VOID));
+    st->name = ident->name;
+    st->args.push(converted);
+}
+
+Ast_Ident* assigned_identifier(Ast_Expression* target) {
+    while (target->type == AST_UNARY_EXPESSION && static_cast<Ast_Unary_Expression*>(target)->op == AST_UNARY_NESTED)
+        target = static_cast<Ast_Unary_Expression*>(target)->nested_expr;
+
+    if (target->type != AST_PRIMARY_EXPRESSION)
+        return nullptr;
+
+    auto prime = static_cast<Ast_Primary_Expression*>(target);
+    return (prime->v_type == AST_ID_P) ? prime->ident : nullptr;
+}
+
+Ir_Value* Ir_Builder::increment(Ast_Expression* target, int op, bool prefix) {
+    Ast_Ident* ident = assigned_identifier(target);
+    if (!ident) {
+        failed = true;
+        return nullptr;
+    }
+
+    Ir_Value* old = load(ident);
+    if (!old)
+        return nullptr;
+
+    Ast_Type* type = (old->type->atom_type == AST_TYPE_BYTE) ? canonical_type(AST_TYPE_INT) : old->type;
+    Ir_Value* sum = emit((op == AST_UNARY_INC) ? IR_ADD : IR_SUB, type);
+    sum->args.push(convert(old, type));
+    sum->args.push(constant(type, 1));
+
+    Ir_Value* updated = convert(sum, old->type);
+    store(ident, updated);
+
+    return (prefix) ? updated : old;
+}
+
+int ir_binary_op(int op) {
+    switch (op) {
+    case AST_OPERATOR_PLUS:                     return IR_ADD;
+    case AST_OPERATOR_MINUS:                    return IR_SUB;
+    case AST_OPERATOR_MULTIPLICATIVE:           return IR_MUL;
+    case AST_OPERATOR_DIVISION:                 return IR_DIV;
+    case AST_OPERATOR_MODULO:                   return IR_MOD;
+    case AST_OPERATOR_COMPARITIVE_EQUAL:        return IR_EQ;
+    case AST_OPERATOR_COMPARITIVE_NOT_EQUAL:    return IR_NE;
+    case AST_OPERATOR_LTE:                      return IR_LE;
+    case AST_OPERATOR_GTE:                      return IR_GE;
+    case AST_OPERATOR_LT:                       return IR_LT;
+    case AST_OPERATOR_GT:                       return IR_GT;
+    default: break;
+    }
+    return -1;
+}
+
+// A chain is lowered from its first operand up, in the order C evaluates it.
+Ir_Value* Ir_Builder::lower_binary_expression(Ast_Binary_Expression* bin) {
+    size_t base = chain.top();
+    push_chain(bin, &chain);
+
+    Ir_Value* left = lower_expression(chain.get(chain.top() - 1)->left);
+    while (chain.top() > base) {
+        Ast_Binary_Expression* link = chain.get(chain.top() - 1);
+        chain.pop();
+
+        Ir_Value* right = lower_expression(link->right);
+        left = lower_binary_operator(link, left, right);
+    }
+    return left;
+}
+
+Ir_Value* Ir_Builder::lower_binary_operator(Ast_Binary_Expression* bin, Ir_Value* left, Ir_Value* right) {
+    int op = ir_binary_op(bin->op);
+
+    if (!left || !right || op == -1 || !bin->type_info || is_composite_type(bin->type_info)) {
+        failed = true;
+        return nullptr;
+    }
+
+    Ir_Value* value = emit(op, bin->type_info);
+    value->args.push(left);
+    value->args.push(right);
+    return value;
+}
+
+Ir_Value* Ir_Builder::lower_unary_expression(Ast_Unary_Expression* unary) {
+    switch (unary->op) {
+    case AST_UNARY_NESTED:
+        return lower_expression(unary->nested_expr);
+    case AST_UNARY_INC:
+    case AST_UNARY_DEC:
+        return increment(unary->expr, unary->op, true);
+    default:
+        // Address-taken or dereferenced values need memory, which the IR does not model.
+        failed = true;
+        return nullptr;
+    }
+}
+
+Ir_Value* Ir_Builder::lower_primary_expression(Ast_Primary_Expression* prime) {
+    switch (prime->v_type) {
+    case AST_INT_P:
+    case AST_CHAR_P: {
+        int64_t imm = (prime->v_type == AST_CHAR_P) ? (int64_t) prime->char_const : prime->int_const;
+        Ir_Value* value = emit(IR_CONST, prime->type_info);
+        value->imm = imm;
+        return value;
+    }
+    case AST_FLOAT_P: {
+        Ir_Value* value = emit(IR_CONST, prime->type_info);
+        value->fimm = prime->float_const;
+        return value;
+    }
+    case AST_ID_P:
+        if (prime->expr)
+            return increment(prime, static_cast<Ast_Postfix_Expression*>(prime->expr)->op, false);
+        return load(prime->ident);
+    case AST_CALL_P:
+        return lower_function_call(prime->call);
+    default:
+        failed = true;
+        return nullptr;
+    }
+}
+
+Ir_Value* Ir_Builder::lower_expression(Ast_Expression* expr) {
+    if (!expr || !expr->type_info || is_composite_type(expr->type_info)) {
+        failed = true;
+        return nullptr;
+    }
+
+    switch (expr->type) {
+    case AST_BINARY_EXPRESSION:
+        return lower_binary_expression(static_cast<Ast_Binary_Expression*>(expr));
+    case AST_UNARY_EXPESSION:
+        return lower_unary_expression(static_cast<Ast_Unary_Expression*>(expr));
+    case AST_PRIMARY_EXPRESSION:
+        return lower_primary_expression(static_cast<Ast_Primary_Expression*>(expr));
+    default:
+        failed = true;
+        return nullptr;
+    }
+}
+
+Ir_Value* Ir_Builder::lower_function_call(Ast_Function_Call* call) {
+    auto callee = static_cast<Ast_Function_Definition*>(call->id->decleration);
+    if (!callee) {
+        failed = true;
+        return nullptr;
+    }
+
+    Array<Ir_Value*> args;
+    for (int i = 0; i < call->arg_count; i++) {
+        Ir_Value* arg = lower_expression(call->args[i]);
+        if (!arg)
+            return nullptr;
+        args.push(convert(arg, (i < callee->arg_count) ? value_type(callee->args[i]->type_info) : nullptr));
+    }
+
+    Ast_Type* type = (callee->type_info) ? value_type(callee->type_info) : canonical_type(AST_TYPE_VOID);
+    Ir_Value* value = emit(IR_CALL, type);
+    value->name = call->id->name;
+    for (int i = 0; i < args.top(); i++)
+        value->args.push(args.get(i));
+
+    return value;
+}
+
+Ir_Value* Ir_Builder::lower_assignment_chain(Ast_Expression* expr) {
+    Array<Ast_Expression*> links;
+    for (Ast_Expression* link = expr; link; link = link->next)
+        links.push(link);
+
+    if (links.top() == 0)
+        return nullptr;
+
+    Ir_Value* value = lower_expression(links.get(links.top() - 1));
+
+    for (int i = (int) links.top() - 2; i >= 0 && value; i--) {
+        Ast_Ident* ident = assigned_identifier(links.get(i));
+        if (!ident) {
+            failed = true;
+            return nullptr;
+        }
+
+        value = convert(value, value_type(ident->decleration ? ident->decleration->type_info : nullptr));
+        store(ident, value);
+    }
+
+    return value;
+}
+
+void Ir_Builder::lower_control_flow(Ast_ControlFlow* condition) {
+    if (condition->flag == AST_CONTROL_WHILE) {
+        Ir_Block* header = func->new_block();
+        jump(header);
+        current = header;
+
+        Ir_Value* test = lower_expression(condition->condition);
+        Ir_Block* body = func->new_block();
+        Ir_Block* exit = func->new_block();
+        branch(test, body, exit);
+        seal_block(body);
+
+        current = body;
+        break_targets.push(exit);
+        continue_targets.push(header);
+        lower_scope(&condition->scope);
+        jump(header);
+        break_targets.pop();
+        continue_targets.pop();
+
+        seal_block(header);
+        seal_block(exit);
+        current = exit;
+        return;
+    }
+
+    Ir_Block* join = func->new_block();
+    bool exhaustive = false;
+
+    for (Ast_ControlFlow* arm = condition; arm; arm = arm->next) {
+        if (arm->flag == AST_CONTROL_ELSE || arm->flag == AST_CONTROL_BLOCK) {
+            lower_scope(&arm->scope);
+            jump(join);
+            exhaustive = true;
+            break;
+        }
+
+        Ir_Value* test = lower_expression(arm->condition);
+        Ir_Block* then = func->new_block();
+        Ir_Block* otherwise = func->new_block();
+        branch(test, then, otherwise);
+        seal_block(then);
+        seal_block(otherwise);
+
+        current = then;
+        lower_scope(&arm->scope);
+        jump(join);
+
+        current = otherwise;
+    }
+
+    if (!exhaustive)
+        jump(join);
+
+    seal_block(join);
+    current = join;
+}
+
+void Ir_Builder::lower_statement(Ast* ast) {
+    if (failed)
+        return;
+
+    switch (ast->type) {
+    case AST_STATEMENT: {
+        auto stmt = static_cast<Ast_Statement*>(ast);
+        if (stmt->flags == AST_BREAK || stmt->flags == AST_CONTINUE) {
+            Array<Ir_Block*>* targets = (stmt->flags == AST_BREAK) ? &break_targets : &continue_targets;
+            if (targets->top() == 0) {
+                failed = true;
+                return;
+            }
+
+            open_block();
+            jump(targets->get(targets->top() - 1));
+            break;
+        }
+        else if (stmt->flags != AST_RETURN) {
+            failed = true;
+            return;
+        }
+
+        Ir_Value* value = nullptr;
+        if (stmt->expr) {
+            value = lower_expression(stmt->expr);
+            value = convert(value, func->return_type);
+        }
+
+        open_block();
+        current->term = IR_TERM_RETURN;
+        current->term_value = value;
+        break;
+    }
+    case AST_CONDITION:
+        lower_control_flow(static_cast<Ast_ControlFlow*>(ast));
+        break;
+    case AST_DECLERATION: {
+        auto dec = static_cast<Ast_Decleration*>(ast);
+        Ir_Value* value = (dec->expr) ? lower_assignment_chain(dec->expr) : nullptr;
+
+        int slot = new_slot(dec);
+        if (value) {
+            open_block();
+            write_variable(slot, current, convert(value, slot_type(slot)));
+        }
+        break;
+    }
+    case AST_ASSIGNMENT:
+        lower_assignment_chain(static_cast<Ast_Decleration*>(ast)->expr);
+        break;
+    case AST_FUNCTION_CALL:
+        lower_function_call(static_cast<Ast_Function_Call*>(ast));
+        break;
+    default:
+        failed = true;
+        break;
+    }
+}
+
+void Ir_Builder::lower_scope(Ast_Scope* scope) {
+    for (int i = 0; i < scope->size && !failed; i++)
+        lower_statement(scope->statements[i]);
+}
+
+Ir_Function* lower_function(Ast_Function_Definition* def) {
+    if (def->from)
+        return nullptr;
+
+    Ir_Builder builder;
+    Ir_Function* func = new Ir_Function;
+    track_allocation(MEM_BACKEND, sizeof(Ir_Function));
+    func->def = def;
+    func->return_type = value_type(def->type_info);
+
+    func->entry = func->new_block();
+    func->entry->sealed = true;
+
+    builder.func = func;
+    builder.current = func->entry;
+
+    for (int i = 0; i < def->arg_count; i++) {
+        int slot = builder.new_slot(def->args[i]);
+        Ir_Value* param = builder.emit(IR_PARAM, builder.slot_type(slot));
+        param->imm = i;
+        param->name = def->args[i]->id->name;
+        builder.write_variable(slot, builder.current, param);
+    }
+
+    builder.lower_scope(&def->scope);
+
+    if (builder.failed) {
+        free_function(func);
+        return nullptr;
+    }
+
+    if (builder.current->term == IR_TERM_NONE) {
+        builder.current->term = IR_TERM_RETURN;
+        if (func->return_type)
+            builder.current->term_value = builder.emit(IR_UNDEF, func->return_type);
+    }
+
+    ir_remove_unreachable_blocks(func);
+    ir_resolve_operands(func);
+
+    return func;
+}
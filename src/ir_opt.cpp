@@ -0,0 +1,742 @@
+#include "../include/ir.h"
+#include "../include/sema.h"
+#include "../include/options.h"
+#include "../include/timer.h"
+
+#include <stdint.h>
+
+struct Ir_Loop {
+    Ir_Block* header;
+    Ir_Block* preheader;
+    Ir_Block* latch;
+    Array<bool> member;
+    bool has_side_effects = false;
+};
+
+struct Ir_Pass {
+    const char* name;
+    void (*run)(Ir_Function* func);
+    uint64_t elapsed;
+    long removed;
+};
+
+void remove_from_block(Array<Ir_Value*>* values, Ir_Value* value) {
+    size_t size = 0;
+    for (int i = 0; i < values->top(); i++) {
+        if (values->get(i) != value)
+            values->get_arr()[size++] = values->get(i);
+    }
+    while (values->top() > size)
+        values->pop();
+}
+
+// Compacts the live values to the front in one pass.
+void remove_dead(Array<Ir_Value*>* values) {
+    size_t size = 0;
+    for (int i = 0; i < values->top(); i++) {
+        if (values->get(i)->live)
+            values->get_arr()[size++] = values->get(i);
+    }
+    while (values->top() > size)
+        values->pop();
+}
+
+Ir_Value* insert_value(Ir_Function* func, Ir_Block* block, int op, Ast_Type* type) {
+    Ir_Value* value = func->new_value(op, type);
+    value->block = block;
+    block->insts.push(value);
+    return value;
+}
+
+bool is_constant(Ir_Value* value) {
+    return (value->op == IR_CONST);
+}
+
+bool is_integral_constant(Ir_Value* value, int64_t imm) {
+    return (value->op == IR_CONST && is_integral_type(value->type) && value->imm == imm);
+}
+
+double constant_as_double(Ir_Value* value) {
+    return (is_floating_type(value->type)) ? value->fimm : (double) value->imm;
+}
+
+bool fits_type(int64_t value, Ast_Type* type) {
+    switch (type->atom_type) {
+    case AST_TYPE_BYTE: return (value >= INT8_MIN && value <= INT8_MAX);
+    case AST_TYPE_INT:  return (value >= INT32_MIN && value <= INT32_MAX);
+    case AST_TYPE_LONG: return true;
+    default: break;
+    }
+    return false;
+}
+
+void copy_propagation(Ir_Function* func) {
+    bool changed = true;
+
+    while (changed) {
+        changed = false;
+
+        for (int i = 0; i < func->blocks.top(); i++) {
+            Ir_Block* block = func->blocks.get(i);
+
+            for (int j = 0; j < block->phis.top(); j++) {
+                Ir_Value* phi = block->phis.get(j);
+                if (phi->forward)
+                    continue;
+
+                Ir_Value* same = nullptr;
+                bool trivial = true;
+                for (int k = 0; k < phi->args.top(); k++) {
+                    Ir_Value* op = resolve(phi->args.get(k));
+                    if (op == phi || op == same)
+                        continue;
+                    if (same) {
+                        trivial = false;
+                        break;
+                    }
+                    same = op;
+                }
+
+                if (trivial && same) {
+                    phi->forward = same;
+                    changed = true;
+                }
+            }
+
+            for (int j = 0; j < block->insts.top(); j++) {
+                Ir_Value* inst = block->insts.get(j);
+                if (inst->forward)
+                    continue;
+
+                bool is_copy = (inst->op == IR_COPY);
+                if (inst->op == IR_CAST && resolve(inst->args.get(0))->type == inst->type)
+                    is_copy = true;
+
+                if (is_copy) {
+                    inst->forward = resolve(inst->args.get(0));
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    ir_resolve_operands(func);
+}
+
+bool is_commutative(int op) {
+    return (op == IR_ADD || op == IR_MUL || op == IR_EQ || op == IR_NE);
+}
+
+bool same_expression(Ir_Value* a, Ir_Value* b) {
+    if (a->op != b->op || a->type != b->type || a->flags != b->flags || a->args.top() != b->args.top())
+        return false;
+
+    if (a->op == IR_CONST)
+        return (memcmp(&a->imm, &b->imm, sizeof(a->imm)) == 0);
+    if (a->op == IR_PARAM)
+        return (a->imm == b->imm);
+
+    bool in_order = true;
+    for (int i = 0; i < a->args.top(); i++) {
+        if (resolve(a->args.get(i)) != resolve(b->args.get(i))) {
+            in_order = false;
+            break;
+        }
+    }
+    if (in_order)
+        return true;
+
+    if (is_commutative(a->op))
+        return (resolve(a->args.get(0)) == resolve(b->args.get(1)) && resolve(a->args.get(1)) == resolve(b->args.get(0)));
+    return false;
+}
+
+// Agrees with same_expression: equal expressions always hash alike, whatever order commutative operands are in.
+uint64_t expression_hash(Ir_Value* value) {
+    uint64_t h = (uint64_t) value->op | ((uint64_t) value->flags << 8) | ((uint64_t) value->args.top() << 16);
+    h = (h ^ (uint64_t) (uintptr_t) value->type) * 0x9E3779B97F4A7C15ULL;
+
+    if (value->op == IR_CONST || value->op == IR_PARAM) {
+        uint64_t bits;
+        memcpy(&bits, &value->imm, sizeof(bits));
+        return (h ^ bits) * 0x9E3779B97F4A7C15ULL;
+    }
+
+    uint64_t operands = 0;
+    for (int i = 0; i < value->args.top(); i++) {
+        uint64_t arg = (uint64_t) (uintptr_t) resolve(value->args.get(i)) * 0x9E3779B97F4A7C15ULL;
+        operands = (is_commutative(value->op)) ? operands + arg : (operands ^ arg) * 0x100000001B3ULL;
+    }
+    return (h ^ operands) * 0x9E3779B97F4A7C15ULL;
+}
+
+// Open addressed expressions available at the current block. Every insertion is logged, and a block takes its own
+// back out in reverse order on the way up the dominator tree, which keeps the probe chains of older entries whole.
+struct Value_Table {
+    Ir_Value** slots = nullptr;
+    uint32_t mask = 0;
+    Array<uint32_t> undo;
+};
+
+void value_numbering(Ir_Block* block, Value_Table* table) {
+    size_t marker = table->undo.top();
+
+    for (int i = 0; i < block->insts.top(); i++) {
+        Ir_Value* inst = block->insts.get(i);
+        if (inst->forward || !ir_is_pure(inst) || inst->op == IR_UNDEF)
+            continue;
+
+        uint32_t slot = (uint32_t) (expression_hash(inst) >> 32) & table->mask;
+        for (; table->slots[slot]; slot = (slot + 1) & table->mask) {
+            if (same_expression(table->slots[slot], inst))
+                break;
+        }
+
+        if (table->slots[slot])
+            inst->forward = table->slots[slot];
+        else {
+            table->slots[slot] = inst;
+            table->undo.push(slot);
+        }
+    }
+
+    for (int i = 0; i < block->dom_children.top(); i++)
+        value_numbering(block->dom_children.get(i), table);
+
+    while (table->undo.top() > marker) {
+        table->slots[table->undo.get(table->undo.top() - 1)] = nullptr;
+        table->undo.pop();
+    }
+}
+
+void common_subexpression_elimination(Ir_Function* func) {
+    ir_compute_dominators(func);
+
+    // No more expressions are ever available than there are instructions, so the table never grows.
+    uint32_t count = 16;
+    while (count < (uint32_t) func->instruction_count() * 2)
+        count <<= 1;
+
+    Value_Table table;
+    table.slots = (Ir_Value**) calloc(count, sizeof(Ir_Value*));
+    table.mask = count - 1;
+    value_numbering(func->entry, &table);
+    free(table.slots);
+
+    ir_resolve_operands(func);
+}
+
+bool fold_constant(Ir_Value* inst) {
+    for (int i = 0; i < inst->args.top(); i++) {
+        if (!is_constant(inst->args.get(i)))
+            return false;
+    }
+
+    if (inst->op == IR_CAST) {
+        Ir_Value* from = inst->args.get(0);
+
+        if (is_floating_type(inst->type)) {
+            double value = constant_as_double(from);
+            inst->fimm = (inst->type->atom_type == AST_TYPE_FLOAT) ? (double) (float) value : value;
+        }
+        else if (is_integral_type(inst->type)) {
+            int64_t value;
+            if (is_floating_type(from->type)) {
+                if (!(from->fimm > (double) INT64_MIN && from->fimm < (double) INT64_MAX))
+                    return false;
+                value = (int64_t) from->fimm;
+                if (!fits_type(value, inst->type))
+                    return false;
+            }
+            else
+                value = from->imm;
+
+            switch (inst->type->atom_type) {
+            case AST_TYPE_BYTE: inst->imm = (int8_t) value;  break;
+            case AST_TYPE_INT:  inst->imm = (int32_t) value; break;
+            default:            inst->imm = value;           break;
+            }
+        }
+        else
+            return false;
+
+        inst->op = IR_CONST;
+        inst->args.clear();
+        return true;
+    }
+
+    if (inst->args.top() != 2)
+        return false;
+
+    Ir_Value* left = inst->args.get(0);
+    Ir_Value* right = inst->args.get(1);
+    bool floating = is_floating_type(left->type) || is_floating_type(right->type);
+
+    if (floating) {
+        double a = constant_as_double(left), b = constant_as_double(right), result;
+        switch (inst->op) {
+        case IR_ADD: result = a + b; break;
+        case IR_SUB: result = a - b; break;
+        case IR_MUL: result = a * b; break;
+        case IR_EQ:  result = a == b; break;
+        case IR_NE:  result = a != b; break;
+        case IR_LT:  result = a < b; break;
+        case IR_LE:  result = a <= b; break;
+        case IR_GT:  result = a > b; break;
+        case IR_GE:  result = a >= b; break;
+        default: return false;
+        }
+
+        if (is_floating_type(inst->type))
+            inst->fimm = (inst->type->atom_type == AST_TYPE_FLOAT) ? (double) (float) result : result;
+        else
+            inst->imm = (int64_t) result;
+    }
+    else {
+        int64_t a = left->imm, b = right->imm, result;
+        switch (inst->op) {
+        case IR_ADD:
+            if (__builtin_add_overflow(a, b, &result))
+                return false;
+            break;
+        case IR_SUB:
+            if (__builtin_sub_overflow(a, b, &result))
+                return false;
+            break;
+        case IR_MUL:
+            if (__builtin_mul_overflow(a, b, &result))
+                return false;
+            break;
+        case IR_DIV:
+            if (b == 0 || (a == INT64_MIN && b == -1))
+                return false;
+            result = a / b;
+            break;
+        case IR_MOD:
+            if (b == 0 || (a == INT64_MIN && b == -1))
+                return false;
+            result = a % b;
+            break;
+        case IR_EQ: result = a == b; break;
+        case IR_NE: result = a != b; break;
+        case IR_LT: result = a < b;  break;
+        case IR_LE: result = a <= b; break;
+        case IR_GT: result = a > b;  break;
+        case IR_GE: result = a >= b; break;
+        default: return false;
+        }
+
+        if (inst->flags & IR_FLAG_WRAP) {
+            if (inst->type->atom_type == AST_TYPE_INT)
+                result = (int32_t) result;
+        }
+        else if (!fits_type(result, inst->type))
+            return false;
+
+        inst->imm = result;
+    }
+
+    inst->op = IR_CONST;
+    inst->flags = IR_FLAG_NONE;
+    inst->args.clear();
+    return true;
+}
+
+void simplify(Ir_Function* func, Ir_Block* block, Ir_Value* inst) {
+    if (fold_constant(inst) || inst->args.top() != 2 || !is_integral_type(inst->type))
+        return;
+
+    Ir_Value* left = inst->args.get(0);
+    Ir_Value* right = inst->args.get(1);
+
+    switch (inst->op) {
+    case IR_ADD:
+        if (is_integral_constant(right, 0) && left->type == inst->type)
+            inst->forward = left;
+        else if (is_integral_constant(left, 0) && right->type == inst->type)
+            inst->forward = right;
+        break;
+    case IR_SUB:
+        if (is_integral_constant(right, 0) && left->type == inst->type)
+            inst->forward = left;
+        else if (left == right) {
+            inst->op = IR_CONST;
+            inst->imm = 0;
+            inst->args.clear();
+        }
+        break;
+    case IR_DIV:
+        if (is_integral_constant(right, 1) && left->type == inst->type)
+            inst->forward = left;
+        break;
+    case IR_MUL: {
+        if (is_constant(left) && !is_constant(right)) {
+            inst->args.get_arr()[0] = right;
+            inst->args.get_arr()[1] = left;
+            left = inst->args.get(0);
+            right = inst->args.get(1);
+        }
+
+        if (!is_constant(right) || !is_integral_type(right->type))
+            break;
+
+        int64_t factor = right->imm;
+        if (factor == 0) {
+            inst->op = IR_CONST;
+            inst->imm = 0;
+            inst->args.clear();
+        }
+        else if (factor == 1 && left->type == inst->type)
+            inst->forward = left;
+        else if (factor > 1 && (factor & (factor - 1)) == 0) {
+            int bits = (inst->type->atom_type == AST_TYPE_LONG) ? 64 : 32;
+            int shift = __builtin_ctzll((unsigned long long) factor);
+            if (shift < bits - 1) {
+                // Signed overflow was already undefined, so a wrapping shift is a valid refinement.
+                Ir_Value* amount = insert_value(func, block, IR_CONST, canonical_type(AST_TYPE_INT));
+                amount->imm = shift;
+                inst->op = IR_SHL;
+                inst->flags |= IR_FLAG_WRAP;
+                inst->args.get_arr()[1] = amount;
+            }
+        }
+        break;
+    }
+    }
+}
+
+void find_loops(Ir_Function* func, Array<Ir_Loop*>* loops) {
+    ir_compute_dominators(func);
+
+    // Headers later in reverse post-order are nested deeper, so visiting them first handles inner loops first.
+    for (int i = (int) func->blocks.top() - 1; i >= 0; i--) {
+        Ir_Block* header = func->blocks.get(i);
+        Ir_Block* latch = nullptr;
+        Ir_Block* preheader = nullptr;
+        int back_edges = 0, outside = 0;
+
+        for (int j = 0; j < header->preds.top(); j++) {
+            Ir_Block* pred = header->preds.get(j);
+            if (ir_dominates(header, pred)) {
+                latch = pred;
+                back_edges++;
+            }
+            else {
+                preheader = pred;
+                outside++;
+            }
+        }
+
+        if (back_edges != 1 || outside != 1 || latch == header || preheader->term != IR_TERM_JUMP)
+            continue;
+
+        Ir_Loop* loop = new Ir_Loop;
+        track_allocation(MEM_BACKEND, sizeof(Ir_Loop));
+        loop->header = header;
+        loop->latch = latch;
+        loop->preheader = preheader;
+        for (int j = 0; j < func->block_count; j++)
+            loop->member.push(false);
+
+        Array<Ir_Block*> worklist;
+        loop->member.get_arr()[header->id] = true;
+        loop->member.get_arr()[latch->id] = true;
+        worklist.push(latch);
+
+        while (worklist.top() > 0) {
+            Ir_Block* block = worklist.get(worklist.top() - 1);
+            worklist.pop();
+
+            for (int j = 0; j < block->preds.top(); j++) {
+                Ir_Block* pred = block->preds.get(j);
+                if (!loop->member.get(pred->id)) {
+                    loop->member.get_arr()[pred->id] = true;
+                    worklist.push(pred);
+                }
+            }
+        }
+
+        for (int j = 0; j < func->blocks.top(); j++) {
+            Ir_Block* block = func->blocks.get(j);
+            if (!loop->member.get(block->id))
+                continue;
+
+            for (int k = 0; k < block->insts.top(); k++) {
+                int op = block->insts.get(k)->op;
+                if (op == IR_CALL || op == IR_STORE)
+                    loop->has_side_effects = true;
+            }
+        }
+
+        loops->push(loop);
+    }
+}
+
+void free_loops(Array<Ir_Loop*>* loops) {
+    for (int i = 0; i < loops->top(); i++)
+        delete loops->get(i);
+}
+
+bool in_loop(Ir_Loop* loop, Ir_Value* value) {
+    return (value->block && loop->member.get(value->block->id));
+}
+
+void reduce_induction_variables(Ir_Function* func, Ir_Loop* loop) {
+    Ir_Block* header = loop->header;
+    if (header->preds.top() != 2)
+        return;
+
+    int pre_index = (header->preds.get(0) == loop->preheader) ? 0 : 1;
+    int latch_index = 1 - pre_index;
+
+    for (int i = 0; i < header->phis.top(); i++) {
+        Ir_Value* phi = header->phis.get(i);
+        if (phi->forward || !is_integral_type(phi->type) || phi->type->atom_type == AST_TYPE_BYTE)
+            continue;
+
+        Ir_Value* init = resolve(phi->args.get(pre_index));
+        Ir_Value* next = resolve(phi->args.get(latch_index));
+        if (next->type != phi->type || next->args.top() != 2)
+            continue;
+
+        int64_t step;
+        if (next->op == IR_ADD && next->args.get(0) == phi && is_constant(next->args.get(1)))
+            step = next->args.get(1)->imm;
+        else if (next->op == IR_ADD && next->args.get(1) == phi && is_constant(next->args.get(0)))
+            step = next->args.get(0)->imm;
+        else if (next->op == IR_SUB && next->args.get(0) == phi && is_constant(next->args.get(1)))
+            step = -next->args.get(1)->imm;
+        else
+            continue;
+
+        for (int j = 0; j < func->blocks.top(); j++) {
+            Ir_Block* block = func->blocks.get(j);
+            if (!loop->member.get(block->id))
+                continue;
+
+            for (int k = 0; k < block->insts.top(); k++) {
+                Ir_Value* mul = block->insts.get(k);
+                if (mul->forward || mul->op != IR_MUL || mul->type != phi->type)
+                    continue;
+
+                Ir_Value* factor = nullptr;
+                if (mul->args.get(0) == phi && is_constant(mul->args.get(1)))
+                    factor = mul->args.get(1);
+                else if (mul->args.get(1) == phi && is_constant(mul->args.get(0)))
+                    factor = mul->args.get(0);
+
+                int64_t increment;
+                if (!factor || __builtin_mul_overflow(step, factor->imm, &increment) || !fits_type(increment, phi->type))
+                    continue;
+
+                Ir_Value* scale = insert_value(func, loop->preheader, IR_CONST, phi->type);
+                scale->imm = factor->imm;
+                Ir_Value* start = insert_value(func, loop->preheader, IR_MUL, phi->type);
+                start->flags |= IR_FLAG_WRAP;
+                start->args.push(init);
+                start->args.push(scale);
+
+                Ir_Value* reduced = func->new_value(IR_PHI, phi->type);
+                reduced->block = header;
+                header->phis.push(reduced);
+
+                Ir_Value* delta = insert_value(func, loop->latch, IR_CONST, phi->type);
+                delta->imm = increment;
+                Ir_Value* advanced = insert_value(func, loop->latch, IR_ADD, phi->type);
+                advanced->flags |= IR_FLAG_WRAP;
+                advanced->args.push(reduced);
+                advanced->args.push(delta);
+
+                reduced->args.push((pre_index == 0) ? start : advanced);
+                reduced->args.push((pre_index == 0) ? advanced : start);
+
+                mul->forward = reduced;
+            }
+        }
+    }
+}
+
+void strength_reduction(Ir_Function* func) {
+    for (int i = 0; i < func->blocks.top(); i++) {
+        Ir_Block* block = func->blocks.get(i);
+        for (int j = 0; j < block->insts.top(); j++) {
+            Ir_Value* inst = block->insts.get(j);
+            if (!inst->forward)
+                simplify(func, block, inst);
+        }
+    }
+    ir_resolve_operands(func);
+
+    Array<Ir_Loop*> loops;
+    find_loops(func, &loops);
+    for (int i = 0; i < loops.top(); i++)
+        reduce_induction_variables(func, loops.get(i));
+    free_loops(&loops);
+
+    ir_resolve_operands(func);
+}
+
+bool is_loop_invariant(Ir_Loop* loop, Ir_Value* inst) {
+    switch (inst->op) {
+    case IR_PHI:
+    case IR_CALL:
+    case IR_STORE:
+    case IR_UNDEF:
+    case IR_PARAM:
+        return false;
+    case IR_LOAD:
+        if (loop->has_side_effects)
+            return false;
+        break;
+    case IR_DIV:
+    case IR_MOD: {
+        // Hoisting may execute the division when the loop body would not have, so it must not trap.
+        Ir_Value* divisor = inst->args.get(1);
+        if (!is_constant(divisor) || !is_integral_type(divisor->type) || divisor->imm == 0 || divisor->imm == -1)
+            return false;
+        break;
+    }
+    }
+
+    for (int i = 0; i < inst->args.top(); i++) {
+        if (in_loop(loop, inst->args.get(i)))
+            return false;
+    }
+    return true;
+}
+
+void loop_invariant_code_motion(Ir_Function* func) {
+    Array<Ir_Loop*> loops;
+    find_loops(func, &loops);
+
+    for (int i = 0; i < loops.top(); i++) {
+        Ir_Loop* loop = loops.get(i);
+
+        bool changed = true;
+        while (changed) {
+            changed = false;
+
+            for (int j = 0; j < func->blocks.top(); j++) {
+                Ir_Block* block = func->blocks.get(j);
+                if (!loop->member.get(block->id))
+                    continue;
+
+                for (int k = 0; k < block->insts.top(); k++) {
+                    Ir_Value* inst = block->insts.get(k);
+                    if (!is_loop_invariant(loop, inst))
+                        continue;
+
+                    remove_from_block(&block->insts, inst);
+                    inst->block = loop->preheader;
+                    loop->preheader->insts.push(inst);
+
+                    changed = true;
+                    k--;
+                }
+            }
+        }
+    }
+
+    free_loops(&loops);
+}
+
+void mark_live(Ir_Value* value, Array<Ir_Value*>* worklist) {
+    if (value && !value->live) {
+        value->live = true;
+        worklist->push(value);
+    }
+}
+
+void dead_code_elimination(Ir_Function* func) {
+    for (int i = 0; i < func->blocks.top(); i++) {
+        Ir_Block* block = func->blocks.get(i);
+        if (block->term != IR_TERM_BRANCH || !is_constant(block->term_value))
+            continue;
+
+        Ir_Value* test = block->term_value;
+        bool taken = (is_floating_type(test->type)) ? (test->fimm != 0) : (test->imm != 0);
+        Ir_Block* target = block->targets[(taken) ? 0 : 1];
+        Ir_Block* dropped = block->targets[(taken) ? 1 : 0];
+
+        for (int j = 0; j < dropped->preds.top(); j++) {
+            if (dropped->preds.get(j) == block) {
+                ir_remove_pred(dropped, j);
+                break;
+            }
+        }
+
+        block->term = IR_TERM_JUMP;
+        block->term_value = nullptr;
+        block->targets[0] = target;
+        block->targets[1] = nullptr;
+    }
+
+    ir_remove_unreachable_blocks(func);
+
+    Array<Ir_Value*> worklist;
+    for (int i = 0; i < func->blocks.top(); i++) {
+        Ir_Block* block = func->blocks.get(i);
+
+        for (int j = 0; j < block->phis.top(); j++)
+            block->phis.get(j)->live = false;
+        for (int j = 0; j < block->insts.top(); j++) {
+            Ir_Value* inst = block->insts.get(j);
+            inst->live = false;
+            if (inst->op == IR_CALL || inst->op == IR_STORE)
+                mark_live(inst, &worklist);
+        }
+    }
+
+    for (int i = 0; i < func->blocks.top(); i++)
+        mark_live(func->blocks.get(i)->term_value, &worklist);
+
+    while (worklist.top() > 0) {
+        Ir_Value* value = worklist.get(worklist.top() - 1);
+        worklist.pop();
+
+        for (int i = 0; i < value->args.top(); i++)
+            mark_live(value->args.get(i), &worklist);
+    }
+
+    for (int i = 0; i < func->blocks.top(); i++) {
+        Ir_Block* block = func->blocks.get(i);
+        remove_dead(&block->phis);
+        remove_dead(&block->insts);
+    }
+}
+
+static Ir_Pass pipeline[] = {
+    { "copy-prop", copy_propagation,                  0, 0 },
+    { "cse",       common_subexpression_elimination,  0, 0 },
+    { "strength",  strength_reduction,                0, 0 },
+    { "licm",      loop_invariant_code_motion,        0, 0 },
+    { "dce",       dead_code_elimination,             0, 0 },
+    { "copy-prop", copy_propagation,                  0, 0 },
+};
+
+#define PIPELINE_SIZE (sizeof(pipeline) / sizeof(pipeline[0]))
+
+void optimize_function(Ir_Function* func) {
+    Scoped_Timer timer("ir opt");
+    for (int i = 0; i < PIPELINE_SIZE; i++) {
+        int before = func->instruction_count();
+        begin_timer(pipeline[i].name);
+
+        pipeline[i].run(func);
+
+        pipeline[i].elapsed += end_timer();
+        pipeline[i].removed += before - func->instruction_count();
+
+        if (options.dump_ir) {
+            printf("ir: after %s\n", pipeline[i].name);
+            dump_function(stdout, func);
+        }
+    }
+}
+
+void report_pass_timings() {
+    for (int i = 0; i < PIPELINE_SIZE; i++) {
+        printf("ir: pass %-10s %10.3f ms %8ld instructions removed\n", pipeline[i].name,
+            (double) pipeline[i].elapsed / 1000000.0, pipeline[i].removed);
+    }
+}
@@ -1,16 +1,20 @@
 #include "../include/lexer.h"
 #include "../include/err.h"
 #include "../include/sym.h"
+#include "../include/stats.h"
+#include "../include/literal.h"
 
 #include <ctype.h>
 #include <string>  
-#include <sys/stat.h>
 
 static SymTable keywords;
 static SymTable symbols;
 
 #define REALLOC_TOKEN_SIZE 512
 
+// The longest entry in the symbol table, a run of symbol characters is split once it reaches this.
+#define MAX_SYMBOL_SIZE 2
+
 enum {
     IDENTIFIER = 1,
     NUMERIC,
@@ -21,36 +25,15 @@ enum {
 
 uint8_t* backtrack_symbol_position = 0;
 
-uint8_t* load_file(const char* filepath, size_t* filesize) {
-    uint8_t* stream;
-    FILE* file;
-    int size;
-
-    if(file = fopen(filepath, LEXER_FILE_MODE)) {
-        struct stat st;
-
-        if (fstat(fileno(file), &st) != -1) {
-            stream = (uint8_t *) malloc(st.st_size);
-            *filesize = st.st_size;
-            fread((void*) stream, 1, st.st_size, file);
-        }
-        else 
-            fatal_error("Failed to load stats of input file");
-    }
-    else 
-        fatal_error("Failed to open input file for compilation");
-
-    return stream;
-}
-
-Lexer* Lexer::init(uint8_t* stream) {
+Lexer* Lexer::init(Source_File* source) {
     Lexer* lexer = new Lexer;
-    lexer->stream = stream;
+    lexer->source = source;
+    lexer->stream = source->text;
     lexer->tokens = (Token*) malloc(sizeof(Token) * REALLOC_TOKEN_SIZE);
+    track_allocation(MEM_TOKENS, sizeof(Token) * REALLOC_TOKEN_SIZE);
     lexer->size = 0;
     lexer->allocated_size = REALLOC_TOKEN_SIZE;
-
-    lexer->current_line = lexer->current_pos = 1;
+    memset(lexer->current, 0, MAX_TOKEN_SIZE);
 
     keywords.insert("if", Tok::T_IF);
     keywords.insert("else", Tok::T_ELSE);
@@ -62,11 +45,21 @@ Lexer* Lexer::init(uint8_t* stream) {
     keywords.insert("int", Tok::T_INT);
     keywords.insert("boolean", Tok::T_BOOLEAN);
     keywords.insert("byte", Tok::T_BYTE);
+    keywords.insert("long", Tok::T_LONG);
     keywords.insert("double", Tok::T_DOUBLE);
     keywords.insert("float", Tok::T_FLOAT);
     keywords.insert("foreign", Tok::T_FOREIGN);
     keywords.insert("return", Tok::T_RETURN);
     keywords.insert("from", Tok::T_FROM);
+    keywords.insert("memoize", Tok::T_MEMOIZE);
+    keywords.insert("for", Tok::T_FOR);
+    keywords.insert("in", Tok::T_IN);
+    keywords.insert("simd", Tok::T_SIMD);
+    keywords.insert("parallel", Tok::T_PARALLEL);
+    keywords.insert("arena", Tok::T_ARENA);
+    keywords.insert("new", Tok::T_NEW);
+    keywords.insert("struct", Tok::T_STRUCT);
+    keywords.insert("soa", Tok::T_SOA);
     keywords.insert("constant", Tok::T_CONST);
 
     symbols.insert(":=", Tok::T_COLON_ASSIGN);
@@ -77,21 +70,12 @@ Lexer* Lexer::init(uint8_t* stream) {
     symbols.insert("++", Tok::T_INC);
     symbols.insert("--", Tok::T_DEC);
     symbols.insert("->", Tok::T_DASH_ARROW);
+    symbols.insert("..", Tok::T_DOT_DOT);
 
     backtrack_symbol_position = 0;
     return lexer;
 }
 
-void new_line(int* type, Lexer* lexer) {
-    if (*lexer->stream == '\n') {
-        lexer->current_line++;
-        lexer->current_pos = 1;
-
-        if (*type == SINGLE_LINE_COMMENT)
-            *type = 0;
-    }
-}
-
 bool is_identifier(char c) {
     return (isalpha(c) || c == '_');
 }
@@ -101,11 +85,14 @@ void remove_whitespaces(char* s) {
     do while (isspace(*s)) s++; while (*d++ = *s++);
 }
 
-Token fill_token(int type, uint32_t pos, uint32_t line) {
+Source_Location location_of(Lexer* lexer, const uint8_t* at) {
+    return lexer->source->base + (uint32_t) (at - lexer->source->text);
+}
+
+Token fill_token(int type, Source_Location loc) {
     Token t;
 
-    t.line = line;
-    t.pos = pos;
+    t.loc = loc;
     t.type = type;
 
     return t;
@@ -117,18 +104,20 @@ void check_for_overflow(Lexer* lexer) {
         lexer->tokens = (Token*) realloc(lexer->tokens, (sizeof(struct Token) * lexer->size) * 2);
         if (!lexer->tokens) 
             fatal_error("could not resize token memory.\n");
+        track_allocation(MEM_TOKENS, (int64_t) sizeof(Token) * (lexer->size * 2 - lexer->allocated_size));
         lexer->allocated_size = lexer->size * 2;
     }
 }
 
-void create_token(Lexer* lexer, int type) {
+void create_token(Lexer* lexer, int type, const uint8_t* at) {
     check_for_overflow(lexer);
-    lexer->tokens[lexer->size] = fill_token(type, lexer->current_pos, lexer->current_line);
+    lexer->tokens[lexer->size] = fill_token(type, location_of(lexer, at));
     lexer->size++;
 }
 
+// Identifiers are flushed on the character after them, so they start 'current_len' bytes back.
 void create_id_token(Lexer* lexer, int type, const char* name) {
-    Token t = fill_token(type, lexer->current_pos, lexer->current_line);
+    Token t = fill_token(type, location_of(lexer, lexer->stream - lexer->current_len));
 
     strcpy(t.identifier, name);
 
@@ -137,17 +126,32 @@ void create_id_token(Lexer* lexer, int type, const char* name) {
     lexer->size++;
 }
 
-void create_numeric_token(Lexer* lexer, int type, const char* int_const) {
-    Token t = fill_token(type, lexer->current_pos, lexer->current_line);
-    t.int_const = atoi(int_const);
+// Called on the first digit. Leaves the stream on the literal's last character for the main loop to step past.
+void create_numeric_token(Lexer* lexer) {
+    Numeric_Literal literal = scan_numeric_literal(lexer->stream);
+    uint32_t length = literal.end - lexer->stream;
+    Source_Location loc = location_of(lexer, lexer->stream);
+
+    if (literal.error) {
+        report_error(loc, "invalid numeric literal '%.*s', %s", (int) length, lexer->stream, literal.error);
+        lexer->error_count++;
+    }
+
+    Token t = fill_token(literal.type, loc);
+    if (literal.type == Tok::T_FLOAT_CONST)
+        t.float_const = literal.float_const;
+    else
+        t.int_const = literal.int_const;
 
     check_for_overflow(lexer);
     lexer->tokens[lexer->size] = t;
     lexer->size++;
+
+    lexer->stream += length - 1;
 }
 
 void create_char_const_token(Lexer* lexer) {
-    Token t = fill_token(Tok::T_CHAR_CONST, lexer->current_pos, lexer->current_line);
+    Token t = fill_token(Tok::T_CHAR_CONST, location_of(lexer, lexer->stream - 1));
     t.char_const = *lexer->stream;
 
     check_for_overflow(lexer);
@@ -181,24 +185,25 @@ void create_symbol(Lexer* lexer, int* type) {
         Entry* e = symbols.look_up(lexer->current);
 
         if (e) {
-            create_token(lexer, e->type);   
+            create_token(lexer, e->type, backtrack_symbol_position);
             reset(type, lexer);
             lexer->stream = backtrack_symbol_position + i + 1;
             return;
         }
     }
 
-    create_token(lexer, lexer->current[0]);
+    create_token(lexer, lexer->current[0], backtrack_symbol_position);
     lexer->stream = backtrack_symbol_position + 1;
     reset(type, lexer);
 }
 
-void single_line_comment(Lexer* lexer, int* type) {
-    if (*lexer->stream == '/' && *(lexer->stream + 1) == '/') {
-        if (*type == 0)
-            *type = SINGLE_LINE_COMMENT;
+bool single_line_comment(Lexer* lexer, int* type) {
+    if (*type == 0 && *lexer->stream == '/' && *(lexer->stream + 1) == '/') {
+        *type = SINGLE_LINE_COMMENT;
         lexer->stream++;
+        return true;
     }
+    return false;
 }
 
 void multi_line_comment(Lexer* lexer, int* type, int* nested) {
@@ -220,17 +225,17 @@ void Lexer::run() {
     int type = 0;
     int nested = 0;
 
-    while(*stream != '`') {   
-        new_line(&type, this);
+    while(*stream && *stream != '`') {   
+        if (*stream == '\n' && type == SINGLE_LINE_COMMENT)
+            type = 0;
 
         multi_line_comment(this, &type, &nested);
         
         if (type != SINGLE_LINE_COMMENT && type != MULTI_LINE_COMMENT) {
-            single_line_comment(this, &type);
             if (type == IDENTIFIER && !is_identifier(*stream)) {
                 Entry* e = keywords.look_up(current);
                 if (e) {
-                    create_token(this, e->type);
+                    create_token(this, e->type, stream - current_len);
                     reset(&type, this);
                 }
                 else if (!isdigit(*stream)) {
@@ -238,15 +243,12 @@ void Lexer::run() {
                     reset(&type, this);
                 }
             }
-            else if (!isdigit(*stream) && type == NUMERIC) {
-                create_numeric_token(this, Tok::T_INT_CONST, current);
-                reset(&type, this);
-            }
-            else if (type == SYMBOL && get_type_of_token(*stream) != SYMBOL) {             
+            else if (type == SYMBOL && (get_type_of_token(*stream) != SYMBOL || current_len == MAX_SYMBOL_SIZE)) {
                 create_symbol(this, &type);
             }
 
-            if (!is_special_character(*stream)) {
+            // Only once a pending token has been flushed can '//' start a comment.
+            if (!single_line_comment(this, &type) && !is_special_character(*stream)) {
                 current[current_len++] = *stream;
                 if (current_len == 1) {
                     type = get_type_of_token(*stream);
@@ -255,7 +257,10 @@ void Lexer::run() {
                         stream++;
                         create_char_const_token(this);
                         stream++;
-                        current_pos += 2;
+                        reset(&type, this);
+                    }
+                    else if (type == NUMERIC) {
+                        create_numeric_token(this);
                         reset(&type, this);
                     }
                     else if (type == SYMBOL) {
@@ -266,17 +271,16 @@ void Lexer::run() {
         }
 
         stream++;
-        current_pos++;
     }
 
-    create_token(this, Tok::T_EOF);
+    create_token(this, Tok::T_EOF, stream);
 }
 
-void Lexer::log() {
-    printf("lexer: Tokenized %d lines of code in '%s'.\n", current_line, file);
+void Lexer::log(FILE* out) {
+    fprintf(out, "lexer: Tokenized %u lines of code in '%s'.\n", source_manager.lines_in(source), source->name);
 
     for(int i = 0; i < size; i++) 
-        log_token(&tokens[i]);
+        log_token(out, &tokens[i]);
 }
 
 const char* token_to_str(Token* token) {
@@ -289,10 +293,12 @@ const char* token_to_str(Token* token) {
         return e->name;
 
     static char single_char_token[2] = { '\0' };
+    static char number_token[32];
 
     switch(token->type) {
         case Tok::T_IDENTIFIER: return token->identifier;
-        case Tok::T_INT_CONST:  return std::to_string(token->int_const).c_str();
+        case Tok::T_INT_CONST:  snprintf(number_token, sizeof(number_token), "%lld", (long long) token->int_const); return number_token;
+        case Tok::T_FLOAT_CONST: snprintf(number_token, sizeof(number_token), "%.17g", token->float_const); return number_token;
         case Tok::T_CHAR_CONST:  single_char_token[0] = token->char_const; return single_char_token;
         case Tok::T_EOF:        return "End of file";
         default: break;
@@ -314,6 +320,7 @@ const char* type_to_str(int type) {
     switch(type) {
         case Tok::T_IDENTIFIER: return "Identifier";
         case Tok::T_INT_CONST:  return "Int Const";
+        case Tok::T_FLOAT_CONST: return "Float Const";
         case Tok::T_EOF:        return "End of file";
         default: break;
     }
@@ -324,6 +331,6 @@ const char* type_to_str(int type) {
     return single_char_token;
 }
 
-void log_token(Token* token) {
-    printf("token: '%s', type: %d, line: %d. pos: %d.\n", token_to_str(token), token->type, token->line, token->pos);
+void log_token(FILE* out, Token* token) {
+    fprintf(out, "token: '%s', type: %d, line: %d. pos: %d.\n", token_to_str(token), token->type, source_manager.line_of(token->loc), source_manager.column_of(token->loc));
 }
\ No newline at end of file
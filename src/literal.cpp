@@ -0,0 +1,212 @@
+#include "../include/literal.h"
+#include "../include/lexer.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_EXACT_MANTISSA (1ULL << 53)
+#define MAX_EXACT_POWER 22
+#define MAX_EXPONENT 100000
+
+static const double exact_powers[MAX_EXACT_POWER + 1] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static inline uint64_t load_chunk(const uint8_t* p) {
+    uint64_t chunk;
+    memcpy(&chunk, p, sizeof(chunk));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    chunk = __builtin_bswap64(chunk);
+#endif
+    return chunk;
+}
+
+// Every byte is in '0'..'9' when its high nibble is 3 and adding 6 does not carry into it.
+static inline bool is_eight_digits(uint64_t chunk) {
+    return ((chunk & 0xF0F0F0F0F0F0F0F0ULL) == 0x3030303030303030ULL) &&
+        (((chunk + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) == 0x3030303030303030ULL);
+}
+
+// Folds adjacent digits into pairs, then pairs into the full eight digit value, with three multiplies.
+static inline uint64_t parse_eight_digits(uint64_t chunk) {
+    const uint64_t mask = 0x000000FF000000FFULL;
+    const uint64_t pairs_high = 100 + (1000000ULL << 32);
+    const uint64_t pairs_low = 1 + (10000ULL << 32);
+
+    chunk -= 0x3030303030303030ULL;
+    chunk = (chunk * 10) + (chunk >> 8);
+    return (((chunk & mask) * pairs_high) + (((chunk >> 16) & mask) * pairs_low)) >> 32;
+}
+
+struct Decimal {
+    uint64_t value = 0;
+    int digits = 0;
+    bool overflow = false;
+    bool bad_separator = false;
+};
+
+static inline int hex_digit(uint8_t c) {
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    c |= 0x20;
+    return (c >= 'a' && c <= 'f') ? c - 'a' + 10 : -1;
+}
+
+// A separator has to sit between two digits of the same literal.
+static inline bool valid_separator(const uint8_t* p, int digit_base) {
+    auto is_digit = [digit_base](uint8_t c) { return (digit_base == 16) ? hex_digit(c) >= 0 : (c >= '0' && c < '0' + digit_base); };
+    return is_digit(p[-1]) && is_digit(p[1]);
+}
+
+static const uint8_t* scan_decimal(const uint8_t* p, Decimal* decimal) {
+    for (;;) {
+        uint64_t chunk = load_chunk(p);
+        if (is_eight_digits(chunk)) {
+            uint64_t eight = parse_eight_digits(chunk);
+            if (decimal->value > (UINT64_MAX - eight) / 100000000ULL)
+                decimal->overflow = true;
+            decimal->value = decimal->value * 100000000ULL + eight;
+            decimal->digits += 8;
+            p += 8;
+        }
+        else if (*p >= '0' && *p <= '9') {
+            uint64_t digit = *p - '0';
+            if (decimal->value > (UINT64_MAX - digit) / 10)
+                decimal->overflow = true;
+            decimal->value = decimal->value * 10 + digit;
+            decimal->digits++;
+            p++;
+        }
+        else if (*p == '_') {
+            if (!valid_separator(p, 10))
+                decimal->bad_separator = true;
+            p++;
+        }
+        else
+            return p;
+    }
+}
+
+static const uint8_t* scan_radix(const uint8_t* p, int shift, Decimal* decimal) {
+    int base = 1 << shift;
+    for (;; p++) {
+        int digit = hex_digit(*p);
+        if (digit >= 0 && digit < base) {
+            if (decimal->value >> (64 - shift))
+                decimal->overflow = true;
+            decimal->value = (decimal->value << shift) | (uint64_t) digit;
+            decimal->digits++;
+        }
+        else if (*p == '_') {
+            if (!valid_separator(p, base))
+                decimal->bad_separator = true;
+        }
+        else
+            return p;
+    }
+}
+
+// Digits past what a double can hold exactly go through strtod, which rounds correctly.
+static double slow_float(const uint8_t* start, const uint8_t* end) {
+    char small[128];
+    size_t length = end - start;
+    char* text = (length < sizeof(small)) ? small : (char*) malloc(length + 1);
+
+    size_t size = 0;
+    for (const uint8_t* p = start; p < end; p++) {
+        if (*p != '_')
+            text[size++] = *p;
+    }
+    text[size] = '\0';
+
+    double value = strtod(text, nullptr);
+    if (text != small)
+        free(text);
+    return value;
+}
+
+static void scan_float(Numeric_Literal* literal, const uint8_t* start, const uint8_t* p, Decimal* decimal) {
+    int exponent = 0;
+
+    if (*p == '.' && isdigit(p[1])) {
+        int whole_digits = decimal->digits;
+        p = scan_decimal(p + 1, decimal);
+        exponent -= decimal->digits - whole_digits;
+    }
+
+    if ((*p == 'e' || *p == 'E') && (isdigit(p[1]) || ((p[1] == '+' || p[1] == '-') && isdigit(p[2])))) {
+        p++;
+        bool negative = (*p == '-');
+        if (*p == '+' || *p == '-')
+            p++;
+
+        int written = 0;
+        for (; isdigit(*p); p++) {
+            if (written < MAX_EXPONENT)
+                written = written * 10 + (*p - '0');
+        }
+        exponent += (negative) ? -written : written;
+    }
+
+    literal->type = Tok::T_FLOAT_CONST;
+    literal->end = p;
+
+    // Both the mantissa and the power of ten are exact doubles here, so one multiply or divide rounds correctly.
+    if (!decimal->overflow && decimal->value <= MAX_EXACT_MANTISSA && exponent >= -MAX_EXACT_POWER && exponent <= MAX_EXACT_POWER) {
+        double value = (double) decimal->value;
+        literal->float_const = (exponent < 0) ? value / exact_powers[-exponent] : value * exact_powers[exponent];
+    }
+    else
+        literal->float_const = slow_float(start, p);
+
+    if (literal->float_const == 1.0 / 0.0)
+        literal->error = "out of the range of a double";
+}
+
+Numeric_Literal scan_numeric_literal(const uint8_t* start) {
+    Numeric_Literal literal;
+    literal.type = Tok::T_INT_CONST;
+
+    Decimal decimal;
+    const uint8_t* p = start;
+
+    if (start[0] == '0' && (start[1] | 0x20) == 'x') {
+        p = scan_radix(start + 2, 4, &decimal);
+        if (decimal.digits == 0)
+            literal.error = "a hex literal needs at least one digit";
+    }
+    else if (start[0] == '0' && (start[1] | 0x20) == 'b' && (start[2] == '0' || start[2] == '1')) {
+        p = scan_radix(start + 2, 1, &decimal);
+    }
+    else {
+        p = scan_decimal(start, &decimal);
+
+        bool fraction = (*p == '.' && isdigit(p[1]));
+        bool exponent = ((*p == 'e' || *p == 'E') && (isdigit(p[1]) || ((p[1] == '+' || p[1] == '-') && isdigit(p[2]))));
+        if (fraction || exponent) {
+            scan_float(&literal, start, p, &decimal);
+            p = literal.end;
+        }
+    }
+
+    if (literal.type == Tok::T_INT_CONST) {
+        if (decimal.overflow || decimal.value > (uint64_t) INT64_MAX)
+            literal.error = "does not fit in 64 bits";
+        else
+            literal.int_const = (int64_t) decimal.value;
+    }
+    if (decimal.bad_separator)
+        literal.error = "'_' has to sit between two digits";
+
+    // Letters or digits running on from a literal are never a separate token.
+    if (isalnum(*p) || *p == '_') {
+        literal.error = "unexpected characters after the digits";
+        while (isalnum(*p) || *p == '_')
+            p++;
+    }
+
+    literal.end = p;
+    return literal;
+}
@@ -1,56 +1,221 @@
 #include <stdio.h>
+#include <string.h>
 
 #include "../include/err.h"
 #include "../include/arr.h"
 #include "../include/lexer.h"
-#include "../include/benc.h"
+#include "../include/timer.h"
+#include "../include/perf.h"
+#include "../include/stats.h"
+#include "../include/trace.h"
 #include "../include/parser.h"
 #include "../include/c_converter.h"
+#include "../include/options.h"
+#include "../include/sema.h"
+#include "../include/ast_dump.h"
+#include "../include/ast_cache.h"
+#include "../include/fold.h"
+#include "../include/call_graph.h"
+#include "../include/purity.h"
+#include "../include/inline.h"
+#include "../include/bounds.h"
+#include "../include/ir.h"
 
-#define INPUT_FILE_INDEX 1
-#define OBJ_NAME_INDEX   2
+bool no_input_file() {
+    return (options.input_file == nullptr);
+}
 
-bool no_input_file(char* argv[]) {
-    return (argv[INPUT_FILE_INDEX] == nullptr);
+bool no_obj_name() {
+    return (options.obj_name == nullptr);
 }
 
-bool no_obj_name(char* argv[]) {
-    return (argv[OBJ_NAME_INDEX] == nullptr);
+#define DUMP_BUFFER_SIZE (1 << 20)
+
+// Dumps are block buffered so a large file goes out in a few writes rather than one per line.
+FILE* open_dump(const char* path) {
+    FILE* file = (strcmp(path, "-") == 0) ? stdout : fopen(path, "w");
+    if (!file)
+        fatal_error("could not open dump file '%s'.\n", path);
+    setvbuf(file, nullptr, _IOFBF, DUMP_BUFFER_SIZE);
+    return file;
 }
 
-int main(int argc, char* argv[]) {
-    if (no_input_file(argv)) 
-        fatal_error("No input files");
-    else if (no_obj_name(argv)) 
-        fatal_error("No object name");
-    
-    size_t filesize;
-    Lexer* lexer = Lexer::init(load_file(argv[INPUT_FILE_INDEX], &filesize));
-    lexer->file = argv[INPUT_FILE_INDEX];
+void close_dump(FILE* file) {
+    if (file == stdout)
+        fflush(file);
+    else
+        fclose(file);
+}
+
+Parser* parse_source(Source_File* source) {
+    Lexer* lexer = Lexer::init(source);
 
-    begin_debug_benchmark();
+    begin_timer("lexer");
+    begin_perf_phase("lexer");
     lexer->run();
-    end_debug_benchmark("lexer");
+    end_perf_phase(lexer->size, "token");
+    end_timer();
+    record_timer_count("tokens", lexer->size);
+    set_stat(STAT_TOKENS, lexer->size);
 
-    lexer->log();
+    if (options.dump_tokens) {
+        FILE* file = open_dump(options.dump_tokens);
+        lexer->log(file);
+        close_dump(file);
+    }
     
     Parser* parser = Parser::init(lexer);
     
-    begin_debug_benchmark();
+    begin_timer("parser");
+    begin_perf_phase("parser");
     parser->run();
-    end_debug_benchmark("parser");
+    parser->error_count += lexer->error_count;
+    end_perf_phase(parser->node_count, "node");
+    end_timer();
+    record_timer_count("nodes", parser->node_count);
+    set_stat(STAT_NODES, parser->node_count);
+
+    return parser;
+}
+
+void compile() {
+    reset_stats();
 
-    delete lexer;
+    Source_File* source = source_manager.load_file(options.input_file);
 
-    begin_debug_benchmark();
-    if (parser->error_count == 0)
-        convert_transition_unit(argv[2], parser->root, &parser->extra_headers);
-    else 
+    // A token dump needs the lexer, so it always goes through the text frontend.
+    Ast_Cache cache;
+    Parser* parser = nullptr;
+    if (options.ast_cache) {
+        Scoped_Timer timer("ast cache");
+        open_ast_cache(&cache, source);
+
+        parser = Parser::init(nullptr);
+        if (!options.dump_tokens && load_ast_cache(&cache, parser)) {
+            record_timer_count("nodes", parser->node_count);
+            set_stat(STAT_NODES, parser->node_count);
+        }
+        else {
+            delete parser;
+            parser = nullptr;
+        }
+    }
+
+    if (!parser) {
+        parser = parse_source(source);
+
+        if (options.ast_cache && parser->error_count == 0) {
+            Scoped_Timer timer("ast cache");
+            write_ast_cache(&cache, parser);
+        }
+    }
+
+    if (parser->error_count == 0) {
+        Scoped_Timer timer("sema");
+        parser->error_count += check_translation_unit(parser->root);
+    }
+
+    delete parser->lexer;
+
+    // The dump walks the tree recursively, so a tree rejected for its depth is never printed.
+    if (options.dump_ast && !parser->too_deep) {
+        FILE* file = open_dump(options.dump_ast);
+        dump_translation_unit(file, parser->root);
+        close_dump(file);
+    }
+
+    flush_diagnostics();
+    if (parser->error_count != 0)
         fatal_error("compilation ended with %d error%s.\n", parser->error_count, (parser->error_count == 1) ? "" : "s");
-    end_debug_benchmark("backend");
+
+    begin_timer("passes");
+
+    begin_timer("inline");
+    inline_functions(parser->root);
+    end_timer();
+
+    begin_timer("tail calls");
+    eliminate_tail_calls(parser->root);
+    end_timer();
+
+    begin_timer("fold");
+    fold_translation_unit(parser->root);
+    end_timer();
+
+    begin_timer("bounds");
+    elide_bounds_checks(parser->root);
+    end_timer();
+
+    begin_timer("call graph");
+    eliminate_dead_functions(parser->root);
+    end_timer();
+
+    begin_timer("purity");
+    analyze_purity(parser->root);
+    end_timer();
+
+    end_timer();
+
+    // gcc runs in a child process, so only our side of the backend is counted.
+    begin_timer("backend");
+    begin_perf_phase("backend");
+    convert_transition_unit(options.obj_name, parser->root, &parser->extra_headers);
+    end_perf_phase(parser->node_count, "node");
+    end_timer();
 
     free_translation_unit(parser->root);
     delete parser;
+    if (options.ast_cache)
+        close_ast_cache(&cache);
+
+    // Diagnostics still need the text to find their lines.
+    flush_diagnostics();
+    source_manager.clear();
+}
+
+void report_time(const char* path) {
+    if (strcmp(path, "-") == 0) {
+        write_time_report(stdout);
+        return;
+    }
+
+    FILE* file = fopen(path, "w");
+    if (!file)
+        fatal_error("could not open time report '%s'.\n", path);
+    write_time_report(file);
+    fclose(file);
+}
+
+int main(int argc, char* argv[]) {
+    parse_options(argc, argv);
+
+    if (no_input_file()) 
+        fatal_error("No input files");
+    else if (no_obj_name()) 
+        fatal_error("No object name");
+
+    if (options.perf_counters)
+        open_perf_counters();
+    if (options.trace_file)
+        enable_trace(options.trace_file);
+
+    for (int i = 0; i < options.time_runs; i++) {
+        compile();
+        end_timer_run();
+    }
+
+    if (options.time_passes) {
+        report_pass_timings();
+        report_timers(stdout);
+    }
+    if (options.perf_counters)
+        report_perf_counters(stdout);
+    if (options.stats)
+        report_stats(stdout);
+    if (options.time_report)
+        report_time(options.time_report);
+
+    flush_diagnostics();
 
     return 0;
-}
\ No newline at end of file
+}
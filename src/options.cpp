@@ -0,0 +1,99 @@
+#include "../include/options.h"
+#include "../include/err.h"
+
+#include <string.h>
+#include <stdlib.h>
+
+Options options;
+
+void parse_options(int argc, char* argv[]) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+
+        if (strcmp(arg, "--dump-ir") == 0)
+            options.dump_ir = true;
+        else if (strcmp(arg, "--time-passes") == 0)
+            options.time_passes = true;
+        else if (strcmp(arg, "--time-report") == 0)
+            options.time_report = "-";
+        else if (strncmp(arg, "--time-report=", 14) == 0)
+            options.time_report = arg + 14;
+        else if (strncmp(arg, "--time-runs=", 12) == 0) {
+            options.time_runs = atoi(arg + 12);
+            if (options.time_runs <= 0)
+                fatal_error("invalid number of timing runs '%s'.\n", arg + 12);
+        }
+        else if (strncmp(arg, "--trace=", 8) == 0)
+            options.trace_file = arg + 8;
+        else if (strcmp(arg, "--dump-tokens") == 0)
+            options.dump_tokens = "-";
+        else if (strncmp(arg, "--dump-tokens=", 14) == 0)
+            options.dump_tokens = arg + 14;
+        else if (strcmp(arg, "--dump-ast") == 0)
+            options.dump_ast = "-";
+        else if (strncmp(arg, "--dump-ast=", 11) == 0)
+            options.dump_ast = arg + 11;
+        else if (strncmp(arg, "--max-errors=", 13) == 0) {
+            options.max_errors = atoi(arg + 13);
+            if (options.max_errors < 0)
+                fatal_error("invalid error limit '%s'.\n", arg + 13);
+            set_error_limit(options.max_errors);
+        }
+        else if (strncmp(arg, "--max-depth=", 12) == 0) {
+            options.max_depth = atoi(arg + 12);
+            if (options.max_depth <= 0)
+                fatal_error("invalid nesting limit '%s'.\n", arg + 12);
+        }
+        else if (strcmp(arg, "--stats") == 0)
+            options.stats = true;
+        else if (strcmp(arg, "--perf-counters") == 0)
+            options.perf_counters = true;
+        else if (strcmp(arg, "--emit-c") == 0)
+            options.emit_c = true;
+        else if (strcmp(arg, "--no-pch") == 0)
+            options.pch = false;
+        else if (strncmp(arg, "--cache-dir=", 12) == 0)
+            options.cache_dir = arg + 12;
+        else if (strcmp(arg, "--no-build-cache") == 0)
+            options.build_cache = false;
+        else if (strncmp(arg, "--cache-size=", 13) == 0) {
+            char* end;
+            long long megabytes = strtoll(arg + 13, &end, 10);
+            if (end == arg + 13 || *end || megabytes < 0)
+                fatal_error("invalid cache size '%s', expected megabytes.\n", arg + 13);
+            options.cache_size = (uint64_t) megabytes << 20;
+        }
+        else if (strcmp(arg, "--no-ast-cache") == 0)
+            options.ast_cache = false;
+        else if (strcmp(arg, "--no-ir") == 0)
+            options.use_ir = false;
+        else if (strcmp(arg, "--no-memoize") == 0)
+            options.auto_memoize = false;
+        else if (strncmp(arg, "--memo-size=", 12) == 0) {
+            options.memo_size = atoi(arg + 12);
+            if (options.memo_size <= 0)
+                fatal_error("invalid memo table size '%s'.\n", arg + 12);
+        }
+        else if (strcmp(arg, "--no-inline") == 0)
+            options.inline_functions = false;
+        else if (strncmp(arg, "--inline-budget=", 16) == 0) {
+            options.inline_budget = atoi(arg + 16);
+            if (options.inline_budget < 0)
+                fatal_error("invalid inline budget '%s'.\n", arg + 16);
+        }
+        else if (strcmp(arg, "--release") == 0) {
+            options.release = true;
+            options.bounds_checks = false;
+        }
+        else if (strcmp(arg, "--bounds-checks") == 0)
+            options.bounds_checks = true;
+        else if (arg[0] == '-' && arg[1] == '-')
+            fatal_error("unknown option '%s'.\n", arg);
+        else if (!options.input_file)
+            options.input_file = arg;
+        else if (!options.obj_name)
+            options.obj_name = arg;
+        else
+            fatal_error("unexpected argument '%s'.\n", arg);
+    }
+}
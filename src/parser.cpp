@@ -1,18 +1,20 @@
 #include "../include/parser.h"
 #include "../include/err.h"
+#include "../include/trace.h"
+#include "../include/options.h"
 
 #include <stdio.h>
+#include <ctype.h>
 
 Ast* Parser::default_ast(Ast* ast) {
-    ast->file = lexer->file;
-    ast->pos = peek()->pos;
-    ast->line = peek()->line;
+    ast->loc = peek()->loc;
+    node_count++;
 
     return ast;
 }
 
 #define AST_NEW(type) \
-    static_cast<type*>(default_ast(new type))
+    (track_allocation(MEM_AST, sizeof(type)), static_cast<type*>(default_ast(new type)))
 
 #define AST_DELETE(type) delete type
 
@@ -37,8 +39,10 @@ Token* Parser::peek_off(int off) {
 }
 
 void Parser::match(int type) {
-    if (peek()->type != type) 
-        report_error("Expected '%s' on line %d.\n", type_to_str(type), peek()->line);
+    if (peek()->type != type) {
+        report_error(peek()->loc, "Expected '%s'", type_to_str(type));
+        error_count++;
+    }
 
     next();
 }
@@ -64,7 +68,52 @@ Ast_Expression* Parser::parse_postfix_symbol() {
 }
 
 
+int64_t vector_lanes(Token* token) {
+    if (token->type != Tok::T_IDENTIFIER || strncmp(token->identifier, "vec", 3) != 0 || !token->identifier[3])
+        return 0;
+
+    int64_t lanes = 0;
+    for (const char* c = token->identifier + 3; *c; c++) {
+        if (!isdigit(*c) || lanes > 64)
+            return 0;
+        lanes = lanes * 10 + (*c - '0');
+    }
+    return lanes;
+}
+
+bool is_scalar_type_token(Token* token) {
+    switch (token->type) {
+    case Tok::T_INT:
+    case Tok::T_BYTE:
+    case Tok::T_LONG:
+    case Tok::T_FLOAT:
+    case Tok::T_DOUBLE:
+        return true;
+    default: break;
+    }
+    return false;
+}
+
 Ast_Expression* Parser::parse_primary_expression() {
+    if (vector_lanes(peek()) && is_scalar_type_token(peek_off(1))) {
+        auto vector = AST_NEW(Ast_Vector_Expression);
+        vector->vector = parse_vector_type();
+
+        match(Tok::T_LPAR);
+        while (peek()->type != Tok::T_RPAR && peek()->type != Tok::T_EOF) {
+            if (vector->arg_count == 64) {
+                report_error(peek()->loc, "too many lanes in vector");
+                error_count++;
+                break;
+            }
+            vector->args[vector->arg_count++] = parse_expression();
+            if (peek()->type != Tok::T_RPAR)
+                match(Tok::T_COMMA);
+        }
+        match(Tok::T_RPAR);
+        return vector;
+    }
+
     auto prime = AST_NEW(Ast_Primary_Expression);
 
     switch(peek()->type) {
@@ -73,6 +122,11 @@ Ast_Expression* Parser::parse_primary_expression() {
         prime->int_const = peek()->int_const;
         match(Tok::T_INT_CONST);     
         break;
+    case Tok::T_FLOAT_CONST:
+        prime->v_type = AST_FLOAT_P;
+        prime->float_const = peek()->float_const;
+        match(Tok::T_FLOAT_CONST);
+        break;
     case Tok::T_IDENTIFIER:
         if (peek_off(1)->type == Tok::T_LPAR) {
             prime->v_type = AST_CALL_P;
@@ -88,105 +142,279 @@ Ast_Expression* Parser::parse_primary_expression() {
         prime->char_const = peek()->char_const;
         match(Tok::T_CHAR_CONST);     
         break;
+    case Tok::T_NEW: {
+        AST_DELETE(prime);
+        auto alloc = AST_NEW(Ast_New_Expression);
+        match(Tok::T_NEW);
+        match(Tok::T_LBRACKET);
+        alloc->count = parse_expression();
+        match(Tok::T_RBRACKET);
+        alloc->element = parse_type();
+        match(Tok::T_IN);
+        alloc->arena = parse_primary_expression();
+        return alloc;
+    }
     default:
         return nullptr;
     }
     return prime;
 }
 
+Ast_Expression* Parser::parse_subscripts(Ast_Expression* expr) {
+    while (peek()->type == Tok::T_LBRACKET || peek()->type == Tok::T_DOT) {
+        if (peek()->type == Tok::T_LBRACKET) {
+            auto index = AST_NEW(Ast_Index_Expression);
+            match(Tok::T_LBRACKET);
+            index->base = expr;
+            index->index = parse_expression();
+            match(Tok::T_RBRACKET);
+            expr = index;
+        }
+        else {
+            auto field = AST_NEW(Ast_Field_Expression);
+            match(Tok::T_DOT);
+            field->base = expr;
+            field->field = parse_identity();
+            expr = field;
+        }
+    }
+    return expr;
+}
+
 Ast_Expression* Parser::parse_posfix_expression() {
-    auto prime = static_cast<Ast_Primary_Expression*>(parse_primary_expression());
-    if (prime) {
-        prime->expr = parse_postfix_symbol();
+    Ast_Expression* prime = parse_primary_expression();
+    if (!prime)
+        return prime;
+
+    Ast_Expression* expr = parse_subscripts(prime);
+
+    auto postfix = static_cast<Ast_Postfix_Expression*>(parse_postfix_symbol());
+    if (expr == prime && prime->type == AST_PRIMARY_EXPRESSION)
+        static_cast<Ast_Primary_Expression*>(prime)->expr = postfix;
+    else if (postfix && expr->type == AST_INDEX_EXPRESSION)
+        static_cast<Ast_Index_Expression*>(expr)->postfix = postfix->op;
+    else if (postfix) {
+        report_error(postfix->loc, "only variables and elements can be incremented");
+        error_count++;
     }
-    return prime;
+
+    return expr;
 }
 
-Ast_Expression* Parser::parse_unary_expression() {
-    auto unary = AST_NEW(Ast_Unary_Expression);
-    switch(peek()->type) {
-    case Tok::T_INC:
-        match(Tok::T_INC);
-        unary->op = AST_UNARY_INC;
-        break;
-    case Tok::T_DEC:
-        match(Tok::T_DEC);
-        unary->op = AST_UNARY_DEC;
-        break;
-    case Tok::T_LPAR:
-        match(Tok::T_LPAR);
-        unary->op = AST_UNARY_NESTED;
-        unary->nested_expr = parse_expression();
-        match(Tok::T_RPAR);
-        break;
-    case Tok::T_STAR:
-        match(Tok::T_STAR);
-        unary->op = AST_UNARY_DEREF;
-        break;
-    case Tok::T_AMBERSAND:
-        match(Tok::T_AMBERSAND);
-        unary->op = AST_UNARY_REF;
-        break;
-    default:
-        AST_DELETE(unary); 
-        return parse_posfix_expression();
+int prefix_operator(int token) {
+    switch(token) {
+    case Tok::T_INC:       return AST_UNARY_INC;
+    case Tok::T_DEC:       return AST_UNARY_DEC;
+    case Tok::T_LPAR:      return AST_UNARY_NESTED;
+    case Tok::T_STAR:      return AST_UNARY_DEREF;
+    case Tok::T_AMBERSAND: return AST_UNARY_REF;
+    default: break;
+    }
+
+    return -1;
+}
+
+int binary_operator(int token) {
+    switch(token) {
+    case Tok::T_STAR:          return AST_OPERATOR_MULTIPLICATIVE;
+    case Tok::T_SLASH:         return AST_OPERATOR_DIVISION;
+    case Tok::T_PERCENT:       return AST_OPERATOR_MODULO;
+    case Tok::T_PLUS:          return AST_OPERATOR_PLUS;
+    case Tok::T_MINUS:         return AST_OPERATOR_MINUS;
+    case Tok::T_COMPARE_EQUAL: return AST_OPERATOR_COMPARITIVE_EQUAL;
+    case Tok::T_NOT_EQUAL:     return AST_OPERATOR_COMPARITIVE_NOT_EQUAL;
+    case Tok::T_LTE:           return AST_OPERATOR_LTE;
+    case Tok::T_GTE:           return AST_OPERATOR_GTE;
+    case Tok::T_LARROW:        return AST_OPERATOR_LT;
+    case Tok::T_RARROW:        return AST_OPERATOR_GT;
+    default: break;
+    }
+
+    return -1;
+}
+
+int binary_precedence(int op) {
+    switch(op) {
+    case AST_OPERATOR_MULTIPLICATIVE:
+    case AST_OPERATOR_DIVISION:
+    case AST_OPERATOR_MODULO:
+        return 4;
+    case AST_OPERATOR_PLUS:
+    case AST_OPERATOR_MINUS:
+        return 3;
+    case AST_OPERATOR_LTE:
+    case AST_OPERATOR_GTE:
+    case AST_OPERATOR_LT:
+    case AST_OPERATOR_GT:
+        return 2;
+    case AST_OPERATOR_COMPARITIVE_EQUAL:
+    case AST_OPERATOR_COMPARITIVE_NOT_EQUAL:
+        return 1;
+    default: break;
+    }
+
+    return 0;
+}
+
+int subscript_count(Ast_Expression* expr) {
+    int count = 0;
+    while (expr && (expr->type == AST_INDEX_EXPRESSION || expr->type == AST_FIELD_EXPRESSION)) {
+        expr = (expr->type == AST_INDEX_EXPRESSION) ? static_cast<Ast_Index_Expression*>(expr)->base : static_cast<Ast_Field_Expression*>(expr)->base;
+        count++;
+    }
+    return count;
+}
+
+// Reports code nested past the limit once, so the later recursive passes never see it.
+bool Parser::check_depth(int depth) {
+    if (scope_depth + depth > deepest)
+        deepest = scope_depth + depth;
+    if (scope_depth + depth <= options.max_depth)
+        return true;
+
+    if (!too_deep) {
+        report_error(peek()->loc, "code is nested deeper than %d levels, the limit is set with --max-depth", options.max_depth);
+        error_count++;
+        too_deep = true;
     }
+    return false;
+}
 
-    unary->expr = parse_unary_expression();
-    return unary;
+// Steps over a bracketed group, or up to the token ending the current one, without building anything.
+void Parser::skip_nested() {
+    int depth = 0;
+    for (int type = peek()->type; type != Tok::T_EOF; type = peek()->type) {
+        if (type == Tok::T_LPAR || type == Tok::T_LBRACKET || type == Tok::T_LCURLY)
+            depth++;
+        else if (type == Tok::T_RPAR || type == Tok::T_RBRACKET || type == Tok::T_RCURLY) {
+            if (depth == 0)
+                return;
+            if (--depth == 0 && type == Tok::T_RCURLY) {
+                next();
+                return;
+            }
+        }
+        else if (depth == 0 && (type == Tok::T_SEMI || type == Tok::T_COMMA))
+            return;
+        next();
+    }
 }
 
+void Parser::push_operand(Ast_Expression* expr, int height) {
+    operands.push({ expr, height });
+    check_depth(height);
+}
+
+void Parser::reduce_prefix() {
+    Pending_Operand operand = operands.get(operands.top() - 1);
+    operands.pop();
+
+    auto unary = static_cast<Ast_Unary_Expression*>(operators.get(operators.top() - 1).node);
+    operators.pop();
+
+    unary->expr = operand.expr;
+    push_operand(unary, operand.height + 1);
+}
+
+void Parser::reduce_binary() {
+    Pending_Operand right = operands.get(operands.top() - 1);
+    operands.pop();
+    Pending_Operand left = operands.get(operands.top() - 1);
+    operands.pop();
+
+    auto bin = static_cast<Ast_Binary_Expression*>(operators.get(operators.top() - 1).node);
+    operators.pop();
+
+    bin->left = left.expr;
+    bin->right = right.expr;
+    push_operand(bin, (left.height > right.height + 1) ? left.height : right.height + 1);
+}
+
+// Operators and parentheses are kept on explicit stacks, so a long chain or deep nesting costs no native stack.
+// Only the sub-expressions inside calls, subscripts and 'new' recurse back in here.
 Ast_Expression* Parser::parse_expression() {
-    auto lexpr = parse_unary_expression();
-    auto expr = AST_NEW(Ast_Binary_Expression);
+    if (!check_depth(expression_depth + 1)) {
+        skip_nested();
+        return nullptr;
+    }
+    expression_depth++;
+
+    int outer_height = nested_height;
+    size_t operator_base = operators.top();
+    int open_parens = 0;
+
+    for (;;) {
+        for (int op = prefix_operator(peek()->type); op != -1; op = prefix_operator(peek()->type)) {
+            auto unary = AST_NEW(Ast_Unary_Expression);
+            unary->op = op;
+            match(peek()->type);
+
+            operators.push({ (op == AST_UNARY_NESTED) ? PENDING_PAREN : PENDING_PREFIX, unary });
+            if (op == AST_UNARY_NESTED)
+                open_parens++;
+            check_depth(operators.top() - operator_base);
+        }
 
-    switch(peek()->type) {
-    case Tok::T_STAR:
-        expr->op = AST_OPERATOR_MULTIPLICATIVE;
-        break;
-    case Tok::T_SLASH:
-        expr->op = AST_OPERATOR_DIVISION;
-        break;
-    case Tok::T_PERCENT:
-        expr->op = AST_OPERATOR_MODULO;
-        break;
-    case Tok::T_PLUS:
-        expr->op = AST_OPERATOR_PLUS;
-        break;
-    case Tok::T_MINUS:
-        expr->op = AST_OPERATOR_MINUS;
-        break;
-    case Tok::T_COMPARE_EQUAL:
-        expr->op = AST_OPERATOR_COMPARITIVE_EQUAL;
-        break;
-    case Tok::T_NOT_EQUAL:
-        expr->op = AST_OPERATOR_COMPARITIVE_NOT_EQUAL;
-        break;
-    case Tok::T_LTE:
-        expr->op = AST_OPERATOR_LTE;
-        break;
-    case Tok::T_GTE:
-        expr->op = AST_OPERATOR_GTE;
-        break;
-    case Tok::T_LARROW:
-        expr->op = AST_OPERATOR_LT;
-        break;
-    case Tok::T_RARROW:
-        expr->op = AST_OPERATOR_GT;
-        break;
-    default:
-        AST_DELETE(expr);
-        return lexpr;
+        nested_height = 0;
+        Ast_Expression* operand = parse_posfix_expression();
+        push_operand(operand, nested_height + subscript_count(operand) + 2);
+
+        int op = -1;
+        for (;;) {
+            while (operators.top() > operator_base && operators.get(operators.top() - 1).kind == PENDING_PREFIX)
+                reduce_prefix();
+
+            op = binary_operator(peek()->type);
+            if (op != -1 || open_parens == 0)
+                break;
+
+            // Whatever ends the group closes the innermost parenthesis, a missing ')' is reported by match.
+            while (operators.get(operators.top() - 1).kind == PENDING_BINARY)
+                reduce_binary();
+
+            Pending_Operand nested = operands.get(operands.top() - 1);
+            operands.pop();
+            auto paren = static_cast<Ast_Unary_Expression*>(operators.get(operators.top() - 1).node);
+            operators.pop();
+            open_parens--;
+
+            paren->nested_expr = nested.expr;
+            match(Tok::T_RPAR);
+
+            nested_height = 0;
+            Ast_Expression* group = parse_subscripts(paren);
+            int height = (nested.height > nested_height + 1) ? nested.height : nested_height + 1;
+            push_operand(group, height + subscript_count(group) + 1);
+        }
+
+        if (op == -1)
+            break;
+
+        while (operators.top() > operator_base && operators.get(operators.top() - 1).kind == PENDING_BINARY &&
+            binary_precedence(static_cast<Ast_Binary_Expression*>(operators.get(operators.top() - 1).node)->op) >= binary_precedence(op))
+            reduce_binary();
+
+        auto bin = AST_NEW(Ast_Binary_Expression);
+        bin->op = op;
+        match(peek()->type);
+        operators.push({ PENDING_BINARY, bin });
     }
 
-    match(peek()->type);
-    expr->left = lexpr;
-    expr->right = parse_expression();
+    while (operators.top() > operator_base)
+        reduce_binary();
 
-    return expr;
+    Pending_Operand result = operands.get(operands.top() - 1);
+    operands.pop();
+
+    expression_depth--;
+    nested_height = (outer_height > result.height) ? outer_height : result.height;
+    return result.expr;
 }
 
 Ast_Type* Parser::parse_type() {
+    if (vector_lanes(peek()))
+        return parse_vector_type();
+
     auto type_info = AST_NEW(Ast_Type);
 
     switch (peek()->type) {
@@ -198,13 +426,66 @@ Ast_Type* Parser::parse_type() {
         type_info->atom_type = AST_TYPE_BYTE;
         match(peek()->type);
         return type_info;
+    case Tok::T_LONG:
+        type_info->atom_type = AST_TYPE_LONG;
+        match(peek()->type);
+        return type_info;
+    case Tok::T_FLOAT:
+        type_info->atom_type = AST_TYPE_FLOAT;
+        match(peek()->type);
+        return type_info;
+    case Tok::T_DOUBLE:
+        type_info->atom_type = AST_TYPE_DOUBLE;
+        match(peek()->type);
+        return type_info;
+    case Tok::T_ARENA:
+        type_info->atom_type = AST_TYPE_ARENA;
+        match(peek()->type);
+        return type_info;
+    case Tok::T_IDENTIFIER:
+        type_info->atom_type = AST_TYPE_STRUCT;
+        type_info->name = parse_identity();
+        return type_info;
+    case Tok::T_POUND:
+        if (peek_off(1)->type != Tok::T_SOA) {
+            report_error(peek()->loc, "'#%s' is not a type attribute", token_to_str(peek_off(1)));
+            error_count++;
+            break;
+        }
+        match(Tok::T_POUND);
+        match(Tok::T_SOA);
+        AST_DELETE(type_info);
+        type_info = parse_type();
+        if (type_info)
+            type_info->soa = true;
+        return type_info;
     case Tok::T_CONST:
         match(Tok::T_CONST);
         type_info = parse_type();
-        type_info->constant = true;
+        if (type_info)
+            type_info->constant = true;
+        return type_info;
+    case Tok::T_LBRACKET:
+        match(Tok::T_LBRACKET);
+        if (peek()->type == Tok::T_RBRACKET)
+            type_info->atom_type = AST_TYPE_SLICE;
+        else {
+            type_info->atom_type = AST_TYPE_ARRAY;
+            type_info->length = peek()->int_const;
+            if (peek()->type != Tok::T_INT_CONST || type_info->length <= 0) {
+                report_error(peek()->loc, "array length must be a positive integer");
+                error_count++;
+            }
+            match(Tok::T_INT_CONST);
+        }
+        match(Tok::T_RBRACKET);
+
+        type_info->element = parse_type();
+        if (!type_info->element)
+            break;
         return type_info;
     default:
-        report_error("'%s' is not a valid type on line %d.\n", token_to_str(peek()), peek()->line);
+        report_error(peek()->loc, "'%s' is not a valid type", token_to_str(peek()));
         match(peek()->type);
         break;
     }
@@ -213,11 +494,31 @@ Ast_Type* Parser::parse_type() {
     return nullptr;
 }
 
+Ast_Type* Parser::parse_vector_type() {
+    auto type_info = AST_NEW(Ast_Type);
+    type_info->atom_type = AST_TYPE_VECTOR;
+    type_info->length = vector_lanes(peek());
+    match(Tok::T_IDENTIFIER);
+
+    if (!is_scalar_type_token(peek())) {
+        report_error(peek()->loc, "vector lanes must be 'int', 'byte', 'long', 'float' or 'double'");
+        error_count++;
+    }
+    type_info->element = parse_type();
+    if (!type_info->element) {
+        AST_DELETE(type_info);
+        return nullptr;
+    }
+    return type_info;
+}
+
 Ast_Ident* Parser::parse_identity() {
     auto id = AST_NEW(Ast_Ident);
 
     size_t id_len = strlen(peek()->identifier);
     char* name = (char *)calloc(1, id_len + 1);
+    track_allocation(MEM_STRINGS, id_len + 1);
+    count_stat(STAT_IDENTIFIERS);
     memcpy(name, peek()->identifier, id_len);
     id->name = name;
 
@@ -240,6 +541,15 @@ Ast* Parser::parse_statement() {
 
         return stmt;
     }
+    case Tok::T_BREAK:
+    case Tok::T_CONTINUE: {
+        auto stmt = AST_NEW(Ast_Statement);
+        stmt->flags |= (peek()->type == Tok::T_BREAK) ? AST_BREAK : AST_CONTINUE;
+        next();
+        match(Tok::T_SEMI);
+
+        return stmt;
+    }
     case Tok::T_IF: {
         match(Tok::T_IF);
         auto condition = AST_NEW(Ast_ControlFlow);
@@ -267,6 +577,22 @@ Ast* Parser::parse_statement() {
 
         return condition;
     }
+    case Tok::T_FOR:
+        return parse_for_statement(false);
+    case Tok::T_PARALLEL:
+        return parse_parallel_for();
+    case Tok::T_POUND: {
+        if (peek_off(1)->type != Tok::T_SIMD)
+            return parse_decleration();
+
+        match(Tok::T_POUND);
+        match(Tok::T_SIMD);
+        if (peek()->type != Tok::T_FOR) {
+            report_error(peek()->loc, "#simd must precede a for loop");
+            error_count++;
+        }
+        return parse_for_statement(true);
+    }
     case Tok::T_WHILE: {
         auto it = AST_NEW(Ast_ControlFlow);
         it->flag = AST_CONTROL_WHILE;
@@ -284,7 +610,101 @@ Ast* Parser::parse_statement() {
     return nullptr;
 }
 
+Ast_For* Parser::parse_for_statement(bool simd) {
+    auto loop = AST_NEW(Ast_For);
+    loop->simd = simd;
+
+    match(Tok::T_FOR);
+    loop->iterator = AST_NEW(Ast_Decleration);
+    loop->iterator->id = parse_identity();
+
+    match(Tok::T_IN);
+    loop->begin = parse_expression();
+    match(Tok::T_DOT_DOT);
+    loop->end = parse_expression();
+
+    // The iterator belongs to the body, so it is declared in the body's scope before it is parsed.
+    loop->scope.parent = current_scope;
+    current_scope = &loop->scope;
+    add_identifier_to_scope(loop->iterator);
+    current_scope = loop->scope.parent;
+
+    parse_scope(&loop->scope);
+
+    return loop;
+}
+
+Ast_For* Parser::parse_parallel_for() {
+    match(Tok::T_PARALLEL);
+
+    int64_t grain = 0;
+    Array<Ast_Reduction> reductions;
+    if (peek()->type == Tok::T_LPAR) {
+        match(Tok::T_LPAR);
+
+        while (peek()->type != Tok::T_RPAR && peek()->type != Tok::T_EOF) {
+            Token* key = peek();
+            match(Tok::T_IDENTIFIER);
+            match(Tok::T_COLON);
+
+            if (strcmp(key->identifier, "grain") == 0) {
+                grain = peek()->int_const;
+                if (peek()->type != Tok::T_INT_CONST || grain <= 0) {
+                    report_error(peek()->loc, "grain size must be a positive integer");
+                    error_count++;
+                }
+                match(Tok::T_INT_CONST);
+            }
+            else if (strcmp(key->identifier, "reduce") == 0) {
+                Ast_Reduction reduction;
+                if (peek()->type == Tok::T_PLUS)
+                    reduction.op = AST_REDUCE_ADD;
+                else if (peek()->type == Tok::T_IDENTIFIER && strcmp(peek()->identifier, "min") == 0)
+                    reduction.op = AST_REDUCE_MIN;
+                else if (peek()->type == Tok::T_IDENTIFIER && strcmp(peek()->identifier, "max") == 0)
+                    reduction.op = AST_REDUCE_MAX;
+                else {
+                    report_error(peek()->loc, "reduction must be '+', 'min' or 'max'");
+                    error_count++;
+                }
+                next();
+
+                reduction.ident = parse_identity();
+                reductions.push(reduction);
+            }
+            else {
+                report_error(key->loc, "unknown parallel option '%s'", key->identifier);
+                error_count++;
+            }
+
+            if (peek()->type == Tok::T_RPAR)
+                break;
+            match(Tok::T_COMMA);
+        }
+
+        match(Tok::T_RPAR);
+    }
+
+    if (peek()->type != Tok::T_FOR) {
+        report_error(peek()->loc, "parallel must precede a for loop");
+        error_count++;
+    }
+
+    auto loop = parse_for_statement(false);
+    loop->parallel = true;
+    loop->grain = grain;
+    loop->reductions = reductions;
+
+    return loop;
+}
+
 void Parser::parse_scope(Ast_Scope* scope) {
+    if (!check_depth(1)) {
+        skip_nested();
+        return;
+    }
+    scope_depth++;
+
     match(Tok::T_LCURLY);
 
     scope->parent = current_scope;
@@ -292,11 +712,12 @@ void Parser::parse_scope(Ast_Scope* scope) {
 
     while (peek()->type != Tok::T_RCURLY) {
         auto stmt = parse_statement();
-        scope->statements[scope->size++] = stmt;
+        scope->add(stmt);
     }
 
     match(Tok::T_RCURLY);
-    current_scope = scope->parent;    
+    current_scope = scope->parent;
+    scope_depth--;
 }
 
 Ast_Function_Definition* Parser::parse_function_decleration() {
@@ -333,7 +754,10 @@ Ast_Function_Definition* Parser::parse_function_decleration() {
 }
 
 Ast_Function_Definition* Parser::parse_function_definition() {
+    Scoped_Trace trace("parse", "function");
     auto func = parse_function_decleration();
+    if (trace_enabled)
+        rename_trace(func->id->name);
 
     if (peek()->type == Tok::T_LCURLY) 
         parse_scope(&func->scope);
@@ -341,11 +765,57 @@ Ast_Function_Definition* Parser::parse_function_definition() {
     return func;
 }
 
+Ast_Function_Definition* Parser::parse_memoize_attribute() {
+    match(Tok::T_POUND);
+    match(Tok::T_MEMOIZE);
+
+    int size = 0, prefill = 0;
+    if (peek()->type == Tok::T_LPAR) {
+        match(Tok::T_LPAR);
+
+        while (peek()->type != Tok::T_RPAR && peek()->type != Tok::T_EOF) {
+            Token* key = peek();
+            match(Tok::T_IDENTIFIER);
+            match(Tok::T_COLON);
+
+            int value = peek()->int_const;
+            match(Tok::T_INT_CONST);
+
+            if (strcmp(key->identifier, "size") == 0)
+                size = value;
+            else if (strcmp(key->identifier, "prefill") == 0)
+                prefill = value;
+            else {
+                report_error(key->loc, "unknown memoize option '%s'", key->identifier);
+                error_count++;
+            }
+
+            if (peek()->type == Tok::T_RPAR)
+                break;
+            match(Tok::T_COMMA);
+        }
+
+        match(Tok::T_RPAR);
+    }
+
+    if (!(peek()->type == Tok::T_IDENTIFIER && peek_off(1)->type == Tok::T_COLON && peek_off(2)->type == Tok::T_LPAR)) {
+        report_error(peek()->loc, "#memoize must precede a function definition");
+        error_count++;
+    }
+
+    auto func = parse_function_definition();
+    func->flags |= AST_FUNCTION_MEMOIZE;
+    func->memo_size = size;
+    func->memo_prefill = prefill;
+
+    return func;
+}
+
 Ast_Function_Call* Parser::parse_function_call() {
     auto e = root->scope.table.look_up(peek()->identifier);
 
     if (!e) {
-        report_error("undefined methods '%s' on line %d.\n", peek()->identifier, peek()->line);
+        report_error(peek()->loc, "undefined methods '%s'", peek()->identifier);
     }
 
     auto call = AST_NEW(Ast_Function_Call);
@@ -373,6 +843,9 @@ Ast_Decleration* Parser::parse_decleration() {
     if ((peek_off(1)->type == Tok::T_COLON && peek_off(2)->type == Tok::T_LPAR)) {
         return parse_function_definition();
     }
+    else if (peek_off(1)->type == Tok::T_COLON && peek_off(2)->type == Tok::T_STRUCT) {
+        return parse_struct_definition();
+    }
     else if (peek_off(1)->type == Tok::T_LPAR) {
         auto call = parse_function_call();
         match(Tok::T_SEMI);
@@ -396,6 +869,10 @@ Ast_Decleration* Parser::parse_decleration() {
             expr = &(*expr)->next;
         }
     }
+    else if(peek()->type == Tok::T_POUND && peek_off(1)->type == Tok::T_MEMOIZE) {
+        AST_DELETE(dec);
+        return parse_memoize_attribute();
+    }
     else if(peek()->type == Tok::T_POUND && peek_off(1)->type == Tok::T_FOREIGN) {
         match(Tok::T_POUND);
         match(Tok::T_FOREIGN);
@@ -417,12 +894,10 @@ Ast_Decleration* Parser::parse_decleration() {
     else {
         dec->type = AST_ASSIGNMENT;
 
-        dec->expr = parse_expression();
-        Ast_Expression** expr = &dec->expr->next;
-        while (peek()->type == Tok::T_EQUAL) {
+        Ast_Expression* link = dec->expr = parse_expression();
+        while (link && peek()->type == Tok::T_EQUAL) {
             match(Tok::T_EQUAL);
-            *expr = parse_expression();
-            expr = &(*expr)->next;
+            link = link->next = parse_expression();
         }
     }
 
@@ -432,6 +907,33 @@ Ast_Decleration* Parser::parse_decleration() {
     return dec;
 }
 
+Ast_Struct* Parser::parse_struct_definition() {
+    auto record = AST_NEW(Ast_Struct);
+    record->id = parse_identity();
+    match(Tok::T_COLON);
+    match(Tok::T_STRUCT);
+    match(Tok::T_LCURLY);
+
+    while (peek()->type != Tok::T_RCURLY && peek()->type != Tok::T_EOF) {
+        if (record->field_count == 64) {
+            report_error(peek()->loc, "struct '%s' has too many fields", record->id->name);
+            error_count++;
+            break;
+        }
+
+        auto field = AST_NEW(Ast_Decleration);
+        field->id = parse_identity();
+        match(Tok::T_COLON);
+        field->type_info = parse_type();
+        match(Tok::T_SEMI);
+        record->fields[record->field_count++] = field;
+    }
+    match(Tok::T_RCURLY);
+
+    add_identifier_to_scope(record);
+    return record;
+}
+
 void Parser::add_identifier_to_scope(Ast_Decleration* dec) {
     if (!dec->id)
         return;
@@ -448,16 +950,16 @@ void Parser::add_identifier_to_scope(Ast_Decleration* dec) {
         c = c->parent;
     }
 
-    if (e && dec->type == AST_DECLERATION)  {
-        report_error("redecleration of identifier '%s' on line %d.\n", dec->id->name, dec->id->line);
+    if (e && (dec->type == AST_DECLERATION || dec->type == AST_STRUCT))  {
+        report_error(dec->id->loc, "redecleration of identifier '%s'", dec->id->name);
         error_count++;
     }
 
     if (!e) {
-        if (dec->type == AST_DECLERATION || dec->type == AST_FUNCTION_DEFINITION) 
+        if (dec->type == AST_DECLERATION || dec->type == AST_FUNCTION_DEFINITION || dec->type == AST_STRUCT) 
             current_scope->table.insert(dec->id->name, Tok::T_IDENTIFIER);
         else {
-            report_error("undeclared identifier '%s' on line %d.\n", dec->id->name, dec->id->line);
+            report_error(dec->id->loc, "undeclared identifier '%s'", dec->id->name);
             error_count++;
         }
     }    
@@ -470,7 +972,7 @@ void Parser::run() {
     while (peek()->type != Tok::T_EOF) {
         auto dec = parse_decleration();
 
-        root->scope.statements[root->scope.size++] = dec;
+        root->scope.add(dec);
     }
 }
 
@@ -0,0 +1,157 @@
+#include "../include/perf.h"
+#include "../include/err.h"
+
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+static const char* counter_names[PERF_COUNTER_COUNT] = { "cycles", "instructions", "cache-misses", "branch-misses" };
+
+static int counter_fds[PERF_COUNTER_COUNT] = { -1, -1, -1, -1 };
+static bool counters_open = false;
+
+static Perf_Phase phases[MAX_PERF_PHASES];
+static int phase_count = 0;
+static Perf_Phase* active = nullptr;
+
+#ifdef __linux__
+static int open_counter(uint64_t config) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    return (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+#endif
+
+bool open_perf_counters() {
+#ifdef __linux__
+    static const uint64_t configs[PERF_COUNTER_COUNT] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES
+    };
+
+    int error = 0;
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        counter_fds[i] = open_counter(configs[i]);
+        if (counter_fds[i] < 0)
+            error = errno;
+        else
+            counters_open = true;
+    }
+
+    if (!counters_open)
+        report_warning(0, "hardware performance counters are unavailable (%s), only wall time will be measured", strerror(error));
+    return counters_open;
+#else
+    report_warning(0, "hardware performance counters are only supported on linux");
+    return false;
+#endif
+}
+
+static Perf_Phase* find_phase(const char* label) {
+    for (int i = 0; i < phase_count; i++) {
+        if (strcmp(phases[i].label, label) == 0)
+            return &phases[i];
+    }
+
+    if (phase_count == MAX_PERF_PHASES)
+        fatal_error("too many counted phases, the limit is %d.\n", MAX_PERF_PHASES);
+
+    phases[phase_count].label = label;
+    return &phases[phase_count++];
+}
+
+void begin_perf_phase(const char* label) {
+#ifdef __linux__
+    if (!counters_open || active)
+        return;
+
+    active = find_phase(label);
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        if (counter_fds[i] < 0)
+            continue;
+        ioctl(counter_fds[i], PERF_EVENT_IOC_RESET, 0);
+        ioctl(counter_fds[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+}
+
+void end_perf_phase(uint64_t units, const char* unit) {
+#ifdef __linux__
+    if (!active)
+        return;
+
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        if (counter_fds[i] >= 0)
+            ioctl(counter_fds[i], PERF_EVENT_IOC_DISABLE, 0);
+    }
+
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        uint64_t data[3];
+        if (counter_fds[i] < 0 || read(counter_fds[i], data, sizeof(data)) != sizeof(data))
+            continue;
+
+        // Scale up when the kernel had to multiplex the counters.
+        double value = (double) data[0];
+        if (data[2] > 0 && data[2] < data[1])
+            value *= (double) data[1] / (double) data[2];
+        active->values[i] += value;
+    }
+
+    active->unit = unit;
+    active->units += units;
+    active->samples++;
+    active = nullptr;
+#endif
+}
+
+static void print_count(FILE* file, int counter, double value, int width, int precision) {
+    if (counter_fds[counter] < 0)
+        fprintf(file, " %*s", width, "-");
+    else
+        fprintf(file, " %*.*f", width, precision, value);
+}
+
+void report_perf_counters(FILE* file) {
+    if (!counters_open)
+        return;
+
+    fprintf(file, "perf: %-14s", "phase");
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++)
+        fprintf(file, " %14s", counter_names[i]);
+    fprintf(file, " %6s\n", "ipc");
+
+    for (int i = 0; i < phase_count; i++) {
+        Perf_Phase* phase = &phases[i];
+        double* values = phase->values;
+
+        // Counts are averaged over runs, ratios are taken over everything.
+        fprintf(file, "perf: %-14s", phase->label);
+        for (int j = 0; j < PERF_COUNTER_COUNT; j++)
+            print_count(file, j, values[j] / phase->samples, 14, 0);
+        if (counter_fds[PERF_CYCLES] >= 0 && counter_fds[PERF_INSTRUCTIONS] >= 0 && values[PERF_CYCLES] > 0)
+            fprintf(file, " %6.2f\n", values[PERF_INSTRUCTIONS] / values[PERF_CYCLES]);
+        else
+            fprintf(file, " %6s\n", "-");
+
+        if (phase->units == 0)
+            continue;
+
+        fprintf(file, "perf:   per %-8s", phase->unit);
+        for (int j = 0; j < PERF_COUNTER_COUNT; j++)
+            print_count(file, j, values[j] / (double) phase->units, 14, 3);
+        fprintf(file, "\n");
+    }
+}
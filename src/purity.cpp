@@ -0,0 +1,189 @@
+#include "../include/purity.h"
+#include "../include/sema.h"
+#include "../include/err.h"
+#include "../include/options.h"
+
+bool Purity::is_mutable_global(Ast_Decleration* dec) {
+    if (dec->type_info && dec->type_info->constant)
+        return false;
+
+    for (int i = 0; i < globals.top(); i++) {
+        if (globals.get(i) == dec)
+            return true;
+    }
+    return false;
+}
+
+void Purity::visit_expression(Ast_Expression* expr) {
+    while (expr && pure) {
+        switch (expr->type) {
+        case AST_BINARY_EXPRESSION: {
+            auto bin = static_cast<Ast_Binary_Expression*>(expr);
+            for (; left_link(bin); bin = left_link(bin))
+                visit_expression(bin->right);
+            visit_expression(bin->left);
+            visit_expression(bin->right);
+            break;
+        }
+        case AST_UNARY_EXPESSION: {
+            auto unary = static_cast<Ast_Unary_Expression*>(expr);
+            if (unary->op == AST_UNARY_DEREF || unary->op == AST_UNARY_REF)
+                pure = false;
+            visit_expression(unary->nested_expr);
+            visit_expression(unary->expr);
+            break;
+        }
+        case AST_PRIMARY_EXPRESSION: {
+            auto prime = static_cast<Ast_Primary_Expression*>(expr);
+            if (prime->v_type == AST_ID_P) {
+                // A mutable global read makes the result depend on more than the arguments.
+                if (!prime->ident->decleration || is_mutable_global(prime->ident->decleration))
+                    pure = false;
+            }
+            else if (prime->v_type == AST_CALL_P)
+                visit_function_call(prime->call);
+            break;
+        }
+        case AST_INDEX_EXPRESSION: {
+            auto index = static_cast<Ast_Index_Expression*>(expr);
+            visit_expression(index->base);
+            visit_expression(index->index);
+            break;
+        }
+        case AST_FIELD_EXPRESSION:
+            // An arena's mark moves with every allocation.
+            if (is_arena_mark(expr))
+                pure = false;
+            visit_expression(static_cast<Ast_Field_Expression*>(expr)->base);
+            break;
+        case AST_NEW_EXPRESSION: {
+            auto alloc = static_cast<Ast_New_Expression*>(expr);
+            pure = false;
+            visit_expression(alloc->count);
+            visit_expression(alloc->arena);
+            break;
+        }
+        case AST_VECTOR_EXPRESSION: {
+            auto vector = static_cast<Ast_Vector_Expression*>(expr);
+            for (int i = 0; i < vector->arg_count; i++)
+                visit_expression(vector->args[i]);
+            break;
+        }
+        }
+
+        expr = expr->next;
+    }
+}
+
+void Purity::visit_function_call(Ast_Function_Call* call) {
+    auto callee = static_cast<Ast_Function_Definition*>(call->id->decleration);
+
+    if (!callee || callee->from || !(callee->flags & AST_FUNCTION_PURE))
+        pure = false;
+    if (callee == current)
+        recursive = true;
+
+    for (int i = 0; i < call->arg_count; i++)
+        visit_expression(call->args[i]);
+}
+
+void Purity::visit_statement(Ast* ast) {
+    switch (ast->type) {
+    case AST_STATEMENT:
+        visit_expression(static_cast<Ast_Statement*>(ast)->expr);
+        break;
+    case AST_CONDITION: {
+        auto condition = static_cast<Ast_ControlFlow*>(ast);
+        while (condition) {
+            visit_expression(condition->condition);
+            visit_scope(&condition->scope);
+            condition = condition->next;
+        }
+        break;
+    }
+    case AST_FOR: {
+        auto loop = static_cast<Ast_For*>(ast);
+        visit_expression(loop->begin);
+        visit_expression(loop->end);
+        visit_scope(&loop->scope);
+        break;
+    }
+    case AST_DECLERATION:
+    case AST_ASSIGNMENT:
+        visit_expression(static_cast<Ast_Decleration*>(ast)->expr);
+        break;
+    case AST_FUNCTION_CALL:
+        visit_function_call(static_cast<Ast_Function_Call*>(ast));
+        break;
+    default:
+        pure = false;
+        break;
+    }
+}
+
+void Purity::visit_scope(Ast_Scope* scope) {
+    for (int i = 0; i < scope->size && pure; i++)
+        visit_statement(scope->statements[i]);
+}
+
+bool Purity::check_function(Ast_Function_Definition* func) {
+    current = func;
+    pure = true;
+    recursive = false;
+
+    for (int i = 0; i < func->arg_count; i++) {
+        Ast_Type* type = func->args[i]->type_info;
+        if (!type || !(is_integral_type(type) || is_floating_type(type)))
+            pure = false;
+    }
+
+    visit_scope(&func->scope);
+    return pure;
+}
+
+void analyze_purity(Ast_Translation_Unit* root) {
+    Purity purity;
+    Array<Ast_Function_Definition*> functions;
+
+    for (int i = 0; i < root->scope.size; i++) {
+        Ast* ast = root->scope.statements[i];
+        if (ast->type == AST_DECLERATION)
+            purity.globals.push(static_cast<Ast_Decleration*>(ast));
+        else if (ast->type == AST_FUNCTION_DEFINITION && !static_cast<Ast_Function_Definition*>(ast)->from)
+            functions.push(static_cast<Ast_Function_Definition*>(ast));
+    }
+
+    // Optimistically assume every function is pure and strip the flag until nothing changes,
+    // so that recursive functions can depend on themselves.
+    for (int i = 0; i < functions.top(); i++)
+        functions.get(i)->flags |= AST_FUNCTION_PURE;
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int i = 0; i < functions.top(); i++) {
+            Ast_Function_Definition* func = functions.get(i);
+            if ((func->flags & AST_FUNCTION_PURE) && !purity.check_function(func)) {
+                func->flags &= ~AST_FUNCTION_PURE;
+                changed = true;
+            }
+        }
+    }
+
+    for (int i = 0; i < functions.top(); i++) {
+        Ast_Function_Definition* func = functions.get(i);
+        bool pure = (func->flags & AST_FUNCTION_PURE) && func->type_info && func->arg_count > 0;
+
+        if (func->flags & AST_FUNCTION_MEMOIZE) {
+            if (pure)
+                func->flags |= AST_FUNCTION_MEMOIZED;
+            else
+                report_warning(func->loc, "'%s' is not a pure function with scalar arguments and a result, ignoring #memoize", func->id->name);
+            continue;
+        }
+
+        purity.check_function(func);
+        if (pure && purity.recursive && options.auto_memoize)
+            func->flags |= AST_FUNCTION_MEMOIZED;
+    }
+}
@@ -0,0 +1,1042 @@
+#include "../include/sema.h"
+#include "../include/err.h"
+#include "../include/hash.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+
+#define SEMA_MESSAGE_SIZE 512
+
+#define INITIAL_NAME_SLOTS 256
+#define INITIAL_TYPE_SLOTS 64
+
+static Array<Ast_Type*> canonical_types;
+
+// Open addressed by the shape of a type, each slot holds its index in canonical_types plus one.
+static uint32_t* type_slots = nullptr;
+static uint32_t type_mask = 0;
+
+static uint32_t type_hash(int atom_type, bool constant, Ast_Type* element, int64_t length, Ast_Struct* record, bool soa) {
+    // Types are looked up for nearly every expression, so this is a couple of multiplies rather than FNV.
+    uint64_t h = (uint64_t) atom_type | ((uint64_t) constant << 8) | ((uint64_t) soa << 9);
+    h = (h ^ (uint64_t) (uintptr_t) element) * 0x9E3779B97F4A7C15ULL;
+    h = (h ^ (uint64_t) length ^ (uint64_t) (uintptr_t) record) * 0x9E3779B97F4A7C15ULL;
+    return (uint32_t) (h >> 32);
+}
+
+static void insert_type_slot(Ast_Type* type, uint32_t index) {
+    uint32_t slot = type_hash(type->atom_type, type->constant, type->element, type->length, type->record, type->soa) & type_mask;
+    while (type_slots[slot])
+        slot = (slot + 1) & type_mask;
+    type_slots[slot] = index + 1;
+}
+
+Ast_Type* composite_type(int atom_type, bool constant, Ast_Type* element, int64_t length, Ast_Struct* record = nullptr, bool soa = false) {
+    if (type_slots) {
+        uint32_t slot = type_hash(atom_type, constant, element, length, record, soa) & type_mask;
+        for (; type_slots[slot]; slot = (slot + 1) & type_mask) {
+            Ast_Type* type = canonical_types.get(type_slots[slot] - 1);
+            if (type->atom_type == atom_type && type->constant == constant && type->element == element && type->length == length && type->record == record && type->soa == soa)
+                return type;
+        }
+    }
+
+    auto type = new Ast_Type;
+    track_allocation(MEM_AST, sizeof(Ast_Type));
+    type->loc = 0;
+    type->atom_type = atom_type;
+    type->constant = constant;
+    type->element = element;
+    type->length = length;
+    type->record = record;
+    type->soa = soa;
+    if (record)
+        type->name = record->id;
+
+    canonical_types.push(type);
+
+    // Kept at most half full.
+    if (canonical_types.top() * 2 > type_mask) {
+        uint32_t count = (type_mask) ? (type_mask + 1) * 2 : INITIAL_TYPE_SLOTS;
+        free(type_slots);
+        type_slots = (uint32_t*) calloc(count, sizeof(uint32_t));
+        type_mask = count - 1;
+        for (int i = 0; i < canonical_types.top(); i++)
+            insert_type_slot(canonical_types.get(i), i);
+    }
+    else
+        insert_type_slot(type, canonical_types.top() - 1);
+
+    return type;
+}
+
+Array<Ast_Type*>* interned_types() {
+    return &canonical_types;
+}
+
+Ast_Type* canonical_type(int atom_type, bool constant) {
+    return composite_type(atom_type, constant, nullptr, 0);
+}
+
+Ast_Type* canonical_type(Ast_Type* type) {
+    if (!type)
+        return nullptr;
+    return composite_type(type->atom_type, type->constant, canonical_type(type->element), type->length, type->record, type->soa);
+}
+
+Ast_Type* unqualified_type(Ast_Type* type) {
+    if (!type)
+        return nullptr;
+    return composite_type(type->atom_type, false, canonical_type(type->element), type->length, type->record, type->soa);
+}
+
+const char* type_name(Ast_Type* type) {
+    switch (type->atom_type) {
+    case AST_TYPE_INT:    return "int";
+    case AST_TYPE_BYTE:   return "byte";
+    case AST_TYPE_LONG:   return "long";
+    case AST_TYPE_FLOAT:  return "float";
+    case AST_TYPE_DOUBLE: return "double";
+    case AST_TYPE_VOID:   return "void";
+    case AST_TYPE_ARRAY:  return "array";
+    case AST_TYPE_SLICE:  return "slice";
+    case AST_TYPE_ARENA:  return "arena";
+    case AST_TYPE_VECTOR: return "vector";
+    case AST_TYPE_STRUCT: return (type->name) ? type->name->name : "struct";
+    default: break;
+    }
+
+    return "unknown";
+}
+
+bool is_integral_type(Ast_Type* type) {
+    return (type->atom_type == AST_TYPE_INT || type->atom_type == AST_TYPE_BYTE || type->atom_type == AST_TYPE_LONG);
+}
+
+bool is_floating_type(Ast_Type* type) {
+    return (type->atom_type == AST_TYPE_FLOAT || type->atom_type == AST_TYPE_DOUBLE);
+}
+
+bool is_arena_mark(Ast_Expression* expr) {
+    if (expr->type != AST_FIELD_EXPRESSION)
+        return false;
+
+    auto field = static_cast<Ast_Field_Expression*>(expr);
+    return (field->base->type_info && field->base->type_info->atom_type == AST_TYPE_ARENA && strcmp(field->field->name, "mark") == 0);
+}
+
+bool is_composite_type(Ast_Type* type) {
+    return (type->atom_type == AST_TYPE_ARRAY || type->atom_type == AST_TYPE_SLICE || type->atom_type == AST_TYPE_ARENA || type->atom_type == AST_TYPE_VECTOR || type->atom_type == AST_TYPE_STRUCT);
+}
+
+int64_t type_size(Ast_Type* type) {
+    switch (type->atom_type) {
+    case AST_TYPE_BYTE:   return 1;
+    case AST_TYPE_INT:    return 4;
+    case AST_TYPE_LONG:   return 8;
+    case AST_TYPE_FLOAT:  return 4;
+    case AST_TYPE_DOUBLE: return 8;
+    case AST_TYPE_ARRAY:
+    case AST_TYPE_VECTOR:
+        return type->length * type_size(type->element);
+    default: break;
+    }
+
+    return 0;
+}
+
+Ast_Type* mask_type(Ast_Type* vector) {
+    // Comparing lanes yields all ones or all zeros in a signed integer lane of the same width.
+    int lane = AST_TYPE_LONG;
+    if (type_size(vector->element) == 1)
+        lane = AST_TYPE_BYTE;
+    else if (type_size(vector->element) == 4)
+        lane = AST_TYPE_INT;
+    return composite_type(AST_TYPE_VECTOR, false, canonical_type(lane), vector->length);
+}
+
+int arithmetic_rank(Ast_Type* type) {
+    switch (type->atom_type) {
+    case AST_TYPE_BYTE:   return 0;
+    case AST_TYPE_INT:    return 1;
+    case AST_TYPE_LONG:   return 2;
+    case AST_TYPE_FLOAT:  return 3;
+    case AST_TYPE_DOUBLE: return 4;
+    default: break;
+    }
+
+    return -1;
+}
+
+Ast_Type* arithmetic_type(Ast_Type* left, Ast_Type* right) {
+    // Mirrors the usual arithmetic conversions of the emitted C: nothing narrower than int survives.
+    Ast_Type* result = canonical_type(AST_TYPE_INT);
+    if (arithmetic_rank(left) > arithmetic_rank(result))
+        result = left;
+    if (arithmetic_rank(right) > arithmetic_rank(result))
+        result = right;
+
+    return canonical_type(result->atom_type);
+}
+
+uint32_t Sema::find_name(const char* name) {
+    uint32_t slot = (uint32_t) hash_string(name) & name_mask;
+    while (names[slot].name && strcmp(names[slot].name, name) != 0)
+        slot = (slot + 1) & name_mask;
+    return slot;
+}
+
+uint32_t Sema::insert_name(const char* name) {
+    if ((name_count + 1) * 2 > name_mask) {
+        Sema_Name* old_names = names;
+        uint32_t old_count = (names) ? name_mask + 1 : 0;
+
+        uint32_t count = (old_count) ? old_count * 2 : INITIAL_NAME_SLOTS;
+        names = (Sema_Name*) calloc(count, sizeof(Sema_Name));
+        name_mask = count - 1;
+
+        // Bindings point at their slot, so they follow the names to the new table.
+        for (uint32_t i = 0; i < old_count; i++) {
+            if (old_names[i].name)
+                names[find_name(old_names[i].name)] = old_names[i];
+        }
+        for (int i = 0; i < bindings.top(); i++)
+            bindings.get_arr()[i].slot = find_name(bindings.get(i).name);
+        free(old_names);
+    }
+
+    uint32_t slot = find_name(name);
+    if (!names[slot].name) {
+        names[slot].name = name;
+        names[slot].binding = -1;
+        name_count++;
+    }
+    return slot;
+}
+
+Ast_Decleration* Sema::look_up(const char* name) {
+    if (!names)
+        return nullptr;
+
+    uint32_t slot = find_name(name);
+    if (!names[slot].name || names[slot].binding < 0)
+        return nullptr;
+    return bindings.get(names[slot].binding).dec;
+}
+
+void Sema::bind(Ast_Decleration* dec) {
+    if (!dec->id)
+        return;
+
+    uint32_t slot = insert_name(dec->id->name);
+    bindings.push({ dec->id->name, dec, slot, names[slot].binding });
+    names[slot].binding = (int) bindings.top() - 1;
+}
+
+void Sema::unbind(size_t marker) {
+    while (bindings.top() > marker) {
+        const Sema_Binding& binding = bindings.get(bindings.top() - 1);
+        names[binding.slot].binding = binding.shadowed;
+        bindings.pop();
+    }
+}
+
+// Only the bindings of the same name can be this declaration.
+int Sema::binding_of(Ast_Decleration* dec) {
+    if (!dec->id || !names)
+        return -1;
+
+    uint32_t slot = find_name(dec->id->name);
+    if (!names[slot].name)
+        return -1;
+
+    for (int i = names[slot].binding; i >= 0; i = bindings.get(i).shadowed) {
+        if (bindings.get(i).dec == dec)
+            return i;
+    }
+    return -1;
+}
+
+void Sema::capture(Ast* at, Ast_Decleration* dec, bool write) {
+    int index = binding_of(dec);
+    if (!parallel_loop || index < 0 || index >= (int) parallel_marker)
+        return;
+
+    // Reductions get a private copy per chunk, everything else declared outside the loop is shared.
+    for (int i = 0; i < parallel_loop->reductions.top(); i++) {
+        if (parallel_loop->reductions.get(i).ident->decleration == dec)
+            return;
+    }
+
+    if (write) {
+        error(at, "cannot assign to shared variable '%s' inside a parallel loop, use a reduction", dec->id->name);
+        return;
+    }
+    if (dec->type_info && dec->type_info->atom_type == AST_TYPE_ARENA) {
+        error(at, "arena '%s' cannot be shared with a parallel loop, declare one inside it", dec->id->name);
+        return;
+    }
+
+    if (index < (int) function_marker)
+        return;
+    for (int i = 0; i < parallel_loop->captures.top(); i++) {
+        if (parallel_loop->captures.get(i) == dec)
+            return;
+    }
+    parallel_loop->captures.push(dec);
+}
+
+void Sema::error(Ast* at, const char* fmt, ...) {
+    char message[SEMA_MESSAGE_SIZE];
+
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(message, SEMA_MESSAGE_SIZE, fmt, args);
+    va_end(args);
+
+    report_error(at->loc, "%s", message);
+    error_count++;
+}
+
+bool Sema::is_lvalue(Ast_Expression* expr) {
+    switch (expr->type) {
+    case AST_PRIMARY_EXPRESSION: {
+        auto prime = static_cast<Ast_Primary_Expression*>(expr);
+        return (prime->v_type == AST_ID_P && !prime->expr);
+    }
+    case AST_UNARY_EXPESSION: {
+        auto unary = static_cast<Ast_Unary_Expression*>(expr);
+        if (unary->op == AST_UNARY_DEREF)
+            return true;
+        if (unary->op == AST_UNARY_NESTED)
+            return is_lvalue(unary->nested_expr);
+        break;
+    }
+    case AST_INDEX_EXPRESSION: {
+        auto index = static_cast<Ast_Index_Expression*>(expr);
+        return (index->postfix == AST_UNARY_NONE && (is_lvalue(index->base) || (index->base->type_info && index->base->type_info->atom_type == AST_TYPE_SLICE)));
+    }
+    case AST_FIELD_EXPRESSION: {
+        auto field = static_cast<Ast_Field_Expression*>(expr);
+        if (field->member)
+            return is_lvalue(field->base);
+        return is_arena_mark(expr);
+    }
+    case AST_VECTOR_EXPRESSION:
+        return (static_cast<Ast_Vector_Expression*>(expr)->form == AST_VECTOR_LOAD);
+    }
+
+    return false;
+}
+
+bool Sema::is_constant_storage(Ast_Expression* expr) {
+    // Elements of a slice are always writable, elements of an array inherit its constness.
+    switch (expr->type) {
+    case AST_PRIMARY_EXPRESSION: {
+        auto prime = static_cast<Ast_Primary_Expression*>(expr);
+        if (prime->v_type != AST_ID_P)
+            return false;
+        auto ident = prime->ident;
+        return (ident->decleration && ident->decleration->type_info && ident->decleration->type_info->constant);
+    }
+    case AST_UNARY_EXPESSION:
+        return is_constant_storage(static_cast<Ast_Unary_Expression*>(expr)->nested_expr);
+    case AST_INDEX_EXPRESSION: {
+        auto index = static_cast<Ast_Index_Expression*>(expr);
+        if (index->base->type_info && index->base->type_info->atom_type == AST_TYPE_SLICE)
+            return false;
+        return is_constant_storage(index->base);
+    }
+    case AST_VECTOR_EXPRESSION: {
+        auto vector = static_cast<Ast_Vector_Expression*>(expr);
+        return (vector->form == AST_VECTOR_LOAD && is_constant_storage(vector->args[0]));
+    }
+    case AST_FIELD_EXPRESSION:
+        return is_constant_storage(static_cast<Ast_Field_Expression*>(expr)->base);
+    }
+
+    return false;
+}
+
+void Sema::check_assignable(Ast_Expression* target) {
+    if (!is_lvalue(target)) {
+        error(target, "expression is not assignable");
+        return;
+    }
+
+    if (target->type == AST_PRIMARY_EXPRESSION) {
+        auto ident = static_cast<Ast_Primary_Expression*>(target)->ident;
+        if (ident->decleration && ident->decleration->type_info && ident->decleration->type_info->constant)
+            error(target, "cannot assign to constant '%s'", ident->name);
+        else if (ident->decleration)
+            capture(target, ident->decleration, true);
+    }
+    else if (target->type == AST_INDEX_EXPRESSION && is_constant_storage(target))
+        error(target, "cannot assign to an element of a constant array");
+    else if (target->type == AST_VECTOR_EXPRESSION && is_constant_storage(target))
+        error(target, "cannot store a vector into a constant array");
+    else if (target->type == AST_FIELD_EXPRESSION && is_constant_storage(target))
+        error(target, "cannot assign to a field of a constant");
+    else if (target->type == AST_FIELD_EXPRESSION) {
+        // Writing a field writes the struct variable it belongs to.
+        Ast_Expression* root = target;
+        while (root->type == AST_FIELD_EXPRESSION)
+            root = static_cast<Ast_Field_Expression*>(root)->base;
+        if (root->type == AST_PRIMARY_EXPRESSION && static_cast<Ast_Primary_Expression*>(root)->v_type == AST_ID_P) {
+            Ast_Ident* ident = static_cast<Ast_Primary_Expression*>(root)->ident;
+            if (ident->decleration)
+                capture(target, ident->decleration, true);
+        }
+    }
+
+    if (target->type_info && target->type_info->atom_type == AST_TYPE_ARRAY)
+        error(target, "arrays cannot be assigned, copy them element by element");
+    else if (target->type_info && target->type_info->atom_type == AST_TYPE_ARENA)
+        error(target, "arenas cannot be assigned");
+}
+
+void Sema::check_conversion(Ast* at, Ast_Type* from, Ast_Type* to) {
+    if (!from || !to)
+        return;
+
+    if (from->atom_type == AST_TYPE_VOID)
+        error(at, "void value used where '%s' was expected", type_name(to));
+    else if (is_composite_type(from) || is_composite_type(to)) {
+        // An array converts to a slice of its element type, anything else has to match exactly.
+        bool same = (unqualified_type(from) == unqualified_type(to));
+        bool decays = (from->atom_type == AST_TYPE_ARRAY && to->atom_type == AST_TYPE_SLICE && unqualified_type(from->element) == unqualified_type(to->element));
+        if (decays && from->soa)
+            error(at, "a #soa array cannot be converted to a slice");
+        else if (!same && !decays)
+            error(at, "cannot convert '%s' to '%s'", type_name(from), type_name(to));
+        else if (decays && is_constant_storage(static_cast<Ast_Expression*>(at)))
+            error(at, "a constant array cannot be converted to a writable slice");
+    }
+    else if (is_floating_type(from) && is_integral_type(to))
+        report_warning(at->loc, "implicit conversion from '%s' to '%s'", type_name(from), type_name(to));
+}
+
+// A chain is checked from its first operand up, the left type of each link is what the link below it gave.
+Ast_Type* Sema::check_binary_expression(Ast_Binary_Expression* bin) {
+    size_t base = chain.top();
+    push_chain(bin, &chain);
+
+    Ast_Type* left = check_expression(chain.get(chain.top() - 1)->left);
+    while (chain.top() > base) {
+        Ast_Binary_Expression* link = chain.get(chain.top() - 1);
+        chain.pop();
+
+        Ast_Type* right = check_expression(link->right);
+        left = check_binary_operator(link, left, right);
+        link->type_info = left;
+    }
+    return left;
+}
+
+Ast_Type* Sema::check_binary_operator(Ast_Binary_Expression* bin, Ast_Type* left, Ast_Type* right) {
+    if (!left || !right)
+        return nullptr;
+
+    if (left->atom_type == AST_TYPE_VOID || right->atom_type == AST_TYPE_VOID) {
+        error(bin, "void value used in expression");
+        return nullptr;
+    }
+
+    if (left->atom_type == AST_TYPE_VECTOR || right->atom_type == AST_TYPE_VECTOR)
+        return check_vector_binary_expression(bin, left, right);
+
+    if (is_composite_type(left) || is_composite_type(right)) {
+        error(bin, "operands must be numbers, not '%s' and '%s'", type_name(left), type_name(right));
+        return nullptr;
+    }
+
+    switch (bin->op) {
+    case AST_OPERATOR_MODULO:
+        if (!is_integral_type(left) || !is_integral_type(right)) {
+            error(bin, "operands of '%%' must be integers, not '%s' and '%s'", type_name(left), type_name(right));
+            return nullptr;
+        }
+        break;
+    case AST_OPERATOR_COMPARITIVE_EQUAL:
+    case AST_OPERATOR_COMPARITIVE_NOT_EQUAL:
+    case AST_OPERATOR_LTE:
+    case AST_OPERATOR_GTE:
+    case AST_OPERATOR_LT:
+    case AST_OPERATOR_GT:
+        return canonical_type(AST_TYPE_INT);
+    }
+
+    return arithmetic_type(left, right);
+}
+
+Ast_Type* Sema::check_vector_binary_expression(Ast_Binary_Expression* bin, Ast_Type* left, Ast_Type* right) {
+    // Lanes are never promoted, a scalar operand is converted to the lane type and broadcast.
+    Ast_Type* vector = (left->atom_type == AST_TYPE_VECTOR) ? left : right;
+    Ast_Type* other = (vector == left) ? right : left;
+
+    if (other->atom_type == AST_TYPE_VECTOR) {
+        if (unqualified_type(left) != unqualified_type(right)) {
+            error(bin, "vector operands must have the same lane type and count");
+            return nullptr;
+        }
+    }
+    else if (is_composite_type(other)) {
+        error(bin, "operands must be numbers, not '%s' and '%s'", type_name(left), type_name(right));
+        return nullptr;
+    }
+    else
+        check_conversion((vector == left) ? bin->right : bin->left, other, vector->element);
+
+    switch (bin->op) {
+    case AST_OPERATOR_MODULO:
+        if (!is_integral_type(vector->element)) {
+            error(bin, "operands of '%%' must have integer lanes, not '%s'", type_name(vector->element));
+            return nullptr;
+        }
+        break;
+    case AST_OPERATOR_COMPARITIVE_EQUAL:
+    case AST_OPERATOR_COMPARITIVE_NOT_EQUAL:
+    case AST_OPERATOR_LTE:
+    case AST_OPERATOR_GTE:
+    case AST_OPERATOR_LT:
+    case AST_OPERATOR_GT:
+        return mask_type(vector);
+    }
+
+    return unqualified_type(vector);
+}
+
+Ast_Type* Sema::check_unary_expression(Ast_Unary_Expression* unary) {
+    switch (unary->op) {
+    case AST_UNARY_NESTED:
+        return check_expression(unary->nested_expr);
+    case AST_UNARY_INC:
+    case AST_UNARY_DEC: {
+        Ast_Type* type = check_expression(unary->expr);
+        if (type)
+            check_assignable(unary->expr);
+        if (type && is_composite_type(type))
+            error(unary, "cannot increment a '%s'", type_name(type));
+        return type;
+    }
+    default:
+        // Pointers are not modelled yet, so '*' and '&' keep the type of their operand.
+        return check_expression(unary->expr);
+    }
+}
+
+Ast_Type* Sema::check_primary_expression(Ast_Primary_Expression* prime) {
+    switch (prime->v_type) {
+    case AST_INT_P:
+        // Literals past the range of 'int' are 'long', the same as in C.
+        return canonical_type((prime->int_const > INT32_MAX || prime->int_const < INT32_MIN) ? AST_TYPE_LONG : AST_TYPE_INT);
+    case AST_CHAR_P:
+        return canonical_type(AST_TYPE_BYTE);
+    case AST_FLOAT_P:
+        return canonical_type(AST_TYPE_DOUBLE);
+    case AST_ID_P: {
+        Ast_Decleration* dec = look_up(prime->ident->name);
+        if (!dec) {
+            error(prime, "undeclared identifier '%s'", prime->ident->name);
+            return nullptr;
+        }
+        if (dec->type == AST_FUNCTION_DEFINITION) {
+            error(prime, "function '%s' used as a value", prime->ident->name);
+            return nullptr;
+        }
+        if (dec->type == AST_STRUCT) {
+            error(prime, "struct '%s' used as a value", prime->ident->name);
+            return nullptr;
+        }
+
+        prime->ident->decleration = dec;
+        if (prime->expr && dec->type_info && dec->type_info->constant)
+            error(prime, "cannot modify constant '%s'", prime->ident->name);
+        else
+            capture(prime, dec, prime->expr != nullptr);
+
+        return unqualified_type(dec->type_info);
+    }
+    case AST_CALL_P:
+        return check_function_call(prime->call);
+    }
+
+    return nullptr;
+}
+
+Ast_Type* Sema::check_index_expression(Ast_Index_Expression* index) {
+    bool through_field = field_access;
+    field_access = false;
+
+    Ast_Type* base = check_expression(index->base);
+    Ast_Type* type = check_expression(index->index);
+
+    if (type && !is_integral_type(type))
+        error(index->index, "index must be an integer, not '%s'", type_name(type));
+
+    if (!base)
+        return nullptr;
+    if (base->atom_type != AST_TYPE_ARRAY && base->atom_type != AST_TYPE_SLICE && base->atom_type != AST_TYPE_VECTOR) {
+        error(index, "cannot index a '%s'", type_name(base));
+        return nullptr;
+    }
+    // The converter reads a slice twice, for its data and its length, so it has to be a plain variable.
+    if (base->atom_type == AST_TYPE_SLICE && (index->base->type != AST_PRIMARY_EXPRESSION || static_cast<Ast_Primary_Expression*>(index->base)->v_type != AST_ID_P))
+        error(index, "only slice variables can be indexed");
+    // A #soa array has no element in memory, only its fields do.
+    if (base->soa && !through_field)
+        error(index, "elements of a #soa array can only be reached through a field");
+
+    if (index->postfix != AST_UNARY_NONE) {
+        if (is_constant_storage(index))
+            error(index, "cannot modify an element of a constant array");
+        if (is_composite_type(base->element))
+            error(index, "cannot increment a '%s'", type_name(base->element));
+    }
+
+    return unqualified_type(base->element);
+}
+
+Ast_Type* Sema::check_field_expression(Ast_Field_Expression* field) {
+    field_access = (field->base->type == AST_INDEX_EXPRESSION);
+    Ast_Type* base = check_expression(field->base);
+    field_access = false;
+    if (!base)
+        return nullptr;
+
+    if (base->atom_type == AST_TYPE_STRUCT) {
+        Ast_Struct* record = base->record;
+        for (int i = 0; i < record->field_count; i++) {
+            if (strcmp(record->fields[i]->id->name, field->field->name) == 0) {
+                field->member = record->fields[i];
+                return unqualified_type(field->member->type_info);
+            }
+        }
+    }
+
+    if ((base->atom_type == AST_TYPE_ARRAY || base->atom_type == AST_TYPE_SLICE || base->atom_type == AST_TYPE_VECTOR) && strcmp(field->field->name, "len") == 0)
+        return canonical_type(AST_TYPE_LONG);
+    // Horizontal reductions across the lanes of a vector.
+    if (base->atom_type == AST_TYPE_VECTOR && (strcmp(field->field->name, "sum") == 0 || strcmp(field->field->name, "min") == 0 || strcmp(field->field->name, "max") == 0))
+        return unqualified_type(base->element);
+    // Reading the mark saves the arena's position, assigning it frees everything allocated since.
+    if (base->atom_type == AST_TYPE_ARENA && strcmp(field->field->name, "mark") == 0) {
+        if (field->base->type != AST_PRIMARY_EXPRESSION)
+            error(field, "only arena variables can be marked");
+        return canonical_type(AST_TYPE_LONG);
+    }
+
+    error(field, "'%s' has no field '%s'", type_name(base), field->field->name);
+    return nullptr;
+}
+
+Ast_Type* Sema::check_new_expression(Ast_New_Expression* alloc) {
+    Ast_Type* count = check_expression(alloc->count);
+    Ast_Type* arena = check_expression(alloc->arena);
+
+    if (count && !is_integral_type(count))
+        error(alloc->count, "allocation size must be an integer, not '%s'", type_name(count));
+    if (arena && arena->atom_type != AST_TYPE_ARENA)
+        error(alloc, "cannot allocate from a '%s'", type_name(arena));
+    else if (arena && alloc->arena->type != AST_PRIMARY_EXPRESSION)
+        error(alloc, "only arena variables can be allocated from");
+
+    alloc->element = resolve_type(alloc, alloc->element);
+    if (!alloc->element)
+        return nullptr;
+    if ((is_composite_type(alloc->element) && alloc->element->atom_type != AST_TYPE_STRUCT) || alloc->element->atom_type == AST_TYPE_VOID) {
+        error(alloc, "cannot allocate a '%s'", type_name(alloc->element));
+        return nullptr;
+    }
+
+    return composite_type(AST_TYPE_SLICE, false, unqualified_type(alloc->element), 0);
+}
+
+Ast_Type* Sema::check_vector_expression(Ast_Vector_Expression* vector) {
+    Ast_Type* args[64];
+    for (int i = 0; i < vector->arg_count; i++)
+        args[i] = check_expression(vector->args[i]);
+
+    Ast_Type* type = vector->vector = resolve_type(vector, vector->vector);
+    if (!type)
+        return nullptr;
+    check_type(vector, type);
+    Ast_Type* element = unqualified_type(type->element);
+
+    Ast_Type* from = (vector->arg_count == 2) ? args[0] : nullptr;
+    if (from && (from->atom_type == AST_TYPE_ARRAY || from->atom_type == AST_TYPE_SLICE)) {
+        vector->form = AST_VECTOR_LOAD;
+        if (unqualified_type(from->element) != element)
+            error(vector, "cannot load '%s' lanes from elements of type '%s'", type_name(element), type_name(from->element));
+        if (args[1] && !is_integral_type(args[1]))
+            error(vector->args[1], "index must be an integer, not '%s'", type_name(args[1]));
+        if (from->atom_type == AST_TYPE_SLICE && (vector->args[0]->type != AST_PRIMARY_EXPRESSION || static_cast<Ast_Primary_Expression*>(vector->args[0])->v_type != AST_ID_P))
+            error(vector, "only slice variables can be loaded from");
+        return unqualified_type(type);
+    }
+
+    if (vector->arg_count != 1 && vector->arg_count != type->length) {
+        error(vector, "a vector of %lld lanes takes 1 or %lld values, or an array and an index", (long long) type->length, (long long) type->length);
+        return nullptr;
+    }
+
+    vector->form = (vector->arg_count == 1) ? AST_VECTOR_BROADCAST : AST_VECTOR_LANES;
+    for (int i = 0; i < vector->arg_count; i++) {
+        if (args[i] && is_composite_type(args[i]))
+            error(vector->args[i], "vector lanes must be numbers, not '%s'", type_name(args[i]));
+        else
+            check_conversion(vector->args[i], args[i], element);
+    }
+    return unqualified_type(type);
+}
+
+Ast_Type* Sema::check_expression(Ast_Expression* expr) {
+    if (!expr)
+        return nullptr;
+
+    Ast_Type* type = nullptr;
+    switch (expr->type) {
+    case AST_BINARY_EXPRESSION:
+        type = check_binary_expression(static_cast<Ast_Binary_Expression*>(expr));
+        break;
+    case AST_UNARY_EXPESSION:
+        type = check_unary_expression(static_cast<Ast_Unary_Expression*>(expr));
+        break;
+    case AST_PRIMARY_EXPRESSION:
+        type = check_primary_expression(static_cast<Ast_Primary_Expression*>(expr));
+        break;
+    case AST_INDEX_EXPRESSION:
+        type = check_index_expression(static_cast<Ast_Index_Expression*>(expr));
+        break;
+    case AST_FIELD_EXPRESSION:
+        type = check_field_expression(static_cast<Ast_Field_Expression*>(expr));
+        break;
+    case AST_NEW_EXPRESSION:
+        type = check_new_expression(static_cast<Ast_New_Expression*>(expr));
+        break;
+    case AST_VECTOR_EXPRESSION:
+        type = check_vector_expression(static_cast<Ast_Vector_Expression*>(expr));
+        break;
+    }
+
+    expr->type_info = type;
+    return type;
+}
+
+Ast_Type* Sema::check_function_call(Ast_Function_Call* call) {
+    Ast_Decleration* dec = look_up(call->id->name);
+    if (!dec || dec->type != AST_FUNCTION_DEFINITION) {
+        error(call, "'%s' is not a function", call->id->name);
+        for (int i = 0; i < call->arg_count; i++)
+            check_expression(call->args[i]);
+        return nullptr;
+    }
+
+    auto func = static_cast<Ast_Function_Definition*>(dec);
+    call->id->decleration = func;
+
+    if (call->arg_count != func->arg_count)
+        error(call, "'%s' expects %d argument%s but was given %d", func->id->name, (int) func->arg_count, (func->arg_count == 1) ? "" : "s", (int) call->arg_count);
+
+    for (int i = 0; i < call->arg_count; i++) {
+        Ast_Type* type = check_expression(call->args[i]);
+        if (i < func->arg_count)
+            check_conversion(call->args[i], type, func->args[i]->type_info);
+        if (type && type->atom_type == AST_TYPE_ARENA && call->args[i]->type != AST_PRIMARY_EXPRESSION)
+            error(call->args[i], "only arena variables can be passed");
+    }
+
+    return (func->type_info) ? unqualified_type(func->type_info) : canonical_type(AST_TYPE_VOID);
+}
+
+void Sema::check_condition(Ast_Expression* condition) {
+    Ast_Type* type = check_expression(condition);
+    if (type && type->atom_type == AST_TYPE_VOID)
+        error(condition, "condition has no value");
+    else if (type && is_composite_type(type))
+        error(condition, "a '%s' cannot be used as a condition", type_name(type));
+}
+
+void Sema::check_assignment_chain(Ast_Expression* expr, Ast_Type* target_type) {
+    Ast_Expression* value = expr;
+    while (value && value->next)
+        value = value->next;
+
+    Ast_Type* value_type = check_expression(value);
+
+    for (Ast_Expression* target = expr; target != value; target = target->next) {
+        Ast_Type* type = check_expression(target);
+        if (type && is_arena_mark(target) && (target_type || target != expr || target->next != value))
+            error(target, "an arena mark can only be reset on its own");
+        if (type) {
+            check_assignable(target);
+            check_conversion(value, value_type, type);
+        }
+    }
+
+    check_conversion(value, value_type, target_type);
+}
+
+Ast_Type* Sema::resolve_type(Ast* at, Ast_Type* type) {
+    if (!type)
+        return nullptr;
+
+    // Struct names are looked up like any other declaration, so a struct has to be declared before its uses.
+    if (type->atom_type == AST_TYPE_STRUCT && !type->record) {
+        Ast_Decleration* dec = look_up(type->name->name);
+        if (!dec || dec->type != AST_STRUCT) {
+            error(at, "unknown type '%s'", type->name->name);
+            return nullptr;
+        }
+        type->record = static_cast<Ast_Struct*>(dec);
+    }
+
+    if (type->element && !resolve_type(at, type->element))
+        return nullptr;
+    return canonical_type(type);
+}
+
+void Sema::check_type(Ast* at, Ast_Type* type) {
+    if (!type)
+        return;
+    if (type->soa && (type->atom_type != AST_TYPE_ARRAY || type->element->atom_type != AST_TYPE_STRUCT)) {
+        error(at, "#soa only applies to arrays of structs");
+        return;
+    }
+    if (!is_composite_type(type))
+        return;
+
+    if (type->atom_type == AST_TYPE_SLICE && is_composite_type(type->element) && type->element->atom_type != AST_TYPE_STRUCT)
+        error(at, "slices of '%s' are not supported", type_name(type->element));
+    else if (type->atom_type == AST_TYPE_ARRAY && type->element->atom_type == AST_TYPE_ARENA)
+        error(at, "arrays of arenas are not supported");
+    else if (type->atom_type == AST_TYPE_ARRAY && type->element->soa)
+        error(at, "arrays of #soa arrays are not supported");
+    else if (type->atom_type == AST_TYPE_VECTOR && (type->length < 2 || (type->length & (type->length - 1)) || type_size(type) > 64))
+        error(at, "vec%lld %s is not supported, lanes must be a power of two filling at most 64 bytes", (long long) type->length, type_name(type->element));
+    check_type(at, type->element);
+}
+
+void Sema::check_decleration(Ast_Decleration* dec) {
+    dec->type_info = resolve_type(dec, dec->type_info);
+    check_type(dec, dec->type_info);
+
+    if (dec->expr && dec->type_info && dec->type_info->atom_type == AST_TYPE_ARRAY)
+        error(dec, "array '%s' cannot be initialized from an expression", dec->id->name);
+    else if (dec->expr && dec->type_info && dec->type_info->atom_type == AST_TYPE_ARENA)
+        error(dec, "arena '%s' cannot be initialized from an expression", dec->id->name);
+
+    if (dec->expr)
+        check_assignment_chain(dec->expr, dec->type_info);
+    else if (dec->type_info && dec->type_info->constant)
+        error(dec, "constant '%s' must be initialized", dec->id->name);
+
+    bind(dec);
+}
+
+void Sema::check_function_definition(Ast_Function_Definition* func) {
+    func->type_info = resolve_type(func, func->type_info);
+    for (int i = 0; i < func->arg_count; i++) {
+        func->args[i]->type_info = resolve_type(func->args[i], func->args[i]->type_info);
+        check_type(func->args[i], func->args[i]->type_info);
+        if (func->args[i]->type_info && func->args[i]->type_info->atom_type == AST_TYPE_ARRAY)
+            error(func->args[i], "array parameter '%s' must be passed as a slice", func->args[i]->id->name);
+    }
+
+    check_type(func, func->type_info);
+    if (func->type_info && func->type_info->atom_type == AST_TYPE_ARRAY)
+        error(func, "function '%s' cannot return an array", func->id->name);
+    else if (func->type_info && func->type_info->atom_type == AST_TYPE_ARENA)
+        error(func, "function '%s' cannot return an arena", func->id->name);
+
+    bind(func);
+
+    if (func->from)
+        return;
+
+    size_t marker = bindings.top();
+    Ast_Function_Definition* enclosing = current_function;
+    int enclosing_loop_depth = loop_depth;
+    size_t enclosing_marker = function_marker;
+    Ast_For* enclosing_parallel = parallel_loop;
+    current_function = func;
+    loop_depth = 0;
+    function_marker = marker;
+    parallel_loop = nullptr;
+
+    for (int i = 0; i < func->arg_count; i++)
+        bind(func->args[i]);
+
+    check_scope(&func->scope);
+
+    current_function = enclosing;
+    loop_depth = enclosing_loop_depth;
+    function_marker = enclosing_marker;
+    parallel_loop = enclosing_parallel;
+    unbind(marker);
+}
+
+void Sema::check_struct_definition(Ast_Struct* record) {
+    if (current_function)
+        error(record, "struct '%s' must be declared at the top level", record->id->name);
+
+    for (int i = 0; i < record->field_count; i++) {
+        Ast_Decleration* field = record->fields[i];
+        field->type_info = resolve_type(field, field->type_info);
+        check_type(field, field->type_info);
+
+        if (field->type_info && field->type_info->atom_type == AST_TYPE_ARENA)
+            error(field, "field '%s' cannot be an arena", field->id->name);
+        for (int j = 0; j < i; j++) {
+            if (strcmp(record->fields[j]->id->name, field->id->name) == 0)
+                error(field, "duplicate field '%s' in struct '%s'", field->id->name, record->id->name);
+        }
+    }
+
+    bind(record);
+}
+
+void Sema::check_for_statement(Ast_For* loop) {
+    Ast_Type* begin = check_expression(loop->begin);
+    Ast_Type* end = check_expression(loop->end);
+
+    int atom = AST_TYPE_INT;
+    if ((begin && !is_integral_type(begin)) || (end && !is_integral_type(end)))
+        error(loop, "range bounds of a for loop must be integral");
+    else if ((begin && begin->atom_type == AST_TYPE_LONG) || (end && end->atom_type == AST_TYPE_LONG))
+        atom = AST_TYPE_LONG;
+
+    // The iterator is read-only in the body, which keeps the loop countable.
+    loop->iterator->type_info = canonical_type(atom, true);
+
+    size_t marker = bindings.top();
+    Ast_For* enclosing_parallel = parallel_loop;
+    size_t enclosing_marker = parallel_marker;
+    int enclosing_depth = parallel_loop_depth;
+
+    if (loop->parallel) {
+        if (parallel_loop)
+            error(loop, "parallel loops cannot be nested");
+        else if (!current_function)
+            error(loop, "parallel loop outside of a function");
+
+        for (int i = 0; i < loop->reductions.top(); i++) {
+            Ast_Ident* ident = loop->reductions.get(i).ident;
+            Ast_Decleration* dec = look_up(ident->name);
+            if (!dec || dec->type != AST_DECLERATION) {
+                error(loop, "undeclared reduction variable '%s'", ident->name);
+                continue;
+            }
+
+            ident->decleration = dec;
+            if (!dec->type_info || is_composite_type(dec->type_info) || dec->type_info->atom_type == AST_TYPE_VOID)
+                error(loop, "cannot reduce '%s' of type '%s'", ident->name, (dec->type_info) ? type_name(dec->type_info) : "void");
+            else if (dec->type_info->constant)
+                error(loop, "cannot reduce constant '%s'", ident->name);
+        }
+
+        if (!parallel_loop) {
+            parallel_loop = loop;
+            parallel_marker = marker;
+            parallel_loop_depth = loop_depth + 1;
+        }
+    }
+
+    bind(loop->iterator);
+
+    loop_depth++;
+    check_scope(&loop->scope);
+    loop_depth--;
+
+    parallel_loop = enclosing_parallel;
+    parallel_marker = enclosing_marker;
+    parallel_loop_depth = enclosing_depth;
+    unbind(marker);
+}
+
+void Sema::check_statement(Ast* ast) {
+    switch (ast->type) {
+    case AST_STATEMENT: {
+        auto stmt = static_cast<Ast_Statement*>(ast);
+        if (stmt->flags & (AST_BREAK | AST_CONTINUE)) {
+            if (loop_depth == 0)
+                error(stmt, "%s outside of a loop", (stmt->flags & AST_BREAK) ? "break" : "continue");
+            else if (parallel_loop && loop_depth == parallel_loop_depth && (stmt->flags & AST_BREAK))
+                error(stmt, "cannot break out of a parallel loop");
+            break;
+        }
+
+        if (parallel_loop) {
+            error(stmt, "cannot return from inside a parallel loop");
+            check_expression(stmt->expr);
+            break;
+        }
+
+        if (!current_function) {
+            error(stmt, "return outside of a function");
+            check_expression(stmt->expr);
+            break;
+        }
+
+        Ast_Type* type = check_expression(stmt->expr);
+        if (stmt->expr && !current_function->type_info)
+            error(stmt, "void function '%s' cannot return a value", current_function->id->name);
+        else if (!stmt->expr && current_function->type_info)
+            error(stmt, "function '%s' must return a value", current_function->id->name);
+        else if (stmt->expr)
+            check_conversion(stmt->expr, type, current_function->type_info);
+        break;
+    }
+    case AST_CONDITION: {
+        auto condition = static_cast<Ast_ControlFlow*>(ast);
+        while (condition) {
+            if (condition->flag == AST_CONTROL_IF || condition->flag == AST_CONTROL_ELIF || condition->flag == AST_CONTROL_WHILE)
+                check_condition(condition->condition);
+
+            loop_depth += (condition->flag == AST_CONTROL_WHILE);
+            check_scope(&condition->scope);
+            loop_depth -= (condition->flag == AST_CONTROL_WHILE);
+            condition = condition->next;
+        }
+        break;
+    }
+    case AST_FOR:
+        check_for_statement(static_cast<Ast_For*>(ast));
+        break;
+    case AST_DECLERATION:
+        check_decleration(static_cast<Ast_Decleration*>(ast));
+        break;
+    case AST_ASSIGNMENT:
+        check_assignment_chain(static_cast<Ast_Decleration*>(ast)->expr, nullptr);
+        break;
+    case AST_FUNCTION_DEFINITION:
+        check_function_definition(static_cast<Ast_Function_Definition*>(ast));
+        break;
+    case AST_STRUCT:
+        check_struct_definition(static_cast<Ast_Struct*>(ast));
+        break;
+    case AST_FUNCTION_CALL:
+        check_function_call(static_cast<Ast_Function_Call*>(ast));
+        break;
+    }
+}
+
+void Sema::check_scope(Ast_Scope* scope) {
+    size_t marker = bindings.top();
+
+    for (int i = 0; i < scope->size; i++)
+        check_statement(scope->statements[i]);
+
+    unbind(marker);
+}
+
+int check_translation_unit(Ast_Translation_Unit* root) {
+    Sema sema;
+
+    // The top level is never popped: its declarations stay visible to every function.
+    for (int i = 0; i < root->scope.size; i++)
+        sema.check_statement(root->scope.statements[i]);
+
+    free(sema.names);
+    return sema.error_count;
+}
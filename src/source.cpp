@@ -0,0 +1,148 @@
+#include "../include/source.h"
+#include "../include/err.h"
+#include "../include/stats.h"
+#include "../include/literal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+Source_Manager source_manager;
+
+Source_File* Source_Manager::load_file(const char* path) {
+    FILE* file = fopen(path, SOURCE_FILE_MODE);
+    if (!file)
+        fatal_error("Failed to open input file for compilation");
+
+    struct stat st;
+    if (fstat(fileno(file), &st) == -1)
+        fatal_error("Failed to load stats of input file");
+
+    // The lexer scans until it sees a terminator, and literals are read a word at a time past it.
+    uint8_t* text = (uint8_t*) malloc(st.st_size + 1 + LITERAL_PADDING);
+    memset(text + fread((void*) text, 1, st.st_size, file), 0, 1 + LITERAL_PADDING);
+    fclose(file);
+
+    return add_file(path, text, st.st_size);
+}
+
+Source_File* Source_Manager::add_file(const char* name, uint8_t* text, size_t size) {
+    // The end of file is a location too, so every file takes one more than its size.
+    if (size >= UINT32_MAX - next_base)
+        fatal_error("'%s' does not fit in the 4 GiB of source locations.\n", name);
+
+    if (file_count == capacity) {
+        capacity = (capacity) ? capacity * 2 : 4;
+        files = (Source_File**) realloc(files, sizeof(Source_File*) * capacity);
+    }
+
+    track_allocation(MEM_SOURCE, size + 1 + LITERAL_PADDING);
+
+    Source_File* file = new Source_File;
+    file->name = name;
+    file->text = text;
+    file->size = (uint32_t) size;
+    file->base = next_base;
+    next_base += file->size + 1;
+
+    files[file_count++] = file;
+    return file;
+}
+
+Source_File* Source_Manager::file_of(Source_Location loc) {
+    for (int i = file_count - 1; i >= 0; i--) {
+        if (loc >= files[i]->base)
+            return (loc - files[i]->base <= files[i]->size) ? files[i] : nullptr;
+    }
+    return nullptr;
+}
+
+static void add_line_start(Source_File* file, uint32_t* capacity, uint32_t start) {
+    if (file->line_count == *capacity) {
+        *capacity *= 2;
+        file->line_starts = (uint32_t*) realloc(file->line_starts, sizeof(uint32_t) * *capacity);
+    }
+    file->line_starts[file->line_count++] = start;
+}
+
+// Sixteen bytes are compared against '\n' at once and each set bit of the mask is a line break.
+static void index_lines(Source_File* file) {
+    uint32_t capacity = file->size / 32 + 16;
+    file->line_starts = (uint32_t*) malloc(sizeof(uint32_t) * capacity);
+    file->line_count = 0;
+    add_line_start(file, &capacity, 0);
+
+    const uint8_t* text = file->text;
+    uint32_t i = 0;
+
+#ifdef __SSE2__
+    const __m128i newline = _mm_set1_epi8('\n');
+    for (; i + 16 <= file->size; i += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*) (text + i));
+        uint32_t mask = (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline));
+        while (mask) {
+            add_line_start(file, &capacity, i + __builtin_ctz(mask) + 1);
+            mask &= mask - 1;
+        }
+    }
+#endif
+
+    for (; i < file->size; i++) {
+        if (text[i] == '\n')
+            add_line_start(file, &capacity, i + 1);
+    }
+}
+
+uint32_t Source_Manager::line_of(Source_Location loc) {
+    Source_File* file = file_of(loc);
+    if (!file)
+        return 0;
+    if (!file->line_starts)
+        index_lines(file);
+
+    // The first line starting after the offset is one past the line holding it.
+    uint32_t offset = loc - file->base;
+    uint32_t low = 0, high = file->line_count;
+    while (low < high) {
+        uint32_t middle = (low + high) / 2;
+        if (file->line_starts[middle] <= offset)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low;
+}
+
+uint32_t Source_Manager::column_of(Source_Location loc) {
+    uint32_t line = line_of(loc);
+    if (line == 0)
+        return 0;
+
+    Source_File* file = file_of(loc);
+    return loc - file->base - file->line_starts[line - 1] + 1;
+}
+
+uint32_t Source_Manager::lines_in(Source_File* file) {
+    if (!file->line_starts)
+        index_lines(file);
+    return file->line_count;
+}
+
+void Source_Manager::clear() {
+    for (int i = 0; i < file_count; i++) {
+        track_allocation(MEM_SOURCE, -(int64_t) (files[i]->size + 1 + LITERAL_PADDING));
+        free(files[i]->text);
+        free(files[i]->line_starts);
+        delete files[i];
+    }
+    free(files);
+
+    files = nullptr;
+    file_count = capacity = 0;
+    next_base = 1;
+}
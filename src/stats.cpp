@@ -0,0 +1,64 @@
+#include "../include/stats.h"
+#include "../include/lexer.h"
+
+#include <string.h>
+#include <sys/resource.h>
+
+struct Memory_Category {
+    int64_t live;
+    int64_t peak;
+    uint64_t allocations;
+};
+
+static const char* category_names[MEM_CATEGORY_COUNT] = { "source", "tokens", "ast", "symbols", "strings", "backend" };
+static const char* stat_names[STAT_COUNT] = { "tokens", "ast nodes", "scopes", "symbols", "identifiers", "ir values" };
+
+static Memory_Category categories[MEM_CATEGORY_COUNT];
+static uint64_t stats[STAT_COUNT];
+
+void track_allocation(int category, int64_t bytes) {
+    Memory_Category* c = &categories[category];
+
+    c->live += bytes;
+    if (c->live > c->peak)
+        c->peak = c->live;
+    if (bytes > 0)
+        c->allocations++;
+}
+
+void count_stat(int stat, uint64_t amount) {
+    stats[stat] += amount;
+}
+
+void set_stat(int stat, uint64_t value) {
+    stats[stat] = value;
+}
+
+void reset_stats() {
+    memset(categories, 0, sizeof(categories));
+    memset(stats, 0, sizeof(stats));
+}
+
+void report_stats(FILE* file) {
+    Memory_Category total = { };
+
+    fprintf(file, "stats: %-12s %14s %14s %12s\n", "memory", "live bytes", "peak bytes", "allocations");
+    for (int i = 0; i < MEM_CATEGORY_COUNT; i++) {
+        Memory_Category* c = &categories[i];
+        fprintf(file, "stats: %-12s %14lld %14lld %12llu\n", category_names[i], (long long) c->live, (long long) c->peak, (unsigned long long) c->allocations);
+
+        total.live += c->live;
+        total.peak += c->peak;
+        total.allocations += c->allocations;
+    }
+    fprintf(file, "stats: %-12s %14lld %14lld %12llu\n", "total", (long long) total.live, (long long) total.peak, (unsigned long long) total.allocations);
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    fprintf(file, "stats: peak rss %ld kb\n", usage.ru_maxrss);
+
+    for (int i = 0; i < STAT_COUNT; i++)
+        fprintf(file, "stats: %-12s %14llu\n", stat_names[i], (unsigned long long) stats[i]);
+    if (stats[STAT_TOKENS])
+        fprintf(file, "stats: %-12s %14zu\n", "token size", sizeof(Token));
+}
@@ -1,4 +1,5 @@
 #include "../include/sym.h"
+#include "../include/stats.h"
 
 int SymTable::get_index(const char* name) {
     for(int i = 0; i < table.top(); i++) {
@@ -15,7 +16,10 @@ int SymTable::get_index(const char* name) {
 Entry* SymTable::insert(const char* name, int type) {
     Entry* e = look_up_type(name, type);
     if (e == nullptr) {
+        size_t reserved = table.size();
         table.push({name, type});
+        track_allocation(MEM_SYMBOLS, (int64_t) sizeof(Entry) * (table.size() - reserved));
+        count_stat(STAT_SYMBOLS);
         return &table.get_arr()[table.top() - 1];
     }
     return e;
@@ -54,4 +58,5 @@ Entry* SymTable::look_up_by_type(int type) {
 
 SymTable::SymTable() {
     table.reserve(256);
+    track_allocation(MEM_SYMBOLS, sizeof(Entry) * 256);
 }
\ No newline at end of file
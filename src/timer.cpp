@@ -0,0 +1,205 @@
+#include "../include/timer.h"
+#include "../include/err.h"
+#include "../include/trace.h"
+
+#include <time.h>
+#include <string.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+
+static Timer_Node nodes[MAX_TIMER_NODES];
+static int node_count = 0;
+
+static int open_nodes[MAX_TIMER_DEPTH];
+static uint64_t open_times[MAX_TIMER_DEPTH];
+static int open_count = 0;
+
+static int runs = 0;
+
+static const char* count_labels[MAX_TIMER_COUNTS];
+static uint64_t count_values[MAX_TIMER_COUNTS];
+static int count_count = 0;
+
+struct Timer_Summary {
+    size_t count;
+    double min;
+    double median;
+    double p99;
+    double max;
+    double mean;
+};
+
+uint64_t monotonic_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+static int find_node(const char* label, int parent) {
+    for (int i = 0; i < node_count; i++) {
+        if (nodes[i].parent == parent && strcmp(nodes[i].label, label) == 0)
+            return i;
+    }
+
+    if (node_count == MAX_TIMER_NODES)
+        fatal_error("too many distinct timers, the limit is %d.\n", MAX_TIMER_NODES);
+
+    Timer_Node* node = &nodes[node_count];
+    node->label = label;
+    node->parent = parent;
+    node->depth = (parent < 0) ? 0 : nodes[parent].depth + 1;
+    return node_count++;
+}
+
+void begin_timer(const char* label) {
+    if (open_count == MAX_TIMER_DEPTH)
+        fatal_error("timers are nested deeper than %d.\n", MAX_TIMER_DEPTH);
+
+    int parent = (open_count > 0) ? open_nodes[open_count - 1] : -1;
+    open_nodes[open_count] = find_node(label, parent);
+    if (trace_enabled)
+        begin_trace("phase", label);
+    open_times[open_count++] = monotonic_ns();
+}
+
+uint64_t end_timer() {
+    uint64_t end = monotonic_ns();
+    if (open_count == 0)
+        return 0;
+    if (trace_enabled)
+        end_trace();
+
+    open_count--;
+    Timer_Node* node = &nodes[open_nodes[open_count]];
+    uint64_t elapsed = end - open_times[open_count];
+
+    node->pending += elapsed;
+    node->entered = true;
+    return elapsed;
+}
+
+void end_timer_run() {
+    for (int i = 0; i < node_count; i++) {
+        if (!nodes[i].entered)
+            continue;
+
+        nodes[i].samples.push(nodes[i].pending);
+        nodes[i].pending = 0;
+        nodes[i].entered = false;
+    }
+    runs++;
+}
+
+void record_timer_count(const char* label, uint64_t value) {
+    for (int i = 0; i < count_count; i++) {
+        if (strcmp(count_labels[i], label) == 0) {
+            count_values[i] = value;
+            return;
+        }
+    }
+
+    if (count_count == MAX_TIMER_COUNTS)
+        fatal_error("too many timer counts, the limit is %d.\n", MAX_TIMER_COUNTS);
+
+    count_labels[count_count] = label;
+    count_values[count_count++] = value;
+}
+
+static int compare_samples(const void* a, const void* b) {
+    uint64_t left = *(const uint64_t*) a;
+    uint64_t right = *(const uint64_t*) b;
+    return (left > right) - (left < right);
+}
+
+static double to_ms(uint64_t ns) {
+    return (double) ns / 1000000.0;
+}
+
+static Timer_Summary summarize(Timer_Node* node) {
+    Timer_Summary summary = { };
+    size_t count = node->samples.top();
+    summary.count = count;
+    if (count == 0)
+        return summary;
+
+    uint64_t* sorted = (uint64_t*) malloc(sizeof(uint64_t) * count);
+    memcpy(sorted, node->samples.get_arr(), sizeof(uint64_t) * count);
+    qsort(sorted, count, sizeof(uint64_t), compare_samples);
+
+    uint64_t total = 0;
+    for (size_t i = 0; i < count; i++)
+        total += sorted[i];
+
+    // Nearest-rank percentile, so with fewer than 100 runs the p99 is the slowest run.
+    size_t p99 = (count * 99 + 99) / 100;
+
+    summary.min = to_ms(sorted[0]);
+    summary.median = (count % 2) ? to_ms(sorted[count / 2]) : (to_ms(sorted[count / 2 - 1]) + to_ms(sorted[count / 2])) / 2.0;
+    summary.p99 = to_ms(sorted[p99 - 1]);
+    summary.max = to_ms(sorted[count - 1]);
+    summary.mean = to_ms(total) / (double) count;
+
+    free(sorted);
+    return summary;
+}
+
+static void report_node(FILE* file, int index) {
+    Timer_Node* node = &nodes[index];
+    Timer_Summary summary = summarize(node);
+
+    fprintf(file, "time: %*s%-*s %6zu %10.3f %10.3f %10.3f\n", node->depth * 2, "", 24 - node->depth * 2, node->label,
+        summary.count, summary.min, summary.median, summary.p99);
+
+    for (int i = 0; i < node_count; i++) {
+        if (nodes[i].parent == index)
+            report_node(file, i);
+    }
+}
+
+void report_timers(FILE* file) {
+    fprintf(file, "time: %-24s %6s %10s %10s %10s (ms)\n", "phase", "runs", "min", "median", "p99");
+    for (int i = 0; i < node_count; i++) {
+        if (nodes[i].parent < 0)
+            report_node(file, i);
+    }
+}
+
+static void write_path(FILE* file, int index) {
+    if (nodes[index].parent >= 0) {
+        write_path(file, nodes[index].parent);
+        fputc('/', file);
+    }
+    fputs(nodes[index].label, file);
+}
+
+static void write_node(FILE* file, int index, bool* first) {
+    Timer_Node* node = &nodes[index];
+    Timer_Summary summary = summarize(node);
+
+    fprintf(file, "%s\n    { \"name\": \"%s\", \"path\": \"", (*first) ? "" : ",", node->label);
+    write_path(file, index);
+    fprintf(file, "\", \"depth\": %d, \"samples\": %zu, \"min\": %.6f, \"median\": %.6f, \"p99\": %.6f, \"max\": %.6f, \"mean\": %.6f }",
+        node->depth, summary.count, summary.min, summary.median, summary.p99, summary.max, summary.mean);
+    *first = false;
+
+    for (int i = 0; i < node_count; i++) {
+        if (nodes[i].parent == index)
+            write_node(file, i, first);
+    }
+}
+
+void write_time_report(FILE* file) {
+    bool first = true;
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    fprintf(file, "{\n  \"runs\": %d,\n  \"unit\": \"ms\",\n  \"peak_rss_kb\": %ld,\n  \"counts\": {", runs, usage.ru_maxrss);
+    for (int i = 0; i < count_count; i++)
+        fprintf(file, "%s \"%s\": %llu", (i) ? "," : "", count_labels[i], (unsigned long long) count_values[i]);
+    fprintf(file, " },\n  \"phases\": [");
+    for (int i = 0; i < node_count; i++) {
+        if (nodes[i].parent < 0)
+            write_node(file, i, &first);
+    }
+    fprintf(file, "\n  ]\n}\n");
+}
@@ -0,0 +1,121 @@
+#include "../include/trace.h"
+#include "../include/timer.h"
+#include "../include/err.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#define MAX_TRACE_THREADS 256
+
+bool trace_enabled = false;
+
+static const char* trace_path = nullptr;
+static uint64_t trace_epoch = 0;
+
+static pthread_mutex_t buffers_lock = PTHREAD_MUTEX_INITIALIZER;
+static Trace_Buffer* buffers[MAX_TRACE_THREADS];
+static int buffer_count = 0;
+
+static thread_local Trace_Buffer* local = nullptr;
+
+static Trace_Buffer* local_buffer() {
+    if (local)
+        return local;
+
+    local = new Trace_Buffer;
+    pthread_mutex_lock(&buffers_lock);
+    if (buffer_count == MAX_TRACE_THREADS) {
+        pthread_mutex_unlock(&buffers_lock);
+        fatal_error("too many traced threads, the limit is %d.\n", MAX_TRACE_THREADS);
+    }
+    local->tid = buffer_count + 1;
+    buffers[buffer_count++] = local;
+    pthread_mutex_unlock(&buffers_lock);
+
+    return local;
+}
+
+// Returns the offset of the copy in the buffer's names.
+static size_t copy_name(Trace_Buffer* buffer, const char* name) {
+    size_t offset = buffer->names.top();
+    for (; *name; name++)
+        buffer->names.push(*name);
+    buffer->names.push('\0');
+    return offset;
+}
+
+void begin_trace(const char* category, const char* name) {
+    Trace_Buffer* buffer = local_buffer();
+
+    buffer->open.push(buffer->events.top());
+    buffer->events.push({ category, copy_name(buffer, name), monotonic_ns(), 0 });
+}
+
+void rename_trace(const char* name) {
+    if (!local || local->open.top() == 0)
+        return;
+
+    local->events.get_arr()[local->open.get(local->open.top() - 1)].name = copy_name(local, name);
+}
+
+void end_trace() {
+    if (!local || local->open.top() == 0)
+        return;
+
+    size_t index = local->open.get(local->open.top() - 1);
+    local->open.pop();
+    local->events.get_arr()[index].end = monotonic_ns();
+}
+
+static double trace_us(uint64_t ns) {
+    return (double) (ns - trace_epoch) / 1000.0;
+}
+
+static void write_trace() {
+    FILE* file = fopen(trace_path, "w");
+    if (!file) {
+        report_warning(0, "could not write the trace to '%s'", trace_path);
+        flush_diagnostics();
+        return;
+    }
+
+    // Spans still open here were cut short by a fatal error.
+    uint64_t now = monotonic_ns();
+    int pid = (int) getpid();
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":0,\"args\":{\"name\":\"neo\"}}", pid);
+
+    pthread_mutex_lock(&buffers_lock);
+    for (int i = 0; i < buffer_count; i++) {
+        Trace_Buffer* buffer = buffers[i];
+
+        char thread_name[32] = "main";
+        if (buffer->tid != 1)
+            snprintf(thread_name, sizeof(thread_name), "worker %d", buffer->tid);
+        fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+            pid, buffer->tid, thread_name);
+
+        for (int j = 0; j < buffer->events.top(); j++) {
+            const Trace_Event& event = buffer->events.get(j);
+            uint64_t end = (event.end) ? event.end : now;
+
+            fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d}",
+                buffer->names.get_arr() + event.name, event.category, trace_us(event.begin), (double) (end - event.begin) / 1000.0, pid, buffer->tid);
+        }
+    }
+    pthread_mutex_unlock(&buffers_lock);
+
+    fprintf(file, "\n]}\n");
+    fclose(file);
+}
+
+void enable_trace(const char* path) {
+    trace_path = path;
+    trace_epoch = monotonic_ns();
+    trace_enabled = true;
+
+    atexit(write_trace);
+}
@@ -0,0 +1,72 @@
+#!/bin/sh
+# Compiles every program in tests/, runs it and compares what it prints with the .out file beside it.
+# Extra compiler flags for a program go in a .flags file of the same name.
+# A program that must not compile has a .err file instead, holding what the compiler reports.
+# A program that must stop with an error has a .status file holding its exit status, 0 is expected otherwise.
+
+NEO="${NEO:-./Neo}"
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+
+export NEO_THREADS="${NEO_THREADS:-8}"
+failed=0
+
+for source in tests/*.neo; do
+    name=$(basename "$source" .neo)
+    flags=""
+    [ -f "tests/$name.flags" ] && flags=$(cat "tests/$name.flags")
+
+    # The parsed tree is cached beside the source, so programs are compiled from a copy.
+    cp "$source" "$DIR/$name.neo"
+
+    # A program with flags is compiled without them first, so the real compile reads the cached tree.
+    [ -n "$flags" ] && $NEO "$DIR/$name.neo" "$DIR/$name" --cache-dir="$DIR/cache" > /dev/null 2>&1
+
+    $NEO "$DIR/$name.neo" "$DIR/$name" --cache-dir="$DIR/cache" $flags > "$DIR/$name.log" 2>&1
+    status=$?
+
+    if [ -f "tests/$name.err" ]; then
+        if [ $status -eq 0 ]; then
+            echo "FAIL $name (compiled)"
+            failed=$((failed + 1))
+        elif ! diff -u "tests/$name.err" "$DIR/$name.log"; then
+            echo "FAIL $name"
+            failed=$((failed + 1))
+        else
+            echo "ok   $name"
+        fi
+        continue
+    fi
+
+    if [ $status -ne 0 ]; then
+        echo "FAIL $name (compile)"
+        cat "$DIR/$name.log"
+        failed=$((failed + 1))
+        continue
+    fi
+
+    # A program that loses an optimization like memoization can run for ages instead of failing,
+    # and one that leaks can grow for ages, so it gets a minute and 2 GB of address space.
+    # dash writes its note about a program killed by a signal to the stderr of whatever waited for it,
+    # so the program is waited for separately and only its own output is compared.
+    (ulimit -v 2097152; exec timeout 60 "$DIR/$name") > "$DIR/$name.run" 2>&1 &
+    wait $! 2> /dev/null
+    status=$?
+    expected=0
+    [ -f "tests/$name.status" ] && expected=$(cat "tests/$name.status")
+
+    if [ $status -ne $expected ]; then
+        echo "FAIL $name (exit status $status)"
+        cat "$DIR/$name.run"
+        failed=$((failed + 1))
+        continue
+    fi
+    if ! diff -u "tests/$name.out" "$DIR/$name.run"; then
+        echo "FAIL $name"
+        failed=$((failed + 1))
+        continue
+    fi
+    echo "ok   $name"
+done
+
+[ $failed -eq 0 ] || { echo "$failed failed"; exit 1; }